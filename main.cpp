@@ -1,56 +1,28 @@
-#include <TopoDS_Shape.hxx>
-#include <BinTools.hxx>
-#include <tessellator.h>
+#include <fstream>
 #include <iostream>
-#include <string>
-#include <pybind11/embed.h>
+
+#include <BinTools.hxx>
 #include <TopoDS_Shape.hxx>
-#include <TopoDS_Face.hxx>
-#include <TopTools_IndexedMapOfShape.hxx>
-#include <TopExp.hxx>
-#include <TopAbs_ShapeEnum.hxx>
 
-std::vector<TopoDS_Face> get_faces(const TopoDS_Shape &shape)
-{
-    TopTools_IndexedMapOfShape face_map;
-    TopExp::MapShapes(shape, TopAbs_FACE, face_map);
-
-    std::vector<TopoDS_Face> faces;
-    const Standard_Integer nb_faces = face_map.Extent();
-    for (Standard_Integer i = 1; i <= nb_faces; ++i)
-    {
-        faces.push_back(TopoDS::Face(face_map(i)));
-    }
-    return faces;
-}
+#include <mesh_core.h>
 
-int main()
+int main(int argc, char *argv[])
 {
-    pybind11::scoped_interpreter guard{};
-    pybind11::gil_scoped_acquire acquire;
-    pybind11::object OCP = pybind11::module_::import("OCP");
-    // pybind11::object addons = pybind11::module_::import("addons");
+    const char *path = argc > 1 ? argv[1] : "/tmp/logo.brep";
 
     TopoDS_Shape shape;
-
-    std::ifstream file("/tmp/logo.brep", std::ios::binary);
+    std::ifstream file(path, std::ios::binary);
     BinTools::Read(shape, file);
 
-    // std::vector<TopoDS_Face> faces = get_faces(shape);
+    TessellateParams params;
+    params.deflection = 0.01;
+    params.angular_tolerance = 0.3;
+    params.timeit = true;
 
-    pybind11::object py_shape = pybind11::cast(shape); // If bindings support TopoDS_Shape
+    MeshBuffers mesh = tessellate_shape(shape, params);
 
-    MeshData mesh = tessellate(
-        // faces[0], // shape
-        py_shape, // shape
-        0.01,     // deflection
-        0.3,      // angular_tolerance
-        true,     // compute_faces
-        true,     // compute_edges
-        true,     // parallel
-        0,        // debug
-        true      // timer
-    );
+    std::cout << mesh.num_faces() << " faces, " << mesh.vertices.size / 3 << " vertices, "
+              << mesh.num_edges() << " edges" << std::endl;
 
     return 0;
-}
\ No newline at end of file
+}
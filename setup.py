@@ -222,6 +222,8 @@ if platform.system() == "Linux":
         "-Wno-deprecated-declarations",
         "-D_GLIBCXX_USE_CXX11_ABI=0",
     ])
+    # shm_open for named mesh buffers (part of libc since glibc 2.34)
+    extra_link_args.append("-lrt")
 
 elif platform.system() == "Darwin":
 
@@ -297,8 +299,22 @@ ext_modules = [
         [
             "src/modules.cpp",
             "src/tessellator/tessellator.cpp",
+            "src/tessellator/bvh.cpp",
+            "src/tessellator/log.cpp",
+            "src/tessellator/mesh_buffer.cpp",
+            "src/tessellator/mesh_delta.cpp",
+            "src/tessellator/mesh_core.cpp",
+            "src/tessellator/mesh_export.cpp",
+            "src/tessellator/mesh_view.cpp",
+            "src/tessellator/meshlets.cpp",
+            "src/tessellator/progress.cpp",
+            "src/tessellator/sharding.cpp",
+            "src/tessellator/simplify.cpp",
+            "src/tessellator/worker_pool.cpp",
             "src/tessellator/utils.cpp",
+            "src/tessellator/vertex_cache.cpp",
             "src/serializer/main.cpp",
+            "src/serializer/shape_hash.cpp",
         ],
         define_macros=[
             ("VERSION_INFO", version),
@@ -1,5 +1,9 @@
 #include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <algorithm>
+#include <istream>
 #include <sstream>
+#include <streambuf>
 #include <vector>
 
 #include <TopoDS_Shape.hxx>
@@ -10,6 +14,10 @@
 #include <BinTools_IStream.hxx>
 #include <BinTools_ShapeReader.hxx>
 #include <BinTools_ShapeWriter.hxx>
+#include <TopoDS.hxx>
+
+#include "serializer.h"
+#include "shape_hash.h"
 
 #define STRINGIFY(x) #x
 #define MACRO_STRINGIFY(x) STRINGIFY(x)
@@ -22,13 +30,133 @@ py::bytes serialize_shape(const TopoDS_Shape &shape) {
     return py::bytes(std::move(buf.str()));
 }
 
-TopoDS_Shape deserialize_shape(const py::bytes &buf) {
-    std::istringstream stream(buf);
+/*
+ * Read only stream buffer over memory, so that shapes are read without copying the data into
+ * a std::string first. Seeking is needed since BinTools refers to shared sub-shapes by position.
+ */
+class MemoryStreamBuf : public std::streambuf {
+public:
+    MemoryStreamBuf(const char *data, size_t size) {
+        char *begin = const_cast<char *>(data);
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+        if (!(which & std::ios_base::in))
+            return pos_type(off_type(-1));
+        char *base = dir == std::ios_base::beg ? eback() : (dir == std::ios_base::cur ? gptr() : egptr());
+        if (off < eback() - base || off > egptr() - base)
+            return pos_type(off_type(-1));
+        setg(eback(), base + off, egptr());
+        return pos_type(gptr() - eback());
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+TopoDS_Shape read_shape(const char *data, size_t size) {
+    MemoryStreamBuf buf(data, size);
+    std::istream stream(&buf);
     TopoDS_Shape shape;
     BinTools::Read(shape, stream);
     return shape;
 }
 
+TopoDS_Shape deserialize_shape(const py::bytes &buf) {
+    char *data;
+    Py_ssize_t size;
+    if (PyBytes_AsStringAndSize(buf.ptr(), &data, &size) != 0)
+        throw py::error_already_set();
+    return read_shape(data, static_cast<size_t>(size));
+}
+
+/*
+ * Returns the shape as instance of its concrete OCP class (e.g. TopoDS_Face)
+ */
+py::object shape_to_python(const TopoDS_Shape &shape) {
+    if (shape.IsNull())
+        return py::cast(shape);
+
+    switch (shape.ShapeType()) {
+    case TopAbs_COMPOUND:
+        return py::cast(TopoDS::Compound(shape));
+    case TopAbs_COMPSOLID:
+        return py::cast(TopoDS::CompSolid(shape));
+    case TopAbs_SOLID:
+        return py::cast(TopoDS::Solid(shape));
+    case TopAbs_SHELL:
+        return py::cast(TopoDS::Shell(shape));
+    case TopAbs_FACE:
+        return py::cast(TopoDS::Face(shape));
+    case TopAbs_WIRE:
+        return py::cast(TopoDS::Wire(shape));
+    case TopAbs_EDGE:
+        return py::cast(TopoDS::Edge(shape));
+    case TopAbs_VERTEX:
+        return py::cast(TopoDS::Vertex(shape));
+    default:
+        return py::cast(shape);
+    }
+}
+
+/*
+ * Holder of the classmethod that pickled shapes are loaded with. Pickle stores it as
+ * getattr(PickledShape, "load"), plain pybind11 functions cannot be pickled by reference.
+ */
+struct PickledShape {};
+
+py::object load_pickled_shape(py::object /* cls */, py::buffer payload) {
+    py::buffer_info info = payload.request();
+    TopoDS_Shape shape;
+    {
+        py::gil_scoped_release release;
+        shape = read_shape(static_cast<const char *>(info.ptr), static_cast<size_t>(info.size * info.itemsize));
+    }
+    return shape_to_python(shape);
+}
+
+py::tuple reduce_shape(const TopoDS_Shape &shape, int protocol) {
+    py::object payload = serialize_shape(shape);
+    if (protocol >= 5) {
+        // can be transferred out-of-band with pickle's buffer_callback
+        payload = py::module_::import("pickle").attr("PickleBuffer")(payload);
+    }
+    return py::make_tuple(py::type::of<PickledShape>().attr("load"), py::make_tuple(payload));
+}
+
+/*
+ * __reduce_ex__ installed by enable_pickle() and the own one of TopoDS_Shape it replaced
+ * (null if inherited). Both are referenced for the lifetime of the process.
+ */
+py::handle installed_reduce_ex;
+py::handle original_reduce_ex;
+
+/*
+ * Installs or removes the serializer based __reduce_ex__ of TopoDS_Shape. copyreg.pickle() is
+ * not an option: its reducers neither see the protocol (needed to choose a PickleBuffer) nor
+ * apply to the TopoDS_Shape subclasses.
+ */
+void enable_pickle(bool enable) {
+    py::object shape_class = py::module_::import("OCP.TopoDS").attr("TopoDS_Shape");
+    py::object own = shape_class.attr("__dict__").attr("get")("__reduce_ex__");
+    bool installed = installed_reduce_ex && own.is(installed_reduce_ex);
+
+    if (enable && !installed) {
+        if (!installed_reduce_ex)
+            installed_reduce_ex = py::cpp_function(&reduce_shape, py::is_method(shape_class), py::arg("protocol")).release();
+        original_reduce_ex = own.is_none() ? py::handle() : own.release();
+        py::setattr(shape_class, "__reduce_ex__", installed_reduce_ex);
+    } else if (!enable && installed) {
+        if (original_reduce_ex)
+            py::setattr(shape_class, "__reduce_ex__", original_reduce_ex);
+        else
+            py::delattr(shape_class, "__reduce_ex__");
+    }
+}
+
 py::bytes serialize_location(const TopLoc_Location &location) {
     std::ostringstream buf;
     BinTools_OStream occtStream(buf);
@@ -43,6 +171,23 @@ TopLoc_Location deserialize_location(const py::bytes &buf) {
     return *BinTools_ShapeReader().ReadLocation(occtStream);
 }
 
+py::object shape_hash(const TopoDS_Shape &shape, bool per_face) {
+    uint64_t hash;
+    std::vector<uint64_t> face_hashes;
+    {
+        py::gil_scoped_release release;
+        hash = hash_shape(shape);
+        if (per_face)
+            face_hashes = hash_faces(shape);
+    }
+    if (!per_face)
+        return py::int_(hash);
+
+    py::array_t<uint64_t> faces(face_hashes.size());
+    std::copy(face_hashes.begin(), face_hashes.end(), faces.mutable_data());
+    return py::make_tuple(hash, faces);
+}
+
 std::string _test() {
     return "Ok";
 }
@@ -59,6 +204,32 @@ void register_serializer(pybind11::module_ &m_gbl) {
     m.def("deserialize_shape", &deserialize_shape);
     m.def("serialize_location", &serialize_location);
     m.def("deserialize_location", &deserialize_location);
+    m.def("shape_hash", &shape_hash, py::arg("shape"), py::arg("per_face") = false,
+          R"pbdoc(
+          Hash the geometry of a shape without serializing it
+
+          Hashes topology, orientations, locations, tolerances and curve and surface parameters.
+          Returns an int, or with per_face=True a tuple of the int and a uint64 array with one hash
+          per face (in tessellate() face order, computed in parallel).
+          )pbdoc");
+
+    py::class_<PickledShape> pickled_shape(m, "PickledShape", "Loader of pickled shapes, see enable_pickle()");
+    pickled_shape.attr("load") = py::reinterpret_steal<py::object>(PyClassMethod_New(py::cpp_function(&load_pickled_shape, py::name("load")).ptr()));
+    m.def("enable_pickle", &enable_pickle, py::arg("enable") = true,
+          R"pbdoc(
+          Pickle OCP shapes with the serializer
+
+          Installs __reduce_ex__ on OCP.TopoDS.TopoDS_Shape. With protocol 5 the serialized shape
+          is a PickleBuffer, so it can be passed out-of-band (buffer_callback); loading reads the
+          buffer without copying and returns the concrete shape class.
+
+          The change is process wide: it applies to every shape pickled by any library in the
+          process (copyreg cannot be used, its reducers do not see the protocol). enable=False
+          restores the previous __reduce_ex__.
+          )pbdoc");
+
+    // pickle looks up classes by module name
+    py::module_::import("sys").attr("modules")[m.attr("__name__")] = m;
 
     m.def("_test", &_test);
     m.def("_testOCCT", &_testOCCT);
@@ -0,0 +1,29 @@
+#pragma once
+
+/**
+ * @file serializer.h
+ * @brief BRep (de)serialization of shapes, shared with the tessellator
+ */
+
+#include <cstddef>
+
+#include <TopoDS_Shape.hxx>
+
+#include <pybind11/pybind11.h>
+
+namespace py = pybind11;
+
+/**
+ * @brief Serializes a shape with BinTools
+ */
+py::bytes serialize_shape(const TopoDS_Shape &shape);
+
+/**
+ * @brief Reads a shape serialized with serialize_shape()
+ */
+TopoDS_Shape deserialize_shape(const py::bytes &buf);
+
+/**
+ * @brief Reads a serialized shape from memory without copying it (no Python objects involved)
+ */
+TopoDS_Shape read_shape(const char *data, size_t size);
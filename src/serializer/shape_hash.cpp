@@ -0,0 +1,397 @@
+#include "shape_hash.h"
+#include "../tessellator/hash.h"
+
+#include <cstring>
+#include <unordered_map>
+
+#include <BRep_Tool.hxx>
+#include <Geom_BezierCurve.hxx>
+#include <Geom_BezierSurface.hxx>
+#include <Geom_BSplineCurve.hxx>
+#include <Geom_BSplineSurface.hxx>
+#include <Geom_Circle.hxx>
+#include <Geom_ConicalSurface.hxx>
+#include <Geom_CylindricalSurface.hxx>
+#include <Geom_Ellipse.hxx>
+#include <Geom_Hyperbola.hxx>
+#include <Geom_Line.hxx>
+#include <Geom_OffsetCurve.hxx>
+#include <Geom_OffsetSurface.hxx>
+#include <Geom_Parabola.hxx>
+#include <Geom_Plane.hxx>
+#include <Geom_RectangularTrimmedSurface.hxx>
+#include <Geom_SphericalSurface.hxx>
+#include <Geom_SurfaceOfLinearExtrusion.hxx>
+#include <Geom_SurfaceOfRevolution.hxx>
+#include <Geom_ToroidalSurface.hxx>
+#include <Geom_TrimmedCurve.hxx>
+#include <OSD_Parallel.hxx>
+#include <Precision.hxx>
+#include <TopExp.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Iterator.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+
+namespace
+{
+    // number of samples per direction for curves and surfaces without a known parametrization
+    const int NUM_SAMPLES = 7;
+
+    void update_real(Hasher &hasher, double value)
+    {
+        // +0.0 and -0.0 are the same geometry
+        hasher.update(value == 0.0 ? 0.0 : value);
+    }
+
+    void update_xyz(Hasher &hasher, const gp_XYZ &xyz)
+    {
+        update_real(hasher, xyz.X());
+        update_real(hasher, xyz.Y());
+        update_real(hasher, xyz.Z());
+    }
+
+    void update_ax1(Hasher &hasher, const gp_Ax1 &axis)
+    {
+        update_xyz(hasher, axis.Location().XYZ());
+        update_xyz(hasher, axis.Direction().XYZ());
+    }
+
+    void update_ax2(Hasher &hasher, const gp_Ax2 &axis)
+    {
+        update_xyz(hasher, axis.Location().XYZ());
+        update_xyz(hasher, axis.Direction().XYZ());
+        update_xyz(hasher, axis.XDirection().XYZ());
+    }
+
+    void update_ax3(Hasher &hasher, const gp_Ax3 &axis)
+    {
+        update_ax2(hasher, axis.Ax2());
+        hasher.update(axis.Direct());
+    }
+
+    void update_location(Hasher &hasher, const TopLoc_Location &location)
+    {
+        if (location.IsIdentity())
+        {
+            hasher.update(uint8_t(0));
+            return;
+        }
+        const gp_Trsf &trsf = location.Transformation();
+        for (int row = 1; row <= 3; row++)
+            for (int col = 1; col <= 4; col++)
+                update_real(hasher, trsf.Value(row, col));
+    }
+
+    void update_type(Hasher &hasher, const Handle(Standard_Transient) &object)
+    {
+        const char *name = object->DynamicType()->Name();
+        hasher.update(name, std::strlen(name));
+    }
+
+    double finite(double value, double fallback)
+    {
+        return Precision::IsInfinite(value) ? fallback : value;
+    }
+
+    void update_curve(Hasher &hasher, const Handle(Geom_Curve) &curve)
+    {
+        update_type(hasher, curve);
+
+        if (auto line = Handle(Geom_Line)::DownCast(curve))
+        {
+            update_ax1(hasher, line->Position());
+        }
+        else if (auto circle = Handle(Geom_Circle)::DownCast(curve))
+        {
+            update_ax2(hasher, circle->Position());
+            update_real(hasher, circle->Radius());
+        }
+        else if (auto ellipse = Handle(Geom_Ellipse)::DownCast(curve))
+        {
+            update_ax2(hasher, ellipse->Position());
+            update_real(hasher, ellipse->MajorRadius());
+            update_real(hasher, ellipse->MinorRadius());
+        }
+        else if (auto hyperbola = Handle(Geom_Hyperbola)::DownCast(curve))
+        {
+            update_ax2(hasher, hyperbola->Position());
+            update_real(hasher, hyperbola->MajorRadius());
+            update_real(hasher, hyperbola->MinorRadius());
+        }
+        else if (auto parabola = Handle(Geom_Parabola)::DownCast(curve))
+        {
+            update_ax2(hasher, parabola->Position());
+            update_real(hasher, parabola->Focal());
+        }
+        else if (auto bezier = Handle(Geom_BezierCurve)::DownCast(curve))
+        {
+            hasher.update(bezier->NbPoles());
+            for (int i = 1; i <= bezier->NbPoles(); i++)
+            {
+                update_xyz(hasher, bezier->Pole(i).XYZ());
+                if (bezier->IsRational())
+                    update_real(hasher, bezier->Weight(i));
+            }
+        }
+        else if (auto bspline = Handle(Geom_BSplineCurve)::DownCast(curve))
+        {
+            hasher.update(bspline->Degree());
+            hasher.update(bspline->IsPeriodic());
+            hasher.update(bspline->NbPoles());
+            for (int i = 1; i <= bspline->NbPoles(); i++)
+            {
+                update_xyz(hasher, bspline->Pole(i).XYZ());
+                if (bspline->IsRational())
+                    update_real(hasher, bspline->Weight(i));
+            }
+            for (int i = 1; i <= bspline->NbKnots(); i++)
+            {
+                update_real(hasher, bspline->Knot(i));
+                hasher.update(bspline->Multiplicity(i));
+            }
+        }
+        else if (auto trimmed = Handle(Geom_TrimmedCurve)::DownCast(curve))
+        {
+            update_curve(hasher, trimmed->BasisCurve());
+            update_real(hasher, trimmed->FirstParameter());
+            update_real(hasher, trimmed->LastParameter());
+        }
+        else if (auto offset = Handle(Geom_OffsetCurve)::DownCast(curve))
+        {
+            update_curve(hasher, offset->BasisCurve());
+            update_real(hasher, offset->Offset());
+            update_xyz(hasher, offset->Direction().XYZ());
+        }
+        else
+        {
+            double first = finite(curve->FirstParameter(), -1.0);
+            double last = finite(curve->LastParameter(), 1.0);
+            for (int i = 0; i < NUM_SAMPLES; i++)
+                update_xyz(hasher, curve->Value(first + (last - first) * i / (NUM_SAMPLES - 1)).XYZ());
+        }
+    }
+
+    void update_surface(Hasher &hasher, const Handle(Geom_Surface) &surface)
+    {
+        update_type(hasher, surface);
+
+        if (auto plane = Handle(Geom_Plane)::DownCast(surface))
+        {
+            update_ax3(hasher, plane->Position());
+        }
+        else if (auto cylinder = Handle(Geom_CylindricalSurface)::DownCast(surface))
+        {
+            update_ax3(hasher, cylinder->Position());
+            update_real(hasher, cylinder->Radius());
+        }
+        else if (auto cone = Handle(Geom_ConicalSurface)::DownCast(surface))
+        {
+            update_ax3(hasher, cone->Position());
+            update_real(hasher, cone->RefRadius());
+            update_real(hasher, cone->SemiAngle());
+        }
+        else if (auto sphere = Handle(Geom_SphericalSurface)::DownCast(surface))
+        {
+            update_ax3(hasher, sphere->Position());
+            update_real(hasher, sphere->Radius());
+        }
+        else if (auto torus = Handle(Geom_ToroidalSurface)::DownCast(surface))
+        {
+            update_ax3(hasher, torus->Position());
+            update_real(hasher, torus->MajorRadius());
+            update_real(hasher, torus->MinorRadius());
+        }
+        else if (auto bezier = Handle(Geom_BezierSurface)::DownCast(surface))
+        {
+            bool rational = bezier->IsURational() || bezier->IsVRational();
+            hasher.update(bezier->NbUPoles());
+            hasher.update(bezier->NbVPoles());
+            for (int i = 1; i <= bezier->NbUPoles(); i++)
+                for (int j = 1; j <= bezier->NbVPoles(); j++)
+                {
+                    update_xyz(hasher, bezier->Pole(i, j).XYZ());
+                    if (rational)
+                        update_real(hasher, bezier->Weight(i, j));
+                }
+        }
+        else if (auto bspline = Handle(Geom_BSplineSurface)::DownCast(surface))
+        {
+            bool rational = bspline->IsURational() || bspline->IsVRational();
+            hasher.update(bspline->UDegree());
+            hasher.update(bspline->VDegree());
+            hasher.update(bspline->IsUPeriodic());
+            hasher.update(bspline->IsVPeriodic());
+            hasher.update(bspline->NbUPoles());
+            hasher.update(bspline->NbVPoles());
+            for (int i = 1; i <= bspline->NbUPoles(); i++)
+                for (int j = 1; j <= bspline->NbVPoles(); j++)
+                {
+                    update_xyz(hasher, bspline->Pole(i, j).XYZ());
+                    if (rational)
+                        update_real(hasher, bspline->Weight(i, j));
+                }
+            for (int i = 1; i <= bspline->NbUKnots(); i++)
+            {
+                update_real(hasher, bspline->UKnot(i));
+                hasher.update(bspline->UMultiplicity(i));
+            }
+            for (int i = 1; i <= bspline->NbVKnots(); i++)
+            {
+                update_real(hasher, bspline->VKnot(i));
+                hasher.update(bspline->VMultiplicity(i));
+            }
+        }
+        else if (auto trimmed = Handle(Geom_RectangularTrimmedSurface)::DownCast(surface))
+        {
+            update_surface(hasher, trimmed->BasisSurface());
+            double u1, u2, v1, v2;
+            trimmed->Bounds(u1, u2, v1, v2);
+            update_real(hasher, u1);
+            update_real(hasher, u2);
+            update_real(hasher, v1);
+            update_real(hasher, v2);
+        }
+        else if (auto offset = Handle(Geom_OffsetSurface)::DownCast(surface))
+        {
+            update_surface(hasher, offset->BasisSurface());
+            update_real(hasher, offset->Offset());
+        }
+        else if (auto revolution = Handle(Geom_SurfaceOfRevolution)::DownCast(surface))
+        {
+            update_curve(hasher, revolution->BasisCurve());
+            update_ax1(hasher, revolution->Axis());
+        }
+        else if (auto extrusion = Handle(Geom_SurfaceOfLinearExtrusion)::DownCast(surface))
+        {
+            update_curve(hasher, extrusion->BasisCurve());
+            update_xyz(hasher, extrusion->Direction().XYZ());
+        }
+        else
+        {
+            double u1, u2, v1, v2;
+            surface->Bounds(u1, u2, v1, v2);
+            u1 = finite(u1, -1.0);
+            u2 = finite(u2, 1.0);
+            v1 = finite(v1, -1.0);
+            v2 = finite(v2, 1.0);
+            for (int i = 0; i < NUM_SAMPLES; i++)
+                for (int j = 0; j < NUM_SAMPLES; j++)
+                    update_xyz(hasher, surface->Value(u1 + (u2 - u1) * i / (NUM_SAMPLES - 1),
+                                                      v1 + (v2 - v1) * j / (NUM_SAMPLES - 1))
+                                           .XYZ());
+        }
+    }
+
+    /*
+     * Hashes shapes, memoizing the hash of every TShape (not thread safe, use one per thread)
+     */
+    class ShapeHasher
+    {
+    public:
+        uint64_t hash(const TopoDS_Shape &shape)
+        {
+            Hasher hasher;
+            if (shape.IsNull())
+            {
+                hasher.update(uint8_t(0));
+                return hasher.digest();
+            }
+            hasher.update(int(shape.Orientation()));
+            update_location(hasher, shape.Location());
+            hasher.update(hash_tshape(shape));
+            return hasher.digest();
+        }
+
+    private:
+        uint64_t hash_tshape(const TopoDS_Shape &shape)
+        {
+            const TopoDS_TShape *key = shape.TShape().get();
+            auto found = memo_.find(key);
+            if (found != memo_.end())
+                return found->second;
+
+            // the TShape content, independent of how it is placed
+            TopoDS_Shape local = shape.Located(TopLoc_Location());
+            local.Orientation(TopAbs_FORWARD);
+
+            Hasher hasher;
+            hasher.update(int(shape.ShapeType()));
+
+            switch (shape.ShapeType())
+            {
+            case TopAbs_VERTEX:
+            {
+                const TopoDS_Vertex &vertex = TopoDS::Vertex(local);
+                update_real(hasher, BRep_Tool::Tolerance(vertex));
+                update_xyz(hasher, BRep_Tool::Pnt(vertex).XYZ());
+                break;
+            }
+            case TopAbs_EDGE:
+            {
+                const TopoDS_Edge &edge = TopoDS::Edge(local);
+                update_real(hasher, BRep_Tool::Tolerance(edge));
+                hasher.update(BRep_Tool::Degenerated(edge));
+
+                TopLoc_Location location;
+                double first, last;
+                Handle(Geom_Curve) curve = BRep_Tool::Curve(edge, location, first, last);
+                if (!curve.IsNull())
+                {
+                    update_curve(hasher, curve);
+                    update_location(hasher, location);
+                    update_real(hasher, first);
+                    update_real(hasher, last);
+                }
+                break;
+            }
+            case TopAbs_FACE:
+            {
+                const TopoDS_Face &face = TopoDS::Face(local);
+                update_real(hasher, BRep_Tool::Tolerance(face));
+                hasher.update(BRep_Tool::NaturalRestriction(face));
+
+                TopLoc_Location location;
+                Handle(Geom_Surface) surface = BRep_Tool::Surface(face, location);
+                if (!surface.IsNull())
+                {
+                    update_surface(hasher, surface);
+                    update_location(hasher, location);
+                }
+                break;
+            }
+            default:
+                break;
+            }
+
+            // sub-shapes with their own orientation and location relative to this TShape
+            for (TopoDS_Iterator it(local, Standard_False, Standard_False); it.More(); it.Next())
+                hasher.update(hash(it.Value()));
+
+            uint64_t result = hasher.digest();
+            memo_.emplace(key, result);
+            return result;
+        }
+
+        std::unordered_map<const TopoDS_TShape *, uint64_t> memo_;
+    };
+}
+
+uint64_t hash_shape(const TopoDS_Shape &shape)
+{
+    return ShapeHasher().hash(shape);
+}
+
+std::vector<uint64_t> hash_faces(const TopoDS_Shape &shape)
+{
+    TopTools_IndexedMapOfShape face_map;
+    TopExp::MapShapes(shape, TopAbs_FACE, face_map);
+
+    const int num_faces = face_map.Extent();
+    std::vector<uint64_t> result(num_faces);
+
+    // faces only share edges and vertices, so a hasher per face costs little
+    OSD_Parallel::For(0, num_faces, [&](int i)
+                      { result[i] = ShapeHasher().hash(face_map(i + 1)); }, num_faces < 64);
+
+    return result;
+}
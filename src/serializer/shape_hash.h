@@ -0,0 +1,32 @@
+#pragma once
+
+/**
+ * @file shape_hash.h
+ * @brief Native geometric content hash of shapes
+ *
+ * Walks the topology and hashes shape types, orientations, locations, tolerances and the
+ * parameters of the underlying curves and surfaces (poles, knots, axes, radii, ...) directly,
+ * without serializing the BRep. Sub-shapes shared via the same TShape are hashed once.
+ *
+ * Equal hashes mean equal geometry up to hash collisions; the hash is stable across processes
+ * on the same platform, so it can be used as cache key. Triangulations and pcurves are not
+ * part of the hash.
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include <TopoDS_Shape.hxx>
+
+/**
+ * @brief Hashes a shape
+ */
+uint64_t hash_shape(const TopoDS_Shape &shape);
+
+/**
+ * @brief Hashes each face of a shape in parallel
+ *
+ * @return One hash per face in the order of TopExp::MapShapes (the face order of tessellate()),
+ *         including the location and orientation of the face within the shape
+ */
+std::vector<uint64_t> hash_faces(const TopoDS_Shape &shape);
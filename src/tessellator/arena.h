@@ -0,0 +1,112 @@
+#pragma once
+
+/**
+ * @file arena.h
+ * @brief Monotonic arena for per-call scratch memory of the tessellator
+ *
+ * All scratch buffers of one tessellate() call (face and edge lists, per face vertices,
+ * normals and triangles, per edge segments, intermediate double arrays) are carved out of
+ * a few large blocks and released together when the arena goes out of scope. This replaces
+ * tens of thousands of small new[] calls per call and makes leaking them impossible.
+ *
+ * Buffers handed over to NumPy (see wrap_numpy) must not be allocated from an arena.
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+class Arena
+{
+public:
+    /**
+     * @brief Constructs an arena
+     *
+     * @param initial_size Size in bytes of the first block, ideally estimated from the
+     *                     number of faces and edges (default: 64 KiB)
+     */
+    explicit Arena(size_t initial_size = 64 * 1024) : next_size_(std::max(initial_size, MIN_BLOCK_SIZE)) {}
+
+    ~Arena()
+    {
+        for (char *block : blocks_)
+            std::free(block);
+    }
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    /**
+     * @brief Allocates uninitialized, suitably aligned storage for n objects of type T
+     *
+     * Only trivially destructible types are supported since the arena never calls destructors.
+     *
+     * @tparam T Element type
+     * @param n Number of elements (0 returns nullptr)
+     * @return Pointer to the storage, valid until the arena is destroyed
+     */
+    template <typename T>
+    T *allocate(size_t n)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena only supports trivially destructible types");
+        if (n == 0)
+            return nullptr;
+        return static_cast<T *>(allocate_bytes(n * sizeof(T), alignof(T)));
+    }
+
+    /**
+     * @brief Ensures that the next `size` bytes can be served without a new block
+     */
+    void reserve(size_t size)
+    {
+        if (remaining_ < size)
+            add_block(size);
+    }
+
+    /// Number of bytes handed out so far
+    size_t bytes_used() const { return used_; }
+
+    /// Number of blocks requested from the system allocator
+    size_t num_blocks() const { return blocks_.size(); }
+
+private:
+    static constexpr size_t MIN_BLOCK_SIZE = 4 * 1024;
+    static constexpr size_t MAX_GROWTH_SIZE = 64 * 1024 * 1024;
+
+    void *allocate_bytes(size_t size, size_t alignment)
+    {
+        size_t padding = (alignment - reinterpret_cast<size_t>(current_) % alignment) % alignment;
+        if (remaining_ < size + padding)
+        {
+            add_block(size + alignment);
+            padding = (alignment - reinterpret_cast<size_t>(current_) % alignment) % alignment;
+        }
+        char *result = current_ + padding;
+        current_ += size + padding;
+        remaining_ -= size + padding;
+        used_ += size;
+        return result;
+    }
+
+    void add_block(size_t min_size)
+    {
+        size_t size = std::max(min_size, next_size_);
+        char *block = static_cast<char *>(std::malloc(size));
+        if (block == nullptr)
+            throw std::bad_alloc();
+        blocks_.push_back(block);
+        current_ = block;
+        remaining_ = size;
+        // grow geometrically, but do not waste more than MAX_GROWTH_SIZE on the last block
+        next_size_ = std::min(2 * next_size_, MAX_GROWTH_SIZE);
+    }
+
+    std::vector<char *> blocks_;
+    char *current_ = nullptr;
+    size_t remaining_ = 0;
+    size_t next_size_;
+    size_t used_ = 0;
+};
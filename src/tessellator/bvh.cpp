@@ -0,0 +1,509 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    const int NUM_BINS = 16;
+    const int MAX_DEPTH = 64;
+    const int MAX_SAH_LEAF_SIZE = 16;
+    const float INF = std::numeric_limits<float>::infinity();
+
+    struct Box
+    {
+        float bmin[3] = {INF, INF, INF};
+        float bmax[3] = {-INF, -INF, -INF};
+
+        void extend(const float *other)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                bmin[k] = std::min(bmin[k], other[k]);
+                bmax[k] = std::max(bmax[k], other[k + 3]);
+            }
+        }
+
+        void extend_point(const float *p)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                bmin[k] = std::min(bmin[k], p[k]);
+                bmax[k] = std::max(bmax[k], p[k]);
+            }
+        }
+
+        void merge(const Box &other)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                bmin[k] = std::min(bmin[k], other.bmin[k]);
+                bmax[k] = std::max(bmax[k], other.bmax[k]);
+            }
+        }
+
+        float area() const
+        {
+            if (bmin[0] > bmax[0])
+                return 0.0f;
+            float dx = bmax[0] - bmin[0];
+            float dy = bmax[1] - bmin[1];
+            float dz = bmax[2] - bmin[2];
+            return dx * dy + dy * dz + dz * dx;
+        }
+    };
+
+    struct BuildTask
+    {
+        int node;
+        int begin;
+        int end;
+        int depth;
+    };
+
+    /*
+     * Slab test of a ray against a box enlarged by margin, restricted to [0, t_max]
+     */
+    inline bool hit_box(const BVHNode &node, const float origin[3], const float inv_dir[3],
+                        float margin, float t_max, float &t_entry)
+    {
+        float t0 = 0.0f;
+        float t1 = t_max;
+        for (int k = 0; k < 3; k++)
+        {
+            float lo = node.bmin[k] - margin;
+            float hi = node.bmax[k] + margin;
+            if (std::isinf(inv_dir[k]))
+            {
+                // ray parallel to the slab
+                if (origin[k] < lo || origin[k] > hi)
+                    return false;
+                continue;
+            }
+            float ta = (lo - origin[k]) * inv_dir[k];
+            float tb = (hi - origin[k]) * inv_dir[k];
+            if (ta > tb)
+                std::swap(ta, tb);
+            t0 = std::max(t0, ta);
+            t1 = std::min(t1, tb);
+            if (t0 > t1)
+                return false;
+        }
+        t_entry = t0;
+        return true;
+    }
+
+    inline bool normalize(const float direction[3], float unit[3], float inv_dir[3])
+    {
+        float len = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+        if (!(len > 0.0f))
+            return false;
+        for (int k = 0; k < 3; k++)
+        {
+            unit[k] = direction[k] / len;
+            inv_dir[k] = (unit[k] == 0.0f) ? INF : 1.0f / unit[k];
+        }
+        return true;
+    }
+
+    inline float dot(const float a[3], const float b[3])
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+}
+
+void BVH::build(const float *boxes, int num_primitives, int max_leaf_size)
+{
+    nodes_.clear();
+    indices_.resize(num_primitives);
+    if (num_primitives == 0)
+        return;
+
+    std::vector<float> centroids(3 * num_primitives);
+    for (int i = 0; i < num_primitives; i++)
+    {
+        indices_[i] = i;
+        for (int k = 0; k < 3; k++)
+            centroids[3 * i + k] = 0.5f * (boxes[6 * i + k] + boxes[6 * i + k + 3]);
+    }
+
+    nodes_.reserve(2 * (num_primitives / std::max(max_leaf_size, 1)) + 1);
+    nodes_.push_back(BVHNode());
+
+    std::vector<BuildTask> stack;
+    stack.push_back({0, 0, num_primitives, 0});
+
+    while (!stack.empty())
+    {
+        BuildTask task = stack.back();
+        stack.pop_back();
+
+        Box bounds, centroid_bounds;
+        for (int i = task.begin; i < task.end; i++)
+        {
+            bounds.extend(&boxes[6 * indices_[i]]);
+            centroid_bounds.extend_point(&centroids[3 * indices_[i]]);
+        }
+
+        BVHNode &node = nodes_[task.node];
+        for (int k = 0; k < 3; k++)
+        {
+            node.bmin[k] = bounds.bmin[k];
+            node.bmax[k] = bounds.bmax[k];
+        }
+        node.first = task.begin;
+        node.count = task.end - task.begin;
+
+        int count = task.end - task.begin;
+        if (count <= max_leaf_size || task.depth >= MAX_DEPTH - 1)
+            continue;
+
+        /*
+         * Binned SAH split
+         */
+
+        int best_axis = -1;
+        int best_bin = -1;
+        float best_cost = INF;
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float lo = centroid_bounds.bmin[axis];
+            float extent = centroid_bounds.bmax[axis] - lo;
+            if (!(extent > 0.0f))
+                continue;
+
+            Box bin_boxes[NUM_BINS];
+            int bin_counts[NUM_BINS] = {0};
+            float scale = NUM_BINS / extent;
+
+            for (int i = task.begin; i < task.end; i++)
+            {
+                int bin = std::min(NUM_BINS - 1, static_cast<int>((centroids[3 * indices_[i] + axis] - lo) * scale));
+                bin_counts[bin]++;
+                bin_boxes[bin].extend(&boxes[6 * indices_[i]]);
+            }
+
+            float right_area[NUM_BINS];
+            int right_count[NUM_BINS];
+            Box acc;
+            int n = 0;
+            for (int b = NUM_BINS - 1; b > 0; b--)
+            {
+                n += bin_counts[b];
+                acc.merge(bin_boxes[b]);
+                right_area[b] = acc.area();
+                right_count[b] = n;
+            }
+
+            acc = Box();
+            n = 0;
+            for (int b = 0; b < NUM_BINS - 1; b++)
+            {
+                n += bin_counts[b];
+                acc.merge(bin_boxes[b]);
+                float cost = acc.area() * n + right_area[b + 1] * right_count[b + 1];
+                if (n > 0 && right_count[b + 1] > 0 && cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = b;
+                }
+            }
+        }
+
+        int mid;
+        if (best_axis < 0)
+        {
+            // all centroids coincide, split in the middle of the range
+            mid = task.begin + count / 2;
+        }
+        else
+        {
+            if (count <= MAX_SAH_LEAF_SIZE && best_cost >= bounds.area() * count)
+                continue;
+
+            float lo = centroid_bounds.bmin[best_axis];
+            float scale = NUM_BINS / (centroid_bounds.bmax[best_axis] - lo);
+            auto it = std::partition(
+                indices_.begin() + task.begin, indices_.begin() + task.end,
+                [&](int32_t p)
+                {
+                    int bin = std::min(NUM_BINS - 1, static_cast<int>((centroids[3 * p + best_axis] - lo) * scale));
+                    return bin <= best_bin;
+                });
+            mid = static_cast<int>(it - indices_.begin());
+            if (mid == task.begin || mid == task.end)
+                mid = task.begin + count / 2;
+        }
+
+        int left = static_cast<int>(nodes_.size());
+        nodes_[task.node].first = left;
+        nodes_[task.node].count = 0;
+        nodes_.push_back(BVHNode());
+        nodes_.push_back(BVHNode());
+
+        stack.push_back({left, task.begin, mid, task.depth + 1});
+        stack.push_back({left + 1, mid, task.end, task.depth + 1});
+    }
+}
+
+MeshBVH::MeshBVH(const float *vertices, int num_vertices,
+                 const int *triangles, const int *triangles_per_face, int num_faces,
+                 const float *segments, const int *segments_per_edge, int num_edges)
+{
+    /*
+     * Triangles
+     */
+
+    int num_triangles = 0;
+    for (int i = 0; i < num_faces; i++)
+        num_triangles += triangles_per_face[i];
+
+    triangle_data_.resize(9 * static_cast<size_t>(num_triangles));
+    triangle_face_.resize(num_triangles);
+    std::vector<float> boxes(6 * static_cast<size_t>(num_triangles));
+
+    int t = 0;
+    for (int i = 0; i < num_faces; i++)
+    {
+        for (int j = 0; j < triangles_per_face[i]; j++, t++)
+        {
+            const float *p[3];
+            for (int c = 0; c < 3; c++)
+            {
+                int index = triangles[3 * t + c];
+                if (index < 0 || index >= num_vertices)
+                {
+                    throw std::out_of_range("Triangle " + std::to_string(t) + " references vertex " +
+                                            std::to_string(index) + " of " + std::to_string(num_vertices));
+                }
+                p[c] = &vertices[3 * index];
+            }
+
+            Box box;
+            for (int k = 0; k < 3; k++)
+            {
+                triangle_data_[9 * t + k] = p[0][k];
+                triangle_data_[9 * t + 3 + k] = p[1][k] - p[0][k];
+                triangle_data_[9 * t + 6 + k] = p[2][k] - p[0][k];
+            }
+            box.extend_point(p[0]);
+            box.extend_point(p[1]);
+            box.extend_point(p[2]);
+            std::copy(box.bmin, box.bmin + 3, &boxes[6 * t]);
+            std::copy(box.bmax, box.bmax + 3, &boxes[6 * t + 3]);
+
+            triangle_face_[t] = i;
+        }
+    }
+    face_bvh_.build(boxes.data(), num_triangles);
+
+    /*
+     * Segments
+     */
+
+    int num_segments = 0;
+    for (int i = 0; i < num_edges; i++)
+        num_segments += segments_per_edge[i];
+
+    segment_data_.assign(segments, segments + 6 * static_cast<size_t>(num_segments));
+    segment_edge_.resize(num_segments);
+    boxes.resize(6 * static_cast<size_t>(num_segments));
+
+    int s = 0;
+    for (int i = 0; i < num_edges; i++)
+    {
+        for (int j = 0; j < segments_per_edge[i]; j++, s++)
+        {
+            Box box;
+            box.extend_point(&segments[6 * s]);
+            box.extend_point(&segments[6 * s + 3]);
+            std::copy(box.bmin, box.bmin + 3, &boxes[6 * s]);
+            std::copy(box.bmax, box.bmax + 3, &boxes[6 * s + 3]);
+
+            segment_edge_[s] = i;
+        }
+    }
+    edge_bvh_.build(boxes.data(), num_segments);
+}
+
+int MeshBVH::intersect_face(const float origin[3], const float direction[3], float &distance) const
+{
+    distance = INF;
+    float dir[3], inv_dir[3];
+    if (face_bvh_.empty() || !normalize(direction, dir, inv_dir))
+        return -1;
+
+    const std::vector<BVHNode> &nodes = face_bvh_.nodes();
+    const std::vector<int32_t> &indices = face_bvh_.indices();
+
+    int result = -1;
+    int stack[MAX_DEPTH * 2];
+    int top = 0;
+    float t_entry;
+
+    if (!hit_box(nodes[0], origin, inv_dir, 0.0f, distance, t_entry))
+        return -1;
+    stack[top++] = 0;
+
+    while (top > 0)
+    {
+        const BVHNode &node = nodes[stack[--top]];
+
+        if (node.count > 0)
+        {
+            for (int i = node.first; i < node.first + node.count; i++)
+            {
+                // Moeller-Trumbore, both sides of the triangle are hit
+                const float *tri = &triangle_data_[9 * indices[i]];
+                const float *e1 = tri + 3;
+                const float *e2 = tri + 6;
+                float p[3] = {dir[1] * e2[2] - dir[2] * e2[1],
+                              dir[2] * e2[0] - dir[0] * e2[2],
+                              dir[0] * e2[1] - dir[1] * e2[0]};
+                float det = dot(e1, p);
+                if (std::fabs(det) < 1e-20f)
+                    continue;
+                float inv_det = 1.0f / det;
+                float s[3] = {origin[0] - tri[0], origin[1] - tri[1], origin[2] - tri[2]};
+                float u = dot(s, p) * inv_det;
+                if (u < 0.0f || u > 1.0f)
+                    continue;
+                float q[3] = {s[1] * e1[2] - s[2] * e1[1],
+                              s[2] * e1[0] - s[0] * e1[2],
+                              s[0] * e1[1] - s[1] * e1[0]};
+                float v = dot(dir, q) * inv_det;
+                if (v < 0.0f || u + v > 1.0f)
+                    continue;
+                float t = dot(e2, q) * inv_det;
+                if (t >= 0.0f && t < distance)
+                {
+                    distance = t;
+                    result = triangle_face_[indices[i]];
+                }
+            }
+        }
+        else
+        {
+            // visit the nearer child first
+            float t_left, t_right;
+            bool hit_left = hit_box(nodes[node.first], origin, inv_dir, 0.0f, distance, t_left);
+            bool hit_right = hit_box(nodes[node.first + 1], origin, inv_dir, 0.0f, distance, t_right);
+            if (hit_left && hit_right)
+            {
+                if (t_left < t_right)
+                {
+                    stack[top++] = node.first + 1;
+                    stack[top++] = node.first;
+                }
+                else
+                {
+                    stack[top++] = node.first;
+                    stack[top++] = node.first + 1;
+                }
+            }
+            else if (hit_left)
+            {
+                stack[top++] = node.first;
+            }
+            else if (hit_right)
+            {
+                stack[top++] = node.first + 1;
+            }
+        }
+    }
+    return result;
+}
+
+int MeshBVH::nearest_edge(const float origin[3], const float direction[3], float tolerance,
+                          float tolerance_slope, float &distance) const
+{
+    distance = INF;
+    float dir[3], inv_dir[3];
+    if (edge_bvh_.empty() || !normalize(direction, dir, inv_dir))
+        return -1;
+
+    const std::vector<BVHNode> &nodes = edge_bvh_.nodes();
+    const std::vector<int32_t> &indices = edge_bvh_.indices();
+
+    // Candidates are ranked by their distance to the ray relative to the tolerance at their
+    // depth, i.e. in pixels for a perspective camera. Only ratios below best_ratio are accepted.
+    float best_ratio = 1.0f;
+    int result = -1;
+    int stack[MAX_DEPTH * 2];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0)
+    {
+        const BVHNode &node = nodes[stack[--top]];
+
+        // the largest ray parameter of any point in the box bounds the tolerance inside it
+        float t_far = 0.0f;
+        for (int k = 0; k < 3; k++)
+        {
+            float center = 0.5f * (node.bmin[k] + node.bmax[k]);
+            float half = 0.5f * (node.bmax[k] - node.bmin[k]);
+            t_far += (center - origin[k]) * dir[k] + half * std::fabs(dir[k]);
+        }
+        float margin = best_ratio * (tolerance + tolerance_slope * std::max(t_far, 0.0f));
+        float t_entry;
+        if (!hit_box(node, origin, inv_dir, margin, INF, t_entry))
+            continue;
+
+        if (node.count == 0)
+        {
+            stack[top++] = node.first + 1;
+            stack[top++] = node.first;
+            continue;
+        }
+
+        for (int i = node.first; i < node.first + node.count; i++)
+        {
+            // closest points between the ray o + t * dir (t >= 0) and the segment a + s * (b - a)
+            const float *a = &segment_data_[6 * indices[i]];
+            const float *b = a + 3;
+            float v[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            float w[3] = {origin[0] - a[0], origin[1] - a[1], origin[2] - a[2]};
+            float B = dot(dir, v);
+            float C = dot(v, v);
+            float D = dot(dir, w);
+            float E = dot(v, w);
+
+            float s = 0.0f;
+            float denom = C - B * B;
+            if (C > 0.0f && denom > 1e-12f * C)
+                s = std::min(1.0f, std::max(0.0f, (E - B * D) / denom));
+            float t = B * s - D;
+            if (t < 0.0f)
+            {
+                t = 0.0f;
+                s = (C > 0.0f) ? std::min(1.0f, std::max(0.0f, E / C)) : 0.0f;
+            }
+
+            float d[3] = {w[0] + t * dir[0] - s * v[0],
+                          w[1] + t * dir[1] - s * v[1],
+                          w[2] + t * dir[2] - s * v[2]};
+            float dist = std::sqrt(dot(d, d));
+            float allowed = tolerance + tolerance_slope * t;
+            if (!(allowed > 0.0f))
+            {
+                if (dist > 0.0f)
+                    continue;
+                allowed = 1.0f;
+            }
+            float ratio = dist / allowed;
+            if (ratio < best_ratio || (ratio == best_ratio && t < distance))
+            {
+                best_ratio = ratio;
+                distance = t;
+                result = segment_edge_[indices[i]];
+            }
+        }
+    }
+    return result;
+}
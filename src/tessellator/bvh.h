@@ -0,0 +1,130 @@
+#pragma once
+
+/**
+ * @file bvh.h
+ * @brief Bounding volume hierarchy over tessellated triangles and edge segments
+ *
+ * Used for ray picking in viewers: a ray is intersected with the triangles of all faces
+ * (returning the face index and hit distance) or tested against the edge segments within
+ * a tolerance (returning the edge index and the distance along the ray).
+ *
+ * The classes only depend on the standard library so that queries can run without the GIL.
+ */
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @struct BVHNode
+ * @brief Flattened BVH node
+ *
+ * @var bmin Minimum corner of the node bounding box
+ * @var bmax Maximum corner of the node bounding box
+ * @var first Index of the left child (inner node) or of the first primitive (leaf)
+ * @var count Number of primitives in a leaf, 0 for inner nodes (right child is first + 1)
+ */
+struct BVHNode
+{
+    float bmin[3];
+    float bmax[3];
+    int32_t first;
+    int32_t count;
+};
+
+/**
+ * @class BVH
+ * @brief Binned SAH bounding volume hierarchy over axis aligned primitive boxes
+ *
+ * The tree only stores the primitive order; the primitives themselves are owned by the
+ * users of this class (see MeshBVH).
+ */
+class BVH
+{
+public:
+    /**
+     * @brief Build the hierarchy
+     *
+     * @param boxes Primitive boxes, 6 floats per primitive (min xyz, max xyz)
+     * @param num_primitives Number of primitives
+     * @param max_leaf_size Maximum number of primitives per leaf
+     */
+    void build(const float *boxes, int num_primitives, int max_leaf_size = 4);
+
+    const std::vector<BVHNode> &nodes() const { return nodes_; }
+    const std::vector<int32_t> &indices() const { return indices_; }
+    bool empty() const { return nodes_.empty(); }
+
+private:
+    std::vector<BVHNode> nodes_;
+    std::vector<int32_t> indices_;
+};
+
+/**
+ * @class MeshBVH
+ * @brief Ray picking structure over the triangles and segments of a tessellated shape
+ *
+ * Triangles are tagged with their face index (derived from triangles_per_face), segments
+ * with their edge index (derived from segments_per_edge). Ray directions do not need to be
+ * normalized; all returned distances are measured in world units along the ray.
+ */
+class MeshBVH
+{
+public:
+    /**
+     * @brief Build the face and edge hierarchies
+     *
+     * @param vertices Vertex coordinates (x,y,z triplets)
+     * @param num_vertices Number of vertices
+     * @param triangles Triangle vertex indices (3 per triangle)
+     * @param triangles_per_face Number of triangles for each face
+     * @param num_faces Number of faces
+     * @param segments Segment end points (6 floats per segment)
+     * @param segments_per_edge Number of segments for each edge
+     * @param num_edges Number of edges
+     */
+    MeshBVH(const float *vertices, int num_vertices,
+            const int *triangles, const int *triangles_per_face, int num_faces,
+            const float *segments, const int *segments_per_edge, int num_edges);
+
+    /**
+     * @brief Find the closest triangle hit by a ray
+     *
+     * @param origin Ray origin
+     * @param direction Ray direction
+     * @param distance Receives the hit distance (infinity if nothing was hit)
+     * @return Face index of the hit triangle or -1
+     */
+    int intersect_face(const float origin[3], const float direction[3], float &distance) const;
+
+    /**
+     * @brief Find the edge segment closest to a ray within a tolerance
+     *
+     * The accepted distance between ray and segment grows with the distance t along the ray
+     * as tolerance + tolerance_slope * t, so that a pixel tolerance can be used for
+     * perspective cameras (tolerance_slope = pixel size / focal length) as well as for
+     * orthographic cameras (tolerance_slope = 0).
+     *
+     * @param origin Ray origin
+     * @param direction Ray direction
+     * @param tolerance Accepted distance at the ray origin
+     * @param tolerance_slope Growth of the accepted distance per unit along the ray
+     * @param distance Receives the distance along the ray of the closest point (infinity if none)
+     * @return Edge index of the closest segment or -1
+     */
+    int nearest_edge(const float origin[3], const float direction[3], float tolerance,
+                     float tolerance_slope, float &distance) const;
+
+    int num_triangles() const { return static_cast<int>(triangle_face_.size()); }
+    int num_segments() const { return static_cast<int>(segment_edge_.size()); }
+
+private:
+    // per triangle: p0 (3), p1 - p0 (3), p2 - p0 (3)
+    std::vector<float> triangle_data_;
+    std::vector<int32_t> triangle_face_;
+    // per segment: p0 (3), p1 (3)
+    std::vector<float> segment_data_;
+    std::vector<int32_t> segment_edge_;
+
+    BVH face_bvh_;
+    BVH edge_bvh_;
+};
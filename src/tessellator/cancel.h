@@ -0,0 +1,78 @@
+#pragma once
+
+/**
+ * @file cancel.h
+ * @brief Python-free cancellation of running tessellations
+ *
+ * A CancellableProgress passed to tessellate_shape() reports a user break once its
+ * CancelToken has been cancelled; the mesher and the extraction loops then stop and
+ * tessellate_shape() throws TessellationCancelled. The Python layer derives
+ * TessellationProgress from it to add progress callbacks (see progress.h).
+ */
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+
+#include <Message_ProgressIndicator.hxx>
+#include <Message_ProgressRange.hxx>
+#include <Message_ProgressScope.hxx>
+
+/**
+ * @class CancelToken
+ * @brief Thread safe flag to cancel running tessellations from another thread
+ */
+class CancelToken
+{
+public:
+    void cancel() { cancelled_ = true; }
+    void reset() { cancelled_ = false; }
+    bool cancelled() const { return cancelled_; }
+
+private:
+    std::atomic<bool> cancelled_{false};
+};
+
+/**
+ * @class TessellationCancelled
+ * @brief Thrown by tessellate() when it has been cancelled, mapped to a Python exception
+ */
+class TessellationCancelled : public std::runtime_error
+{
+public:
+    explicit TessellationCancelled(const std::string &message) : std::runtime_error(message) {}
+};
+
+/**
+ * @class CancellableProgress
+ * @brief OCCT progress indicator that reports a user break when its CancelToken is cancelled
+ *
+ * Shows nothing; override Show() to report the position (it is called from OCCT worker threads).
+ */
+class CancellableProgress : public Message_ProgressIndicator
+{
+public:
+    /**
+     * @param token Cancel token (may be nullptr)
+     */
+    explicit CancellableProgress(const CancelToken *token = nullptr) : token_(token) {}
+
+    void Show(const Message_ProgressScope &, const Standard_Boolean) override {}
+
+    Standard_Boolean UserBreak() override
+    {
+        return token_ != nullptr && token_->cancelled();
+    }
+
+    /**
+     * @brief Throws TessellationCancelled if a user break has been requested
+     */
+    virtual void check_cancelled()
+    {
+        if (UserBreak())
+            throw TessellationCancelled("Tessellation cancelled");
+    }
+
+private:
+    const CancelToken *token_;
+};
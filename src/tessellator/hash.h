@@ -0,0 +1,86 @@
+#pragma once
+
+/**
+ * @file hash.h
+ * @brief Fast non-cryptographic 64 bit hashing of buffers and values
+ *
+ * Used for content hashes (change detection, cache keys). Hashes are stable across runs and
+ * processes on the same platform, but not a security feature.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+class Hasher
+{
+public:
+    explicit Hasher(uint64_t seed = 0) : state_(seed ^ K0) {}
+
+    /**
+     * @brief Absorbs a byte range
+     *
+     * A sequence of updates is hashed, i.e. update(a) + update(b) differs from update(a + b).
+     */
+    void update(const void *data, size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        while (size >= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes, 8);
+            absorb(word);
+            bytes += 8;
+            size -= 8;
+        }
+        uint64_t tail = 0;
+        if (size > 0)
+            std::memcpy(&tail, bytes, size);
+        absorb(tail ^ (uint64_t(size) << 56));
+        length_++;
+    }
+
+    /**
+     * @brief Absorbs the bytes of a trivially copyable value
+     */
+    template <typename T>
+    void update(const T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Hasher only hashes trivially copyable values");
+        update(&value, sizeof(T));
+    }
+
+    uint64_t digest() const
+    {
+        return mix(state_ ^ (length_ * K1));
+    }
+
+    /**
+     * @brief Finalizer of MurmurHash3, also useful to combine hashes
+     */
+    static uint64_t mix(uint64_t x)
+    {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+private:
+    static constexpr uint64_t K0 = 0x9e3779b97f4a7c15ULL;
+    static constexpr uint64_t K1 = 0x87c37b91114253d5ULL;
+    static constexpr uint64_t K2 = 0x4cf5ad432745937fULL;
+
+    void absorb(uint64_t word)
+    {
+        state_ ^= word * K1;
+        state_ = (state_ << 31) | (state_ >> 33);
+        state_ *= K2;
+    }
+
+    uint64_t state_;
+    uint64_t length_ = 0;
+};
@@ -0,0 +1,69 @@
+#include "log.h"
+
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+
+namespace
+{
+
+void stdout_sink(const std::string &line)
+{
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::cout << line << std::endl;
+}
+
+std::atomic<LogSink> log_sink{&stdout_sink};
+
+} // namespace
+
+void set_log_sink(LogSink sink)
+{
+    log_sink = sink != nullptr ? sink : &stdout_sink;
+}
+
+void write_log(const std::string &line)
+{
+    log_sink.load()(line);
+}
+
+Timer::Timer(const std::string &message, int level, bool timeit)
+    : message_(message), timeit_(timeit), level_(level), start_(std::chrono::high_resolution_clock::now()) {}
+
+void Timer::start(const std::string &message, int level, bool timeit)
+{
+    message_ = message;
+    level_ = level;
+    timeit_ = timeit;
+    start_ = std::chrono::high_resolution_clock::now();
+}
+void Timer::output() const
+{
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start_).count() / 1000.0;
+    std::stringstream stream;
+    stream << std::fixed << std::setprecision(3) << std::setw(8) << seconds;
+    std::string s = stream.str();
+    std::string indent = "";
+    for (int i = 0; i < level_; ++i)
+        indent.append(" |");
+    write_log(format_log_line(s, "sec: ", indent, message_));
+}
+
+void Timer::stop() const
+{
+    if (!timeit_)
+        return;
+    output();
+}
+
+void Timer::reset(const std::string &message, int level)
+{
+    if (timeit_)
+        output();
+    message_ = message;
+    level_ = level;
+    start_ = std::chrono::high_resolution_clock::now();
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+/**
+ * @file log.h
+ * @brief Python-free logging and timing of the tessellation core
+ *
+ * Logger and Timer format their messages in C++ and hand complete lines to a process wide
+ * log sink. The default sink writes to stdout; the Python module installs a sink that
+ * prints through Python (acquiring the GIL), so output interleaves with Python prints.
+ */
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <utility>
+
+/**
+ * @brief Receives one complete log line (without trailing newline), may be called from any thread
+ */
+using LogSink = void (*)(const std::string &line);
+
+/**
+ * @brief Replaces the log sink, nullptr restores the default stdout sink
+ */
+void set_log_sink(LogSink sink);
+
+/**
+ * @brief Passes a line to the current log sink
+ */
+void write_log(const std::string &line);
+
+/**
+ * @brief Joins the arguments with spaces like Python's print (bools as true/false)
+ */
+template <typename... Args>
+std::string format_log_line(Args &&...args)
+{
+    std::ostringstream stream;
+    stream << std::boolalpha;
+    const char *separator = "";
+    ((stream << separator << std::forward<Args>(args), separator = " "), ...);
+    return stream.str();
+}
+
+/**
+ * @brief A utility class for measuring and reporting execution time of code blocks.
+ *
+ * The Timer class provides functionality to measure elapsed time between start and stop points,
+ * with optional message output and hierarchical level support for nested timing operations.
+ *
+ * @example
+ * Timer timer("Processing data", 0, true);
+ * // ... code to time ...
+ * timer.stop();
+ */
+
+class Timer
+{
+public:
+    /**
+     * @brief Constructs a Timer object and optionally starts timing.
+     *
+     * @param message Optional message to display when outputting timing results (default: "")
+     * @param level Hierarchical level for nested timing operations, affects output indentation (default: 0)
+     * @param timeit Whether to actually perform timing measurements (default: true)
+     */
+    Timer(const std::string &message = "", int level = 0, bool timeit = true);
+
+    /**
+     * @brief Starts or restarts the timer with new parameters.
+     *
+     * @param message Optional message to display when outputting timing results (default: "")
+     * @param level Hierarchical level for nested timing operations (default: 0)
+     * @param timeit Whether to actually perform timing measurements (default: true)
+     */
+    void start(const std::string &message = "", int level = 0, bool timeit = true);
+
+    /**
+     * @brief Outputs the current timing information without stopping the timer.
+     *
+     * Displays the elapsed time along with the associated message and level formatting
+     * through the log sink.
+     */
+    void output() const;
+
+    /**
+     * @brief Stops the timer and outputs the final timing results.
+     *
+     * Calculates and displays the total elapsed time from start to stop.
+     */
+    void stop() const;
+
+    /**
+     * @brief Resets the timer with a new message and timing flag.
+     *
+     * @param message New message to associate with this timer
+     * @param level Hierarchical level for nested timing operations
+     */
+    void reset(const std::string &message, int level = 0);
+
+private:
+    std::string message_;
+    bool timeit_;
+    int level_;
+    std::chrono::time_point<std::chrono::high_resolution_clock> start_;
+};
+
+/**
+ * @brief A logging utility class that provides different levels of logging output.
+ *
+ * The Logger class supports hierarchical logging levels where higher levels include
+ * all lower level messages:
+ * - Level 0: ERROR messages
+ * - Level 1: ERROR + INFO messages
+ * - Level 2: ERROR + INFO + DEBUG messages
+ * - Level 3: ERROR + INFO + DEBUG + TRACE messages
+ *
+ * All logging output is directed through the log sink (see set_log_sink()), so the logger
+ * can be used without the GIL and outside of Python.
+ */
+class Logger
+{
+public:
+    Logger(int level) : level_(level) {}
+
+    template <typename... Args>
+    void error(Args &&...args) const
+    {
+        write_log(format_log_line("[ERROR]", std::forward<Args>(args)...));
+    }
+    template <typename... Args>
+    void info(Args &&...args) const
+    {
+        if (level_ >= 1)
+            write_log(format_log_line("[INFO]", std::forward<Args>(args)...));
+    }
+    template <typename... Args>
+    void debug(Args &&...args) const
+    {
+        if (level_ >= 2)
+            write_log(format_log_line("[DEBUG]", std::forward<Args>(args)...));
+    }
+    template <typename... Args>
+    void trace(Args &&...args) const
+    {
+        if (level_ >= 3)
+            write_log(format_log_line("[TRACE]", std::forward<Args>(args)...));
+    }
+
+    /// Whether trace messages are printed, to select code paths without per element checks
+    bool tracing() const
+    {
+        return level_ >= 3;
+    }
+
+    template <typename T>
+    void trace_xyz(std::string msg, T x, T y, T z, bool endline) const
+    {
+        if (level_ >= 3)
+        {
+            write_log(format_log_line("[TRACE]", msg, ":", "(", x, ",", y, ",", z, ")"));
+            if (endline)
+                write_log("");
+        }
+    }
+
+private:
+    int level_;
+};
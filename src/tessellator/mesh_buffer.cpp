@@ -0,0 +1,469 @@
+#include "mesh_buffer.h"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    struct MeshBufferLayout
+    {
+        uint32_t flags = 0;
+        std::vector<MeshBufferEntry> entries;
+        std::vector<const void *> sources;
+        size_t total_size = 0;
+    };
+
+    inline size_t align_up(size_t offset)
+    {
+        return (offset + MESH_BUFFER_ALIGNMENT - 1) & ~(MESH_BUFFER_ALIGNMENT - 1);
+    }
+
+    /*
+     * Plans the offsets of all arrays, needs the GIL
+     */
+    MeshBufferLayout plan_layout(const MeshData &mesh_data)
+    {
+        const std::pair<const char *, py::array> arrays[] = {
+            {"vertices", mesh_data.vertices},
+            {"normals", mesh_data.normals},
+            {"triangles", mesh_data.triangles},
+            {"vertex_offsets", mesh_data.vertex_offsets},
+            {"index_offsets", mesh_data.index_offsets},
+            {"triangles_per_face", mesh_data.triangles_per_face},
+            {"face_types", mesh_data.face_types},
+            {"segments", mesh_data.segments},
+            {"segments_per_edge", mesh_data.segments_per_edge},
+            {"edge_types", mesh_data.edge_types},
+            {"obj_vertices", mesh_data.obj_vertices},
+            {"face_bounds", mesh_data.face_bounds},
+            {"edge_bounds", mesh_data.edge_bounds},
+            {"bounds", mesh_data.bounds},
+            {"edge_face_offsets", mesh_data.edge_face_offsets},
+            {"edge_faces", mesh_data.edge_faces},
+            {"face_edge_offsets", mesh_data.face_edge_offsets},
+            {"face_edges", mesh_data.face_edges},
+            {"vertex_faces", mesh_data.vertex_faces},
+            {"face_normals", mesh_data.face_normals},
+            {"flat_faces", mesh_data.flat_faces},
+            {"normal_offsets", mesh_data.normal_offsets},
+        };
+        const size_t num_arrays = sizeof(arrays) / sizeof(arrays[0]);
+
+        MeshBufferLayout layout;
+        layout.flags = mesh_data.local_indices ? MESH_BUFFER_LOCAL_INDICES : 0;
+        layout.entries.resize(num_arrays);
+        layout.sources.resize(num_arrays);
+
+        size_t offset = sizeof(MeshBufferHeader) + num_arrays * sizeof(MeshBufferEntry);
+        for (size_t i = 0; i < num_arrays; i++)
+        {
+            const py::array &array = arrays[i].second;
+            MeshBufferEntry &entry = layout.entries[i];
+
+            entry = MeshBufferEntry();
+            std::strncpy(entry.name, arrays[i].first, sizeof(entry.name) - 1);
+            entry.kind = array.dtype().kind();
+            entry.itemsize = static_cast<uint8_t>(array.itemsize());
+            entry.length = static_cast<uint64_t>(array.size());
+
+            offset = align_up(offset);
+            entry.offset = offset;
+            offset += entry.length * entry.itemsize;
+
+            layout.sources[i] = array.data();
+        }
+        layout.total_size = align_up(offset);
+
+        return layout;
+    }
+
+    /*
+     * Copies header, entry table and arrays, does not touch Python objects
+     */
+    void write_layout(const MeshBufferLayout &layout, char *buffer)
+    {
+        MeshBufferHeader header;
+        std::memcpy(header.magic, MESH_BUFFER_MAGIC, sizeof(header.magic));
+        header.version = MESH_BUFFER_VERSION;
+        header.flags = layout.flags;
+        header.num_arrays = static_cast<uint32_t>(layout.entries.size());
+        header.entry_size = sizeof(MeshBufferEntry);
+        header.total_size = layout.total_size;
+
+        std::memcpy(buffer, &header, sizeof(header));
+        std::memcpy(buffer + sizeof(header), layout.entries.data(), layout.entries.size() * sizeof(MeshBufferEntry));
+
+        // zero the padding, so that equal meshes give equal buffers
+        size_t position = sizeof(header) + layout.entries.size() * sizeof(MeshBufferEntry);
+        for (size_t i = 0; i < layout.entries.size(); i++)
+        {
+            const MeshBufferEntry &entry = layout.entries[i];
+            size_t num_bytes = entry.length * entry.itemsize;
+
+            std::memset(buffer + position, 0, entry.offset - position);
+            if (num_bytes > 0)
+                std::memcpy(buffer + entry.offset, layout.sources[i], num_bytes);
+            position = entry.offset + num_bytes;
+        }
+        std::memset(buffer + position, 0, layout.total_size - position);
+    }
+
+    bool is_contiguous(const py::buffer_info &info)
+    {
+        py::ssize_t stride = info.itemsize;
+        for (py::ssize_t i = info.ndim - 1; i >= 0; i--)
+        {
+            if (info.shape[i] > 1 && info.strides[i] != stride)
+                return false;
+            stride *= info.shape[i];
+        }
+        return true;
+    }
+
+    py::buffer_info request_contiguous(py::object source, bool writable)
+    {
+        py::buffer_info info = source.cast<py::buffer>().request(writable);
+        if (!is_contiguous(info))
+            throw std::invalid_argument("Mesh buffers need a contiguous buffer");
+        return info;
+    }
+
+#ifndef _WIN32
+    std::string shm_path(const std::string &name)
+    {
+        // same convention as multiprocessing.shared_memory
+        return (!name.empty() && name[0] == '/') ? name : "/" + name;
+    }
+
+    std::runtime_error shm_error(const std::string &call, const std::string &name)
+    {
+        return std::runtime_error(call + "(" + name + ") failed: " + std::strerror(errno));
+    }
+
+    struct SharedMapping
+    {
+        void *ptr;
+        size_t size;
+    };
+#endif
+
+    /*
+     * Validates the buffer and creates the numpy views, `owner` keeps the memory alive
+     */
+    py::dict create_views(const char *data, size_t size, py::handle owner, bool readonly)
+    {
+        MeshBufferHeader header;
+        if (size < sizeof(header))
+            throw std::invalid_argument("Mesh buffer too small");
+        std::memcpy(&header, data, sizeof(header));
+
+        if (std::memcmp(header.magic, MESH_BUFFER_MAGIC, sizeof(header.magic)) != 0)
+            throw std::invalid_argument("Not a mesh buffer");
+        if (header.version != MESH_BUFFER_VERSION)
+            throw std::invalid_argument("Unsupported mesh buffer version " + std::to_string(header.version));
+        if (header.entry_size != sizeof(MeshBufferEntry) || header.total_size > size ||
+            sizeof(header) + uint64_t(header.num_arrays) * sizeof(MeshBufferEntry) > header.total_size)
+            throw std::invalid_argument("Corrupt mesh buffer header");
+
+        py::dict result;
+        result["local_indices"] = py::bool_((header.flags & MESH_BUFFER_LOCAL_INDICES) != 0);
+
+        for (uint32_t i = 0; i < header.num_arrays; i++)
+        {
+            MeshBufferEntry entry;
+            std::memcpy(&entry, data + sizeof(header) + i * sizeof(MeshBufferEntry), sizeof(entry));
+
+            bool valid_dtype = (entry.kind == 'f' || entry.kind == 'i' || entry.kind == 'u') &&
+                               (entry.itemsize == 1 || entry.itemsize == 2 || entry.itemsize == 4 || entry.itemsize == 8);
+            if (!valid_dtype || entry.offset % entry.itemsize != 0 ||
+                entry.offset > header.total_size ||
+                entry.length > (header.total_size - entry.offset) / entry.itemsize)
+                throw std::invalid_argument("Corrupt mesh buffer entry " + std::to_string(i));
+
+            std::string name(entry.name, strnlen(entry.name, sizeof(entry.name)));
+            py::dtype dtype = py::dtype::from_args(py::str(std::string(1, entry.kind) + std::to_string(entry.itemsize)));
+
+            py::array view(dtype,
+                           {static_cast<py::ssize_t>(entry.length)},
+                           {static_cast<py::ssize_t>(entry.itemsize)},
+                           data + entry.offset,
+                           owner);
+            if (readonly)
+                view.attr("setflags")(py::arg("write") = false);
+
+            result[py::str(name)] = view;
+        }
+        return result;
+    }
+}
+
+size_t mesh_buffer_size(const MeshData &mesh_data)
+{
+    return plan_layout(mesh_data).total_size;
+}
+
+size_t write_mesh_buffer(const MeshData &mesh_data, py::object target)
+{
+    MeshBufferLayout layout = plan_layout(mesh_data);
+
+    if (py::isinstance<py::str>(target))
+    {
+        std::string name = target.cast<std::string>();
+#ifndef _WIN32
+        std::string path = shm_path(name);
+
+        int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0)
+            throw shm_error("shm_open", name);
+
+        if (ftruncate(fd, static_cast<off_t>(layout.total_size)) != 0)
+        {
+            std::runtime_error error = shm_error("ftruncate", name);
+            close(fd);
+            shm_unlink(path.c_str());
+            throw error;
+        }
+
+        void *ptr = mmap(nullptr, layout.total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED)
+        {
+            std::runtime_error error = shm_error("mmap", name);
+            close(fd);
+            shm_unlink(path.c_str());
+            throw error;
+        }
+        close(fd);
+
+        {
+            py::gil_scoped_release release;
+            write_layout(layout, static_cast<char *>(ptr));
+            munmap(ptr, layout.total_size);
+        }
+#else
+        throw std::runtime_error("Named shared memory segments are only supported on POSIX systems, "
+                                 "pass a writable buffer instead");
+#endif
+    }
+    else
+    {
+        py::buffer_info info = request_contiguous(target, true);
+        size_t size = static_cast<size_t>(info.size * info.itemsize);
+        if (size < layout.total_size)
+            throw std::length_error("Mesh buffer too small: " + std::to_string(size) + " bytes, " +
+                                    std::to_string(layout.total_size) + " bytes needed");
+
+        py::gil_scoped_release release;
+        write_layout(layout, static_cast<char *>(info.ptr));
+    }
+
+    return layout.total_size;
+}
+
+py::dict load_mesh_buffer(py::object source)
+{
+    if (py::isinstance<py::str>(source))
+    {
+        std::string name = source.cast<std::string>();
+#ifndef _WIN32
+        int fd = shm_open(shm_path(name).c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            throw shm_error("shm_open", name);
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            std::runtime_error error = shm_error("fstat", name);
+            close(fd);
+            throw error;
+        }
+
+        size_t size = static_cast<size_t>(st.st_size);
+        void *ptr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED)
+        {
+            std::runtime_error error = shm_error("mmap", name);
+            close(fd);
+            throw error;
+        }
+        close(fd);
+
+        // unmapped when the last view is garbage collected
+        py::capsule owner(new SharedMapping{ptr, size}, [](void *p)
+                          {
+            auto *mapping = static_cast<SharedMapping *>(p);
+            munmap(mapping->ptr, mapping->size);
+            delete mapping; });
+
+        return create_views(static_cast<const char *>(ptr), size, owner, true);
+#else
+        throw std::runtime_error("Named shared memory segments are only supported on POSIX systems, "
+                                 "pass a buffer instead");
+#endif
+    }
+
+    // a memoryview holds the buffer export, e.g. a bytearray cannot be resized under the views
+    py::object view = py::reinterpret_steal<py::object>(PyMemoryView_FromObject(source.ptr()));
+    if (!view)
+        throw py::error_already_set();
+
+    py::buffer_info info = request_contiguous(view, false);
+    return create_views(static_cast<const char *>(info.ptr),
+                        static_cast<size_t>(info.size * info.itemsize),
+                        view,
+                        info.readonly);
+}
+
+namespace
+{
+    template <typename T>
+    py::array_t<T> typed_view(const py::dict &views, const char *name)
+    {
+        if (!views.contains(name))
+            throw std::invalid_argument(std::string("Mesh buffer has no array ") + name);
+
+        py::array view = views[name].cast<py::array>();
+        if (!view.dtype().equal(py::dtype::of<T>()))
+            throw std::invalid_argument(std::string("Mesh buffer array ") + name + " has an unexpected dtype");
+
+        // same dtype and contiguous, so this is no copy
+        return py::array_t<T>(view);
+    }
+}
+
+py::array pack_mesh_data(const MeshData &mesh_data)
+{
+    MeshBufferLayout layout = plan_layout(mesh_data);
+
+    char *buffer = static_cast<char *>(::operator new(layout.total_size, std::align_val_t(MESH_BUFFER_ALIGNMENT)));
+    {
+        py::gil_scoped_release release;
+        write_layout(layout, buffer);
+    }
+
+    py::capsule owner(buffer, [](void *p)
+                      { ::operator delete(p, std::align_val_t(MESH_BUFFER_ALIGNMENT)); });
+    return py::array_t<uint8_t>({static_cast<py::ssize_t>(layout.total_size)}, {1}, reinterpret_cast<uint8_t *>(buffer), owner);
+}
+
+MeshData unpack_mesh_data(py::object source)
+{
+    py::dict views = load_mesh_buffer(source);
+
+    MeshData mesh_data;
+    mesh_data.local_indices = views["local_indices"].cast<bool>();
+
+    mesh_data.vertices = typed_view<float>(views, "vertices");
+    mesh_data.normals = typed_view<float>(views, "normals");
+    mesh_data.vertex_offsets = typed_view<int>(views, "vertex_offsets");
+    mesh_data.index_offsets = typed_view<int>(views, "index_offsets");
+    mesh_data.triangles_per_face = typed_view<int>(views, "triangles_per_face");
+    mesh_data.face_types = typed_view<int>(views, "face_types");
+    mesh_data.segments = typed_view<float>(views, "segments");
+    mesh_data.segments_per_edge = typed_view<int>(views, "segments_per_edge");
+    mesh_data.edge_types = typed_view<int>(views, "edge_types");
+    mesh_data.obj_vertices = typed_view<float>(views, "obj_vertices");
+    mesh_data.face_bounds = typed_view<float>(views, "face_bounds");
+    mesh_data.edge_bounds = typed_view<float>(views, "edge_bounds");
+    mesh_data.bounds = typed_view<float>(views, "bounds");
+    mesh_data.edge_face_offsets = typed_view<int>(views, "edge_face_offsets");
+    mesh_data.edge_faces = typed_view<int>(views, "edge_faces");
+    mesh_data.face_edge_offsets = typed_view<int>(views, "face_edge_offsets");
+    mesh_data.face_edges = typed_view<int>(views, "face_edges");
+    mesh_data.vertex_faces = typed_view<int>(views, "vertex_faces");
+    mesh_data.face_normals = typed_view<float>(views, "face_normals");
+    mesh_data.flat_faces = typed_view<int>(views, "flat_faces");
+    mesh_data.normal_offsets = typed_view<int>(views, "normal_offsets");
+
+    // int32 global or uint16/uint32 face local indices
+    if (!views.contains("triangles"))
+        throw std::invalid_argument("Mesh buffer has no array triangles");
+    mesh_data.triangles = views["triangles"].cast<py::array>();
+
+    return mesh_data;
+}
+
+namespace
+{
+    const int PICKLE_STATE_VERSION = 3;
+
+    template <typename T>
+    py::array_t<T> from_payload(const py::module_ &numpy, py::handle payload, py::handle dtype)
+    {
+        py::array array = numpy.attr("frombuffer")(payload, dtype);
+        return py::array_t<T>(array);
+    }
+}
+
+py::tuple mesh_data_state(const MeshData &mesh_data, int protocol)
+{
+    py::object pickle_buffer = py::module_::import("pickle").attr("PickleBuffer");
+    auto payload = [&](const py::array &array) -> py::object
+    {
+        return protocol >= 5 ? pickle_buffer(array) : py::object(array);
+    };
+
+    py::tuple arrays = py::make_tuple(
+        payload(mesh_data.vertices), payload(mesh_data.normals), payload(mesh_data.triangles),
+        payload(mesh_data.vertex_offsets), payload(mesh_data.index_offsets),
+        payload(mesh_data.triangles_per_face), payload(mesh_data.face_types),
+        payload(mesh_data.segments), payload(mesh_data.segments_per_edge), payload(mesh_data.edge_types),
+        payload(mesh_data.obj_vertices), payload(mesh_data.face_bounds), payload(mesh_data.edge_bounds),
+        payload(mesh_data.bounds), payload(mesh_data.edge_face_offsets), payload(mesh_data.edge_faces),
+        payload(mesh_data.face_edge_offsets), payload(mesh_data.face_edges), payload(mesh_data.vertex_faces),
+        payload(mesh_data.face_normals), payload(mesh_data.flat_faces), payload(mesh_data.normal_offsets));
+
+    return py::make_tuple(PICKLE_STATE_VERSION, mesh_data.local_indices, mesh_data.triangles.dtype(),
+                          mesh_data.mesh_threads, mesh_data.extraction_threads, mesh_data.output_size, arrays);
+}
+
+void set_mesh_data_state(MeshData &mesh_data, py::tuple state)
+{
+    if (state.size() != 7 || state[0].cast<int>() != PICKLE_STATE_VERSION)
+        throw std::invalid_argument("Unsupported MeshData pickle state");
+
+    py::module_ numpy = py::module_::import("numpy");
+    py::dtype f4 = py::dtype::of<float>();
+    py::dtype i4 = py::dtype::of<int>();
+    py::tuple arrays = state[6].cast<py::tuple>();
+    if (arrays.size() != 22)
+        throw std::invalid_argument("Unsupported MeshData pickle state");
+
+    mesh_data.local_indices = state[1].cast<bool>();
+    mesh_data.mesh_threads = state[3].cast<int>();
+    mesh_data.extraction_threads = state[4].cast<int>();
+    mesh_data.output_size = state[5].cast<size_t>();
+
+    mesh_data.vertices = from_payload<float>(numpy, arrays[0], f4);
+    mesh_data.normals = from_payload<float>(numpy, arrays[1], f4);
+    mesh_data.triangles = numpy.attr("frombuffer")(arrays[2], state[2]);
+    mesh_data.vertex_offsets = from_payload<int>(numpy, arrays[3], i4);
+    mesh_data.index_offsets = from_payload<int>(numpy, arrays[4], i4);
+    mesh_data.triangles_per_face = from_payload<int>(numpy, arrays[5], i4);
+    mesh_data.face_types = from_payload<int>(numpy, arrays[6], i4);
+    mesh_data.segments = from_payload<float>(numpy, arrays[7], f4);
+    mesh_data.segments_per_edge = from_payload<int>(numpy, arrays[8], i4);
+    mesh_data.edge_types = from_payload<int>(numpy, arrays[9], i4);
+    mesh_data.obj_vertices = from_payload<float>(numpy, arrays[10], f4);
+    mesh_data.face_bounds = from_payload<float>(numpy, arrays[11], f4);
+    mesh_data.edge_bounds = from_payload<float>(numpy, arrays[12], f4);
+    mesh_data.bounds = from_payload<float>(numpy, arrays[13], f4);
+    mesh_data.edge_face_offsets = from_payload<int>(numpy, arrays[14], i4);
+    mesh_data.edge_faces = from_payload<int>(numpy, arrays[15], i4);
+    mesh_data.face_edge_offsets = from_payload<int>(numpy, arrays[16], i4);
+    mesh_data.face_edges = from_payload<int>(numpy, arrays[17], i4);
+    mesh_data.vertex_faces = from_payload<int>(numpy, arrays[18], i4);
+    mesh_data.face_normals = from_payload<float>(numpy, arrays[19], f4);
+    mesh_data.flat_faces = from_payload<int>(numpy, arrays[20], i4);
+    mesh_data.normal_offsets = from_payload<int>(numpy, arrays[21], i4);
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+/**
+ * @file mesh_buffer.h
+ * @brief Contiguous binary layout (wire format) of MeshData for cross-process transfer
+ *
+ * All arrays of a MeshData are written into one buffer: a fixed header, a table with one
+ * entry per array (name, dtype, offset, length) and the array data, each array starting at a
+ * multiple of MESH_BUFFER_ALIGNMENT. The target is a named POSIX shared memory segment, a
+ * writable buffer owned by the caller, or a new buffer (pack_mesh_data) to be sent as one
+ * frame; the receiver maps it and gets numpy views without copying. Numbers are stored in
+ * native byte order (little endian on all supported platforms).
+ *
+ * Readers reject buffers with another MESH_BUFFER_VERSION; new arrays or flags require a
+ * version bump.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include <pybind11/pybind11.h>
+
+#include "tessellator.h"
+
+namespace py = pybind11;
+
+constexpr char MESH_BUFFER_MAGIC[8] = {'O', 'C', 'P', 'M', 'E', 'S', 'H', '\0'};
+constexpr uint32_t MESH_BUFFER_VERSION = 3;
+constexpr size_t MESH_BUFFER_ALIGNMENT = 64;
+
+/// Header flag: triangles holds face local indices
+constexpr uint32_t MESH_BUFFER_LOCAL_INDICES = 1;
+
+/**
+ * @struct MeshBufferHeader
+ * @brief Start of a mesh buffer, followed by num_arrays MeshBufferEntry records
+ */
+struct MeshBufferHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t num_arrays;
+    uint32_t entry_size;
+    uint64_t total_size;
+};
+
+/**
+ * @struct MeshBufferEntry
+ * @brief Location and dtype of one array in a mesh buffer
+ *
+ * @var name Array name (the MeshData field), zero terminated
+ * @var kind Numpy dtype kind ('f', 'i' or 'u')
+ * @var itemsize Size of one element in bytes
+ * @var offset Offset of the first element from the start of the buffer
+ * @var length Number of elements
+ */
+struct MeshBufferEntry
+{
+    char name[24];
+    char kind;
+    uint8_t itemsize;
+    uint16_t reserved0;
+    uint32_t reserved1;
+    uint64_t offset;
+    uint64_t length;
+};
+
+static_assert(sizeof(MeshBufferHeader) == 32, "unexpected MeshBufferHeader padding");
+static_assert(sizeof(MeshBufferEntry) == 48, "unexpected MeshBufferEntry padding");
+
+/**
+ * @brief Number of bytes needed to store a MeshData as mesh buffer
+ */
+size_t mesh_buffer_size(const MeshData &mesh_data);
+
+/**
+ * @brief Writes a MeshData into a named shared memory segment or a writable buffer
+ *
+ * The data is copied with the GIL released.
+ *
+ * @param mesh_data Tessellation result
+ * @param target Name of a POSIX shared memory segment to create (it must not exist, the
+ *        receiver is responsible for unlinking it) or an object supporting the writable
+ *        buffer protocol (e.g. bytearray, mmap or SharedMemory.buf)
+ * @return Number of bytes written
+ * @throws std::length_error if the buffer is too small
+ * @throws std::runtime_error if the segment cannot be created
+ */
+size_t write_mesh_buffer(const MeshData &mesh_data, py::object target);
+
+/**
+ * @brief Maps a mesh buffer without copying
+ *
+ * @param source Name of a POSIX shared memory segment or an object supporting the buffer protocol
+ * @return dict of numpy views keyed by array name, plus "local_indices". The views keep the
+ *         source (or the mapping of the segment) alive.
+ * @throws std::invalid_argument if the source is no valid mesh buffer
+ */
+py::dict load_mesh_buffer(py::object source);
+
+/**
+ * @brief Packs a MeshData into one new, MESH_BUFFER_ALIGNMENT aligned buffer
+ *
+ * @return uint8 numpy array owning the buffer (supports the buffer protocol, e.g. for sending
+ *         it as one websocket frame)
+ */
+py::array pack_mesh_data(const MeshData &mesh_data);
+
+/**
+ * @brief Creates a MeshData whose arrays are views into a mesh buffer
+ *
+ * @param source Name of a POSIX shared memory segment or an object supporting the buffer protocol
+ * @throws std::invalid_argument if the source is no valid mesh buffer or an array has an
+ *         unexpected dtype
+ */
+MeshData unpack_mesh_data(py::object source);
+
+/**
+ * @brief State of a MeshData for pickling (__reduce_ex__)
+ *
+ * With protocol 5 the arrays are passed as PickleBuffer, so they can be transferred out-of-band
+ * without copying; older protocols pickle the numpy arrays in-band.
+ *
+ * @param mesh_data Tessellation result
+ * @param protocol Pickle protocol
+ */
+py::tuple mesh_data_state(const MeshData &mesh_data, int protocol);
+
+/**
+ * @brief Restores a MeshData from mesh_data_state() (__setstate__), arrays are views into the buffers
+ *
+ * @throws std::invalid_argument for an unknown state version
+ */
+void set_mesh_data_state(MeshData &mesh_data, py::tuple state);
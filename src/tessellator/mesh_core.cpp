@@ -0,0 +1,1296 @@
+#include "mesh_core.h"
+#include "arena.h"
+#include "log.h"
+#include "vertex_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+GeomAbs_SurfaceType get_face_type(TopoDS_Face face)
+{
+    return BRepAdaptor_Surface(face).GetType();
+}
+
+GeomAbs_CurveType get_edge_type(TopoDS_Edge edge)
+{
+    return BRepAdaptor_Curve(edge).GetType();
+}
+
+/*
+ * Rough per element estimates of the scratch memory (FaceData/EdgeData plus their buffers)
+ * used to size the first arena block from the face and edge counts.
+ */
+constexpr size_t ARENA_BYTES_PER_FACE = sizeof(FaceData) + 4096;
+constexpr size_t ARENA_BYTES_PER_EDGE = sizeof(EdgeData) + 1024;
+
+/*
+ * Deflection and angle of healed faces are coarsened by this factor
+ */
+constexpr double HEAL_RELAX_FACTOR = 2.0;
+
+int configure_threads(int num_threads)
+{
+    const Handle(OSD_ThreadPool) &pool = OSD_ThreadPool::DefaultPool();
+    if (pool->IsInUse())
+        throw std::runtime_error("The thread pool is in use by a running tessellation");
+
+    // already set at import, repeated for C++ callers of the core
+    OSD_Parallel::SetUseOcctThreads(Standard_True);
+    try
+    {
+        pool->Init(num_threads);
+    }
+    catch (Standard_Failure &e)
+    {
+        throw std::runtime_error(std::string("Cannot resize the thread pool: ") + e.GetMessageString());
+    }
+    pool->SetNbDefaultThreadsToLaunch(pool->NbThreads());
+    return pool->NbThreads();
+}
+
+/*
+ * Number of threads an OSD_Parallel loop (e.g. in BRepMesh) launches on the pool by default
+ */
+inline int default_pool_threads(const Handle(OSD_ThreadPool) &pool)
+{
+    int num_threads = pool->NbDefaultThreadsToLaunch();
+    return num_threads > 0 ? num_threads : pool->NbThreads();
+}
+
+/*
+ * Bounding boxes are stored as (xmin, ymin, zmin, xmax, ymax, zmax).
+ * An empty box is inverted (min = +inf, max = -inf), so extending it with
+ * the first point yields a box of that point.
+ */
+
+inline void reset_bounds(Standard_Real bounds[6])
+{
+    const Standard_Real inf = std::numeric_limits<Standard_Real>::infinity();
+    bounds[0] = bounds[1] = bounds[2] = inf;
+    bounds[3] = bounds[4] = bounds[5] = -inf;
+}
+
+inline void extend_bounds(Standard_Real bounds[6], Standard_Real x, Standard_Real y, Standard_Real z)
+{
+    bounds[0] = std::min(bounds[0], x);
+    bounds[1] = std::min(bounds[1], y);
+    bounds[2] = std::min(bounds[2], z);
+    bounds[3] = std::max(bounds[3], x);
+    bounds[4] = std::max(bounds[4], y);
+    bounds[5] = std::max(bounds[5], z);
+}
+
+inline void merge_bounds(Standard_Real bounds[6], const Standard_Real other[6])
+{
+    for (int k = 0; k < 3; k++)
+    {
+        bounds[k] = std::min(bounds[k], other[k]);
+        bounds[k + 3] = std::max(bounds[k + 3], other[k + 3]);
+    }
+}
+
+std::vector<gp_Pnt> discretize_free_edge(const TopoDS_Edge &edge, double deflection, double angular_tolerance,
+                                         bool relative, double min_size, double max_deflection)
+{
+    std::vector<gp_Pnt> points;
+    if (BRep_Tool::Degenerated(edge))
+        return points;
+
+    try
+    {
+        // the mesher stores a Polygon3D for free edges it discretized
+        TopLoc_Location loc;
+        Handle(Poly_Polygon3D) polygon = BRep_Tool::Polygon3D(edge, loc);
+        if (!polygon.IsNull())
+        {
+            const TColgp_Array1OfPnt &nodes = polygon->Nodes();
+            points.reserve(nodes.Length());
+            for (Standard_Integer j = nodes.Lower(); j <= nodes.Upper(); j++)
+                points.push_back(nodes(j).Transformed(loc));
+            return points;
+        }
+
+        if (!BRep_Tool::IsGeometric(edge))
+            return points;
+
+        BRepAdaptor_Curve curve(edge);
+        double linear_deflection = deflection;
+        double min_length = 1.0e-7;
+        if (relative)
+        {
+            // like the mesher: relative to the largest dimension of the edge box
+            Bnd_Box box;
+            BndLib_Add3dCurve::Add(curve, 0.0, box);
+            if (!box.IsVoid())
+            {
+                Standard_Real xmin, ymin, zmin, xmax, ymax, zmax;
+                box.Get(xmin, ymin, zmin, xmax, ymax, zmax);
+                linear_deflection = deflection * std::max({xmax - xmin, ymax - ymin, zmax - zmin});
+            }
+            if (max_deflection > 0.0)
+                linear_deflection = std::min(linear_deflection, max_deflection);
+            if (min_size > 0.0)
+                min_length = min_size;
+        }
+
+        GCPnts_TangentialDeflection sampler(curve, angular_tolerance, linear_deflection, 2, 1.0e-9, min_length);
+        points.reserve(sampler.NbPoints());
+        for (Standard_Integer j = 1; j <= sampler.NbPoints(); j++)
+            points.push_back(sampler.Value(j));
+    }
+    catch (Standard_Failure &)
+    {
+        points.clear();
+    }
+    return points;
+}
+
+void set_edge_polyline(EdgeData &edge_data, const std::vector<gp_Pnt> &points, Arena &arena)
+{
+    reset_bounds(edge_data.bounds);
+    edge_data.num_segments = points.size() < 2 ? 0 : static_cast<Standard_Integer>(points.size() - 1);
+    edge_data.segments = arena.allocate<Standard_Real>(6 * edge_data.num_segments);
+
+    for (int j = 0; j < edge_data.num_segments; j++)
+    {
+        const gp_Pnt &p1 = points[j];
+        const gp_Pnt &p2 = points[j + 1];
+        edge_data.segments[j * 6 + 0] = p1.X();
+        edge_data.segments[j * 6 + 1] = p1.Y();
+        edge_data.segments[j * 6 + 2] = p1.Z();
+        edge_data.segments[j * 6 + 3] = p2.X();
+        edge_data.segments[j * 6 + 4] = p2.Y();
+        edge_data.segments[j * 6 + 5] = p2.Z();
+        extend_bounds(edge_data.bounds, p1.X(), p1.Y(), p1.Z());
+        extend_bounds(edge_data.bounds, p2.X(), p2.Y(), p2.Z());
+    }
+}
+
+TopoDS_Face heal_face(const TopoDS_Face &face, const IMeshTools_Parameters &parameters, const Logger &logger)
+{
+    try
+    {
+        // a deep copy, the edges of the face are shared with its neighbors
+        BRepBuilderAPI_Copy copier(face, Standard_True, Standard_False);
+        TopoDS_Face healed = TopoDS::Face(copier.Shape());
+
+        ShapeFix_Face face_fixer(healed);
+        face_fixer.Perform();
+        healed = face_fixer.Face();
+
+        ShapeFix_Edge edge_fixer;
+        for (TopExp_Explorer explorer(healed, TopAbs_EDGE); explorer.More(); explorer.Next())
+        {
+            const TopoDS_Edge &edge = TopoDS::Edge(explorer.Current());
+            edge_fixer.FixAddCurve3d(edge);
+            edge_fixer.FixAddPCurve(edge, healed, Standard_False);
+            edge_fixer.FixSameParameter(edge);
+            edge_fixer.FixVertexTolerance(edge, healed);
+        }
+
+        // topology only, the relaxed mesher may still cope with geometric defects
+        if (!BRepCheck_Analyzer(healed, Standard_False).IsValid())
+            logger.debug("=> healed face is not valid, meshing it anyway");
+
+        IMeshTools_Parameters relaxed = parameters;
+        relaxed.Deflection *= HEAL_RELAX_FACTOR;
+        relaxed.DeflectionInterior *= HEAL_RELAX_FACTOR;
+        relaxed.Angle *= HEAL_RELAX_FACTOR;
+        relaxed.AngleInterior *= HEAL_RELAX_FACTOR;
+        relaxed.AllowQualityDecrease = Standard_True;
+        relaxed.ControlSurfaceDeflection = Standard_False;
+        relaxed.InParallel = Standard_False;
+        BRepMesh_IncrementalMesh mesher(healed, relaxed);
+
+        TopLoc_Location location;
+        if (!BRep_Tool::Triangulation(healed, location).IsNull())
+            return healed;
+    }
+    catch (Standard_Failure &e)
+    {
+        logger.debug("=> healing failed:", e.GetMessageString());
+    }
+    return TopoDS_Face();
+}
+
+/**
+ * @brief Extracts vertices, normals and face local triangles of one face into its buffers
+ *
+ * Specialized at compile time, so that the node and triangle loops contain neither
+ * orientation, normal or location checks nor logging; select_face_kernel() picks the
+ * instance once per face.
+ *
+ * @tparam Reversed The face is reversed, the triangle winding is flipped
+ * @tparam Internal The face is internal, the normals are flipped
+ * @tparam HasNormals The triangulation has UV nodes to evaluate surface normals at
+ * @tparam HasLocation The triangulation location is not the identity
+ * @tparam Trace Vertices, normals and triangles are traced (debug level 3)
+ */
+template <bool Reversed, bool Internal, bool HasNormals, bool HasLocation, bool Trace>
+void extract_face(FaceData &face, const TopoDS_Face &topods_face, const Poly_Triangulation &triangulation,
+                  const gp_Trsf &trsf, const Logger &logger)
+{
+    const Standard_Integer num_nodes = triangulation.NbNodes();
+    const Standard_Integer num_triangles = triangulation.NbTriangles();
+
+    std::optional<BRepGProp_Face> prop;
+    if constexpr (HasNormals)
+        prop.emplace(topods_face);
+
+    reset_bounds(face.bounds);
+
+    for (Standard_Integer j = 0; j < num_nodes; j++)
+    {
+        gp_Pnt point = triangulation.Node(j + 1);
+        if constexpr (HasLocation)
+            point.Transform(trsf);
+
+        face.vertices[3 * j] = point.X();
+        face.vertices[3 * j + 1] = point.Y();
+        face.vertices[3 * j + 2] = point.Z();
+        extend_bounds(face.bounds, point.X(), point.Y(), point.Z());
+
+        if constexpr (Trace)
+            logger.trace_xyz("vertex", point.X(), point.Y(), point.Z(), false);
+
+        if constexpr (HasNormals)
+        {
+            const gp_Pnt2d &uv = triangulation.UVNode(j + 1);
+            gp_Pnt surface_point;
+            gp_Vec normal;
+            prop->Normal(uv.X(), uv.Y(), surface_point, normal);
+            if (normal.SquareMagnitude() > 0.0)
+                normal.Normalize();
+            if constexpr (Internal)
+                normal.Reverse();
+
+            face.normals[3 * j] = normal.X();
+            face.normals[3 * j + 1] = normal.Y();
+            face.normals[3 * j + 2] = normal.Z();
+
+            if constexpr (Trace)
+                logger.trace_xyz(" normal", normal.X(), normal.Y(), normal.Z(), false);
+        }
+    }
+
+    for (Standard_Integer j = 0; j < num_triangles; j++)
+    {
+        Standard_Integer index0, index1, index2;
+        triangulation.Triangle(j + 1).Get(index0, index1, index2);
+        if constexpr (Reversed)
+            std::swap(index1, index2);
+
+        // face local, 0 based indices (rebased in collect_mesh_data)
+        face.triangles[3 * j] = index0 - 1;
+        face.triangles[3 * j + 1] = index1 - 1;
+        face.triangles[3 * j + 2] = index2 - 1;
+
+        if constexpr (Trace)
+            logger.trace_xyz("triangle ", index0 - 1, index1 - 1, index2 - 1, false);
+    }
+
+    face.num_vertices = num_nodes;
+    face.num_triangles = num_triangles;
+}
+
+using FaceKernel = void (*)(FaceData &, const TopoDS_Face &, const Poly_Triangulation &, const gp_Trsf &, const Logger &);
+
+template <bool... Flags>
+FaceKernel select_face_kernel()
+{
+    return &extract_face<Flags...>;
+}
+
+/**
+ * @brief Returns the extract_face() instance for the runtime flags (in template parameter order)
+ */
+template <bool... Flags, typename... Rest>
+FaceKernel select_face_kernel(bool flag, Rest... rest)
+{
+    return flag ? select_face_kernel<Flags..., true>(rest...) : select_face_kernel<Flags..., false>(rest...);
+}
+
+void extract_face_data(FaceData &face, const TopoDS_Face &topods_face, const Poly_Triangulation &triangulation,
+                       const TopLoc_Location &location, const Logger &logger)
+{
+    FaceKernel kernel = select_face_kernel(topods_face.Orientation() == TopAbs_REVERSED,
+                                           topods_face.Orientation() == TopAbs_INTERNAL,
+                                           triangulation.HasUVNodes(),
+                                           !location.IsIdentity(),
+                                           logger.tracing());
+    kernel(face, topods_face, triangulation, location.Transformation(), logger);
+}
+
+/**
+ * @brief Copies the face local triangle indices of all faces into one array of type T
+ *
+ * @tparam T Index type (uint16_t or uint32_t)
+ * @return Buffer of 3 * num_triangles indices
+ */
+template <typename T>
+Buffer<T> pack_local_indices(const FaceData face_list[], int num_faces, int num_triangles)
+{
+    Buffer<T> indices(3 * size_t(num_triangles));
+    int t_total = 0;
+    for (int i = 0; i < num_faces; i++)
+    {
+        const FaceData &f = face_list[i];
+        for (int j = 0; j < 3 * f.num_triangles; j++)
+        {
+            indices[t_total + j] = static_cast<T>(f.triangles[j]);
+        }
+        t_total += 3 * f.num_triangles;
+    }
+    return indices;
+}
+
+/**
+ * @brief Collects and processes mesh data from face and edge lists into unified buffers.
+ *
+ * This function aggregates vertex, triangle, and edge data from multiple faces and edges into
+ * consolidated arrays. It can optionally compute missing vertex normals using face normal
+ * interpolation and generate triangle edges when edge data is not provided.
+ *
+ * @param face_list Array of FaceData structures containing face geometry information
+ * @param num_vertices Total number of vertices across all faces
+ * @param num_triangles Total number of triangles across all faces
+ * @param num_faces Number of faces in the face_list array
+ * @param edge_list Array of EdgeData structures containing edge segment information
+ * @param num_segments Total number of edge segments across all edges
+ * @param num_edges Number of edges in the edge_list array
+ * @param obj_vertices Array of additional object vertices (external geometry)
+ * @param num_obj_vertices Number of vertices in obj_vertices array
+ * @param compute_missing_normals If true, computes vertex normals by interpolating face normals
+ * @param compute_missing_edges If true, generates edge segments from triangle edges when edge data is unavailable
+ * @param local_indices If true, triangle indices stay local to each face and use uint16 when possible
+ * @param optimize_order If true, triangles of each face are reordered for vertex cache reuse and
+ *        vertices renumbered in order of first use (in parallel across faces)
+ * @param arena Arena for the intermediate double precision arrays
+ * @param timeit If true, enables timing measurements for performance profiling
+ *
+ * @return MeshBuffers containing the consolidated mesh geometry
+ *
+ * @details The function performs the following operations:
+ * - Optionally reorders the triangles and vertices of each face in place (face grouping kept)
+ * - Consolidates vertices, normals, and triangles from all faces into unified arrays
+ * - Optionally computes vertex normals by averaging adjacent face normals and normalizing
+ * - Collects edge segments from provided edge data or generates them from triangle edges
+ * - Converts all floating-point data from double to float precision
+ * - Rebases the face local triangle indices to global indices, or packs them per face as
+ *   uint16 (all faces have fewer than 65536 vertices) or uint32 in local index mode
+ * - Tracks triangles and segments per face/edge for proper indexing, and the vertex and
+ *   index offsets of every face
+ * - Collects the per face and per edge bounding boxes and merges them into an overall box
+ * - Includes timing measurements for performance analysis when enabled
+ *
+ * @note Intermediate arrays live in the arena of the caller. The returned buffers are allocated
+ *       with new[], so that the Python layer can hand them over to numpy without copying.
+ */
+
+MeshBuffers collect_mesh_buffers(
+    FaceData face_list[],
+    int num_vertices,
+    int num_triangles,
+    int num_faces,
+    EdgeData edge_list[],
+    int num_segments,
+    int num_edges,
+    double obj_vertices[],
+    int num_obj_vertices,
+    bool compute_missing_normals,
+    bool compute_missing_edges,
+    bool local_indices,
+    bool optimize_order,
+    Arena &arena,
+    bool timeit)
+{
+    Timer timer;
+
+    if (optimize_order)
+    {
+        timer.start("Optimize triangle and vertex order", 2, timeit);
+
+        OSD_Parallel::For(0, num_faces, [&](int i)
+                          {
+            FaceData &f = face_list[i];
+            optimize_vertex_cache(f.triangles, f.num_triangles, f.num_vertices);
+            reorder_vertices(f.vertices, f.normals, f.triangles, f.num_triangles, f.num_vertices); }, num_faces < 64);
+
+        timer.stop();
+    }
+
+    /*
+     * Collect vertices and triangles
+     */
+
+    timer.start("Collect vertices and triangles", 2, timeit);
+
+    auto vertices = arena.allocate<double>(3 * num_vertices);
+    auto normals = arena.allocate<double>(3 * num_vertices);
+    // global indices are needed for missing normals and edges, in local mode only as scratch
+    auto triangles = local_indices ? arena.allocate<int>(3 * num_triangles) : new int[3 * num_triangles];
+    Buffer<int> triangles_per_face(num_faces);
+    Buffer<int> face_types(num_faces);
+    Buffer<int> vertex_offsets(num_faces + 1);
+    Buffer<int> index_offsets(num_faces + 1);
+    auto face_bounds = arena.allocate<double>(6 * num_faces);
+
+    int max_face_vertices = 0;
+
+    double bounds[6];
+    reset_bounds(bounds);
+
+    int v_total = 0;
+    int t_total = 0;
+
+    for (int i = 0; i < num_faces; i++)
+    {
+
+        auto f = face_list[i];
+
+        auto v = f.vertices;
+        auto n = f.normals;
+        auto t = f.triangles;
+
+        int v_base = v_total / 3;
+
+        for (int j = 0; j < f.num_vertices * 3; j++)
+        {
+            vertices[v_total + j] = v[j];
+            normals[v_total + j] = n[j];
+        }
+
+        for (int j = 0; j < f.num_triangles * 3; j++)
+        {
+            triangles[t_total + j] = v_base + t[j];
+        }
+
+        triangles_per_face[i] = f.num_triangles;
+        face_types[i] = f.face_type;
+        vertex_offsets[i] = v_base;
+        index_offsets[i] = t_total;
+        max_face_vertices = std::max(max_face_vertices, static_cast<int>(f.num_vertices));
+
+        for (int k = 0; k < 6; k++)
+        {
+            face_bounds[6 * i + k] = f.bounds[k];
+        }
+        merge_bounds(bounds, f.bounds);
+
+        v_total += 3 * f.num_vertices;
+        t_total += 3 * f.num_triangles;
+    }
+    vertex_offsets[num_faces] = v_total / 3;
+    index_offsets[num_faces] = t_total;
+
+    if (compute_missing_normals)
+    {
+        timer.reset("Interpolating normals", 2);
+
+        for (int i = 0; i < 3 * num_vertices; i++)
+        {
+            normals[i] = 0.0;
+        }
+
+        for (int i = 0; i < num_triangles; i++)
+        {
+            double c0_0 = (vertices[3 * triangles[3 * i + 0] + 0]);
+            double c0_1 = (vertices[3 * triangles[3 * i + 0] + 1]);
+            double c0_2 = (vertices[3 * triangles[3 * i + 0] + 2]);
+            double c1_0 = (vertices[3 * triangles[3 * i + 1] + 0]);
+            double c1_1 = (vertices[3 * triangles[3 * i + 1] + 1]);
+            double c1_2 = (vertices[3 * triangles[3 * i + 1] + 2]);
+            double c2_0 = (vertices[3 * triangles[3 * i + 2] + 0]);
+            double c2_1 = (vertices[3 * triangles[3 * i + 2] + 1]);
+            double c2_2 = (vertices[3 * triangles[3 * i + 2] + 2]);
+            // c2 - c1
+            double v1_0 = (c2_0 - c1_0);
+            double v1_1 = (c2_1 - c1_1);
+            double v1_2 = (c2_2 - c1_2);
+            // c0 - c1
+            double v2_0 = (c0_0 - c1_0);
+            double v2_1 = (c0_1 - c1_1);
+            double v2_2 = (c0_2 - c1_2);
+            // cross product of v1 and v2
+            double n_0 = (v1_1 * v2_2 - v1_2 * v2_1);
+            double n_1 = (v1_2 * v2_0 - v1_0 * v2_2);
+            double n_2 = (v1_0 * v2_1 - v1_1 * v2_0);
+            // interpolate vertex normal by blending all face normals of a vertex
+            for (int j = 0; j < 3; j++)
+            {
+                normals[3 * triangles[3 * i + j] + 0] += n_0;
+                normals[3 * triangles[3 * i + j] + 1] += n_1;
+                normals[3 * triangles[3 * i + j] + 2] += n_2;
+            }
+        }
+        // and normalize later
+        for (int i = 0; i < num_vertices; i++)
+        {
+            double norm = sqrt(normals[3 * i] * normals[3 * i] + normals[3 * i + 1] * normals[3 * i + 1] + normals[3 * i + 2] * normals[3 * i + 2]);
+            normals[3 * i] /= norm;
+            normals[3 * i + 1] /= norm;
+            normals[3 * i + 2] /= norm;
+        }
+    }
+
+    /*
+     * Collect segments
+     */
+    int e_total = 0;
+
+    if (compute_missing_edges)
+    {
+        // every triangle becomes an edge with 3 segments
+        num_edges = num_triangles;
+        num_segments = 3 * num_triangles;
+    }
+
+    auto segments = arena.allocate<double>(6 * num_segments);
+    Buffer<int> segments_per_edge(num_edges);
+    Buffer<int> edge_types(num_edges);
+    auto edge_bounds = arena.allocate<double>(6 * num_edges);
+
+    if (compute_missing_edges)
+    {
+        timer.reset("Compute missing edges", 2);
+
+        for (int i = 0; i < num_triangles; i++)
+        {
+            double c0_0 = vertices[3 * triangles[3 * i + 0] + 0];
+            double c0_1 = vertices[3 * triangles[3 * i + 0] + 1];
+            double c0_2 = vertices[3 * triangles[3 * i + 0] + 2];
+            double c1_0 = vertices[3 * triangles[3 * i + 1] + 0];
+            double c1_1 = vertices[3 * triangles[3 * i + 1] + 1];
+            double c1_2 = vertices[3 * triangles[3 * i + 1] + 2];
+            double c2_0 = vertices[3 * triangles[3 * i + 2] + 0];
+            double c2_1 = vertices[3 * triangles[3 * i + 2] + 1];
+            double c2_2 = vertices[3 * triangles[3 * i + 2] + 2];
+            segments[e_total + 0] = c0_0;
+            segments[e_total + 1] = c0_1;
+            segments[e_total + 2] = c0_2;
+            segments[e_total + 3] = c1_0;
+            segments[e_total + 4] = c1_1;
+            segments[e_total + 5] = c1_2;
+            segments[e_total + 6] = c1_0;
+            segments[e_total + 7] = c1_1;
+            segments[e_total + 8] = c1_2;
+            segments[e_total + 9] = c2_0;
+            segments[e_total + 10] = c2_1;
+            segments[e_total + 11] = c2_2;
+            segments[e_total + 12] = c2_0;
+            segments[e_total + 13] = c2_1;
+            segments[e_total + 14] = c2_2;
+            segments[e_total + 15] = c0_0;
+            segments[e_total + 16] = c0_1;
+            segments[e_total + 17] = c0_2;
+            e_total += 18;
+            segments_per_edge[i] = 3;
+            edge_types[i] = GeomAbs_Line;
+
+            // the triangle edges are covered by the face boxes, so only the edge box is needed
+            reset_bounds(&edge_bounds[6 * i]);
+            extend_bounds(&edge_bounds[6 * i], c0_0, c0_1, c0_2);
+            extend_bounds(&edge_bounds[6 * i], c1_0, c1_1, c1_2);
+            extend_bounds(&edge_bounds[6 * i], c2_0, c2_1, c2_2);
+        }
+    }
+    else
+    {
+        timer.reset("Collecting edges", 2);
+        for (int i = 0; i < num_edges; i++)
+        {
+            auto e = edge_list[i];
+
+            for (int j = 0; j < 6 * e.num_segments; j++)
+            {
+                segments[e_total + j] = e.segments[j];
+            }
+            segments_per_edge[i] = e.num_segments;
+            edge_types[i] = e.edge_type;
+
+            for (int k = 0; k < 6; k++)
+            {
+                edge_bounds[6 * i + k] = e.bounds[k];
+            }
+            merge_bounds(bounds, e.bounds);
+
+            e_total += 6 * e.num_segments;
+        }
+    }
+
+    for (int i = 0; i < num_obj_vertices; i++)
+    {
+        extend_bounds(bounds, obj_vertices[3 * i], obj_vertices[3 * i + 1], obj_vertices[3 * i + 2]);
+    }
+
+    timer.reset("Cast to float", 2);
+
+    MeshBuffers buffers;
+    buffers.vertices = Buffer<float>(convert_to_float(vertices, 3 * num_vertices), 3 * num_vertices);
+    buffers.normals = Buffer<float>(convert_to_float(normals, 3 * num_vertices), 3 * num_vertices);
+    if (!local_indices)
+    {
+        buffers.triangles = Buffer<int32_t>(triangles, 3 * num_triangles);
+    }
+    else if (max_face_vertices < 65536)
+    {
+        buffers.triangles = pack_local_indices<uint16_t>(face_list, num_faces, num_triangles);
+    }
+    else
+    {
+        buffers.triangles = pack_local_indices<uint32_t>(face_list, num_faces, num_triangles);
+    }
+    buffers.local_indices = local_indices;
+    buffers.vertex_offsets = std::move(vertex_offsets);
+    buffers.index_offsets = std::move(index_offsets);
+    buffers.triangles_per_face = std::move(triangles_per_face);
+    buffers.face_types = std::move(face_types);
+    buffers.edge_types = std::move(edge_types);
+    buffers.obj_vertices = Buffer<float>(convert_to_float(obj_vertices, 3 * num_obj_vertices), 3 * num_obj_vertices);
+    buffers.segments = Buffer<float>(convert_to_float(segments, 6 * num_segments), 6 * num_segments);
+    buffers.segments_per_edge = std::move(segments_per_edge);
+    buffers.face_bounds = Buffer<float>(convert_to_float(face_bounds, 6 * num_faces), 6 * num_faces);
+    buffers.edge_bounds = Buffer<float>(convert_to_float(edge_bounds, 6 * num_edges), 6 * num_edges);
+    buffers.bounds = Buffer<float>(convert_to_float(bounds, 6), 6);
+
+    timer.stop();
+
+    return buffers;
+}
+
+float *convert_to_float(const double *input, size_t size)
+{
+    float *result = new float[size];
+    for (size_t i = 0; i < size; ++i)
+    {
+        result[i] = static_cast<float>(input[i]);
+    }
+    return result; // Caller is responsible for delete[]
+}
+
+Buffer<int> vertex_face_indices(const int *vertex_offsets, int num_faces)
+{
+    const int num_vertices = num_faces > 0 ? vertex_offsets[num_faces] : 0;
+    Buffer<int> vertex_faces(num_vertices);
+    int *data = vertex_faces.get();
+    OSD_Parallel::For(0, num_faces, [&](int i)
+                      { std::fill(data + vertex_offsets[i], data + vertex_offsets[i + 1], i); }, num_faces < 64);
+    return vertex_faces;
+}
+
+void compact_flat_normals(MeshBuffers &buffers)
+{
+    const int num_faces = buffers.num_faces();
+    const int *vertex_offsets = buffers.vertex_offsets.get();
+    const int *face_types = buffers.face_types.get();
+
+    Buffer<float> face_normals(3 * size_t(num_faces));
+    Buffer<int> flat_faces(num_faces);
+    Buffer<int> normal_offsets(num_faces + 1);
+
+    normal_offsets[0] = 0;
+    for (int i = 0; i < num_faces; i++)
+    {
+        flat_faces[i] = face_types[i] == GeomAbs_Plane ? 1 : 0;
+        normal_offsets[i + 1] = normal_offsets[i] + (flat_faces[i] ? 0 : vertex_offsets[i + 1] - vertex_offsets[i]);
+    }
+
+    Buffer<float> normals(3 * size_t(normal_offsets[num_faces]));
+    const float *vertex_normals = buffers.normals.get();
+
+    OSD_Parallel::For(0, num_faces, [&](int i)
+                      {
+        const float *first = vertex_normals + 3 * size_t(vertex_offsets[i]);
+        const float *last = vertex_normals + 3 * size_t(vertex_offsets[i + 1]);
+        float *face_normal = face_normals.get() + 3 * size_t(i);
+        std::fill(face_normal, face_normal + 3, 0.0f);
+        if (!flat_faces[i])
+            std::copy(first, last, normals.get() + 3 * size_t(normal_offsets[i]));
+        else if (first != last)
+            std::copy(first, first + 3, face_normal); // all vertices of a plane share the normal
+    }, num_faces < 64);
+
+    buffers.normals = std::move(normals);
+    buffers.face_normals = std::move(face_normals);
+    buffers.flat_faces = std::move(flat_faces);
+    buffers.normal_offsets = std::move(normal_offsets);
+}
+
+/**
+ * @brief Sets the edge to face adjacency of the serial edge pass and its transpose, the face to
+ *        edge adjacency (edges in ascending order per face)
+ */
+void set_adjacency(MeshBuffers &buffers, const std::vector<int> &edge_face_offsets,
+                   const std::vector<int> &edge_faces, int num_faces)
+{
+    const int num_edges = static_cast<int>(edge_face_offsets.size()) - 1;
+    const int num_entries = static_cast<int>(edge_faces.size());
+
+    Buffer<int> ef_offsets(num_edges + 1);
+    Buffer<int> ef(num_entries);
+    Buffer<int> fe_offsets(num_faces + 1);
+    Buffer<int> fe(num_entries);
+
+    std::copy(edge_face_offsets.begin(), edge_face_offsets.end(), ef_offsets.get());
+    std::copy(edge_faces.begin(), edge_faces.end(), ef.get());
+
+    // counting sort by face
+    std::fill(fe_offsets.get(), fe_offsets.get() + num_faces + 1, 0);
+    for (int face : edge_faces)
+        fe_offsets[face + 1]++;
+    for (int i = 0; i < num_faces; i++)
+        fe_offsets[i + 1] += fe_offsets[i];
+    std::vector<int> fill(fe_offsets.get(), fe_offsets.get() + num_faces);
+    for (int e = 0; e < num_edges; e++)
+        for (int k = edge_face_offsets[e]; k < edge_face_offsets[e + 1]; k++)
+            fe[fill[edge_faces[k]]++] = e;
+
+    buffers.edge_face_offsets = std::move(ef_offsets);
+    buffers.edge_faces = std::move(ef);
+    buffers.face_edge_offsets = std::move(fe_offsets);
+    buffers.face_edges = std::move(fe);
+}
+
+/**
+ * @brief Tessellates a TopoDS_Shape into buffers with vertices, triangles, and edges.
+ *
+ * This function performs mesh tessellation on an OpenCascade TopoDS_Shape object, generating
+ * triangulated faces, edge segments, and vertex data. It uses BRepMesh_IncrementalMesh for
+ * the underlying tessellation and supports parallel processing.
+ *
+ * @param shape The TopoDS_Shape object to tessellate
+ * @param params Tessellation parameters (see tessellate() in tessellator.h for their meaning)
+ * @param indicator Progress indicator to report to and to check for cancellation (may be null)
+ *
+ * @return MeshBuffers containing:
+ *         - vertices: Array of vertex coordinates (x,y,z)
+ *         - normals: Array of vertex normals (if available)
+ *         - triangles: Array of triangle indices (global int32, or face local uint16/uint32)
+ *         - vertex_offsets: First vertex of each face (plus total)
+ *         - index_offsets: First triangle index of each face (plus total)
+ *         - triangles_per_face: Number of triangles per face
+ *         - face_types: Type classification for each face
+ *         - segments: Array of edge segment coordinates
+ *         - segments_per_edge: Number of segments per edge
+ *         - edge_types: Type classification for each edge
+ *         - obj_vertices: Original shape vertices
+ *         - face_bounds: Bounding box per face
+ *         - edge_bounds: Bounding box per edge
+ *         - bounds: Bounding box of the whole shape
+ *         - edge_face_offsets, edge_faces, face_edge_offsets, face_edges, vertex_faces:
+ *           adjacency and per vertex face indices (only with adjacency)
+ *
+ * @note The function handles orientation correction for reversed faces and computes normals
+ *       when UV nodes are available in the triangulation. Edge processing requires face
+ *       ancestors to be present.
+ *
+ * @note All scratch memory (face and edge lists and their buffers) is taken from a monotonic
+ *       arena that is released as a whole when the function returns. Only the final arrays
+ *       are owned by the returned MeshBuffers.
+ *
+ * @note In relative mode deflection is a factor: the mesher computes the shape bounding box
+ *       and scales the deflection of every edge by its size (adjusted to the shape size) and of
+ *       every face by the face size, keeping shared edges consistent. Small features get finer,
+ *       large faces coarser triangles. The upper limit is enforced by first meshing the shape
+ *       with max_deflection; faces whose relative deflection would be coarser keep that mesh.
+ *
+ * @note Face and edge extraction run in two passes: a serial pass fetches the triangulations
+ *       and takes the buffers from the arena, a parallel pass on the OCCT default thread pool
+ *       fills them. The mesher uses the same pool, see configure_threads() to size it.
+ *
+ * @note With heal, faces whose triangulation is null after meshing are healed and re-meshed
+ *       in parallel (see heal_face()) and their triangulations merged back in before the
+ *       extraction. Their boundary edges are discretized from the curves, so the vertices of
+ *       a healed face need not coincide with the ones of its neighbors.
+ *
+ * @throws TessellationCancelled if the progress indicator reports a user break.
+ *         Meshing, face and edge extraction take 70%, 20% and 10% of the progress range.
+ */
+
+MeshBuffers tessellate_shape(const TopoDS_Shape &shape, const TessellateParams &params,
+                             const Handle(CancellableProgress) &indicator)
+{
+    const double deflection = params.deflection;
+    const double angular_tolerance = params.angular_tolerance;
+    const bool compute_faces = params.compute_faces;
+    const bool compute_edges = params.compute_edges;
+    const bool relative = params.relative;
+    const double min_size = params.min_size;
+    const double max_deflection = params.max_deflection;
+    const int threads = params.threads;
+    const bool adjacency = params.adjacency;
+    const bool timeit = params.timeit;
+
+    /*
+     * Tessellate mesh
+     */
+
+    Logger logger(params.debug);
+    Timer timer;
+
+    Arena arena;
+
+    // threads = 1 runs everything serially, otherwise the pool size caps the mesher and
+    // threads additionally caps the extraction stages; tracing is only readable serially
+    const Handle(OSD_ThreadPool) &thread_pool = OSD_ThreadPool::DefaultPool();
+    const bool parallel = params.parallel && threads != 1;
+    int extraction_threads = (parallel && params.debug < 3) ? default_pool_threads(thread_pool) : 1;
+    if (threads > 0)
+        extraction_threads = std::min(extraction_threads, threads);
+    int used_threads = 1;
+
+    // without indicator the scopes work on an empty range and cost nothing
+    Message_ProgressRange progress_range;
+    if (!indicator.IsNull())
+        progress_range = indicator->Start();
+    Message_ProgressScope progress_scope(progress_range, "Tessellation", 100);
+
+    // also the base of the relaxed parameters for healed faces
+    IMeshTools_Parameters parameters;
+
+    if (compute_edges || compute_faces)
+    {
+        logger.info("deflection", deflection, "angular_tolerance", angular_tolerance, "parallel", parallel,
+                    "relative", relative, "threads", threads);
+        timer.start("Computing BRep incremental mesh", 1, timeit);
+
+        // https://dev.opencascade.org/node/81262#comment-21130
+        // BRepTools::Clean(shape);
+        parameters.Deflection = deflection;
+        parameters.DeflectionInterior = deflection;
+        parameters.Angle = angular_tolerance;
+        parameters.AngleInterior = angular_tolerance;
+        parameters.Relative = Standard_False;
+        parameters.InParallel = parallel;
+
+        Message_ProgressScope mesh_scope(progress_scope.Next(70), "Meshing", 2);
+
+        if (relative)
+        {
+            if (max_deflection > 0.0)
+            {
+                // coarse pass; the relative pass below only refines faces that need it
+                IMeshTools_Parameters coarse = parameters;
+                coarse.Deflection = max_deflection;
+                coarse.DeflectionInterior = max_deflection;
+                BRepMesh_IncrementalMesh coarse_mesher(shape, coarse, mesh_scope.Next());
+                logger.debug("coarse pass IsDone", coarse_mesher.IsDone());
+            }
+
+            parameters.Relative = Standard_True;
+            parameters.AllowQualityDecrease = Standard_False;
+            if (min_size > 0.0)
+                parameters.MinSize = min_size;
+        }
+        else
+        {
+            mesh_scope.Next();
+        }
+
+        BRepMesh_IncrementalMesh mesher(shape, parameters, mesh_scope.Next());
+        logger.debug("IsDone", mesher.IsDone());
+        logger.debug("GetStatusFlags", mesher.GetStatusFlags());
+
+        timer.stop();
+
+        if (!indicator.IsNull())
+            indicator->check_cancelled();
+    }
+    int has_normals = false; // assumption: if one face has no normal, no faces has normals
+    int num_faces = 0;
+    FaceData *face_list = nullptr;
+
+    int total_num_vertices = 0;
+    int total_num_triangles = 0;
+
+    // also needed for the edge to face adjacency, which requires compute_faces
+    TopTools_IndexedMapOfShape face_map = TopTools_IndexedMapOfShape();
+    if (compute_faces)
+        TopExp::MapShapes(shape, TopAbs_FACE, face_map);
+
+    if (compute_faces)
+    {
+        timer.start("Computing tessellation", 1, timeit);
+
+        num_faces = face_map.Extent();
+        arena.reserve(num_faces * ARENA_BYTES_PER_FACE);
+        face_list = arena.allocate<FaceData>(num_faces);
+        for (int i = 0; i < num_faces; i++)
+        {
+            // keep faces that are not reached due to an exception empty
+            face_list[i] = FaceData();
+            face_list[i].face_type = -1;
+            reset_bounds(face_list[i].bounds);
+        }
+
+        logger.debug("num_faces", num_faces);
+
+        Message_ProgressScope face_scope(progress_scope.Next(20), "Faces", num_faces);
+
+        // Serial pass: fetch the triangulations and take the buffers from the arena, which is
+        // not thread safe. Progress ranges are handed out here, closing them is thread safe.
+        std::vector<Handle(Poly_Triangulation)> triangulations(num_faces);
+        std::vector<TopLoc_Location> locations(num_faces);
+        std::vector<Message_ProgressRange> face_ranges(num_faces);
+        // with heal: healed copies of the faces whose triangulation is null (null otherwise)
+        std::vector<TopoDS_Face> healed_faces;
+
+        auto allocate_face = [&](int i)
+        {
+            const Standard_Integer num_nodes = triangulations[i]->NbNodes();
+            const Standard_Integer num_triangles = triangulations[i]->NbTriangles();
+
+            face_list[i].vertices = arena.allocate<Standard_Real>(num_nodes * 3);
+            face_list[i].normals = arena.allocate<Standard_Real>(num_nodes * 3);
+            face_list[i].triangles = arena.allocate<Standard_Integer>(num_triangles * 3);
+
+            if (triangulations[i]->HasUVNodes())
+                has_normals = true;
+        };
+
+        std::vector<int> failed_faces;
+        for (int i = 0; i < num_faces; i++)
+        {
+            face_ranges[i] = face_scope.Next();
+
+            const TopoDS_Face &topods_face = TopoDS::Face(face_map.FindKey(i + 1));
+            triangulations[i] = BRep_Tool::Triangulation(topods_face, locations[i]);
+
+            if (triangulations[i].IsNull())
+            {
+                logger.info("=> warning: Triangulation is null for face ", i, "\n");
+                failed_faces.push_back(i);
+                continue;
+            }
+
+            allocate_face(i);
+        }
+
+        if (params.heal && !failed_faces.empty())
+        {
+            Timer heal_timer("Healing faces", 2, timeit);
+
+            // Parallel pass: every face heals and meshes its own copy
+            healed_faces.resize(num_faces);
+            OSD_ThreadPool::Launcher launcher(*OSD_ThreadPool::DefaultPool(), extraction_threads);
+            launcher.Perform(0, static_cast<int>(failed_faces.size()), [&](int, int k)
+                             {
+                const int i = failed_faces[k];
+                if (indicator.IsNull() || !indicator->UserBreak())
+                    healed_faces[i] = heal_face(TopoDS::Face(face_map.FindKey(i + 1)), parameters, logger); });
+
+            // Serial pass: merge the recovered triangulations back in
+            int num_healed = 0;
+            for (int i : failed_faces)
+            {
+                if (healed_faces[i].IsNull())
+                    continue;
+                triangulations[i] = BRep_Tool::Triangulation(healed_faces[i], locations[i]);
+                allocate_face(i);
+                num_healed++;
+            }
+            logger.info("healed faces", num_healed, "of", failed_faces.size());
+
+            heal_timer.stop();
+        }
+
+        // Parallel pass: every face writes to its own buffers only
+        auto extract_face = [&](int, int i)
+        {
+            Message_ProgressRange &range = face_ranges[i];
+            const Handle(Poly_Triangulation) &triangulation = triangulations[i];
+
+            if (triangulation.IsNull() || (!indicator.IsNull() && indicator->UserBreak()))
+            {
+                range.Close();
+                return;
+            }
+
+            const TopoDS_Face &topods_face = healed_faces.empty() || healed_faces[i].IsNull()
+                                                 ? TopoDS::Face(face_map.FindKey(i + 1))
+                                                 : healed_faces[i];
+            const TopLoc_Location &loc = locations[i];
+
+            extract_face_data(face_list[i], topods_face, *triangulation, loc, logger);
+
+            face_list[i].face_type = get_face_type(topods_face);
+
+            range.Close();
+        };
+
+        try
+        {
+            OSD_ThreadPool::Launcher launcher(*OSD_ThreadPool::DefaultPool(), extraction_threads);
+            launcher.Perform(0, num_faces, extract_face);
+            used_threads = std::max(used_threads, launcher.NbThreads());
+        }
+        catch (Standard_Failure &e)
+        {
+            logger.error(e.GetMessageString());
+        }
+        catch (...)
+        {
+            logger.error("unknown");
+        }
+
+        // faces that were not reached (exception or cancel) stay empty
+        for (int i = 0; i < num_faces; i++)
+        {
+            total_num_vertices += face_list[i].num_vertices;
+            total_num_triangles += face_list[i].num_triangles;
+        }
+
+        timer.stop();
+
+        if (!indicator.IsNull())
+            indicator->check_cancelled();
+    }
+
+    /*
+     * Compute edges
+     */
+
+    int num_edges = 0;
+
+    int total_num_segments = 0;
+    EdgeData *edge_list = nullptr;
+
+    // edge to face adjacency (CSR), filled in the serial edge pass
+    std::vector<int> edge_face_offsets;
+    std::vector<int> edge_faces;
+
+    if (compute_edges)
+    {
+        timer.start("Computing edges", 1, timeit);
+
+        TopTools_IndexedMapOfShape edge_map = TopTools_IndexedMapOfShape();
+        TopTools_IndexedDataMapOfShapeListOfShape ancestor_map = TopTools_IndexedDataMapOfShapeListOfShape();
+
+        TopExp::MapShapes(shape, TopAbs_EDGE, edge_map);
+        TopExp::MapShapesAndAncestors(shape, TopAbs_EDGE, TopAbs_FACE, ancestor_map);
+
+        num_edges = edge_map.Extent();
+        arena.reserve(num_edges * ARENA_BYTES_PER_EDGE);
+        edge_list = arena.allocate<EdgeData>(num_edges);
+
+        Message_ProgressScope edge_scope(progress_scope.Next(10), "Edges", num_edges);
+
+        // Serial pass: find the polygons on triangulation and take the buffers from the arena
+        std::vector<Handle(Poly_Triangulation)> triangulations(num_edges);
+        std::vector<Handle(Poly_PolygonOnTriangulation)> polygons(num_edges);
+        std::vector<TopLoc_Location> locations(num_edges);
+        std::vector<Message_ProgressRange> edge_ranges(num_edges);
+        // edges without polygon on triangulation are discretized from their curve
+        std::vector<std::vector<gp_Pnt>> free_edge_points(num_edges);
+        int num_free_edges = 0;
+
+        if (adjacency)
+        {
+            edge_face_offsets.reserve(num_edges + 1);
+            edge_face_offsets.push_back(0);
+            edge_faces.reserve(2 * num_edges);
+        }
+
+        for (int i = 0; i < num_edges; i++)
+        {
+            edge_ranges[i] = edge_scope.Next();
+
+            edge_list[i].segments = nullptr;
+            edge_list[i].num_segments = 0;
+            edge_list[i].edge_type = -1;
+            reset_bounds(edge_list[i].bounds);
+
+            const TopTools_ListOfShape &face_list = ancestor_map.FindFromIndex(i + 1);
+
+            if (adjacency)
+            {
+                // seam edges list their face twice
+                for (const TopoDS_Shape &ancestor : face_list)
+                {
+                    int face = face_map.FindIndex(ancestor) - 1;
+                    if (face >= 0 && std::find(edge_faces.begin() + edge_face_offsets.back(), edge_faces.end(), face) == edge_faces.end())
+                        edge_faces.push_back(face);
+                }
+                edge_face_offsets.push_back(static_cast<int>(edge_faces.size()));
+            }
+
+            if (face_list.Extent() > 0)
+            {
+                const TopoDS_Face &topods_face = TopoDS::Face(face_list.First());
+                const TopoDS_Edge &topods_edge = TopoDS::Edge(edge_map(i + 1));
+
+                triangulations[i] = BRep_Tool::Triangulation(topods_face, locations[i]);
+                polygons[i] = BRep_Tool::PolygonOnTriangulation(topods_edge, triangulations[i], locations[i]);
+
+                if (!polygons[i].IsNull())
+                {
+                    int num_nodes = polygons[i]->NbNodes();
+                    edge_list[i].segments = arena.allocate<Standard_Real>(6 * (num_nodes - 1));
+                }
+                else
+                {
+                    logger.debug("=> warning: no face polygon for egde ", i);
+                    num_free_edges++;
+                }
+            }
+            else
+            {
+                logger.debug("=> no face ancestors for egde ", i);
+                num_free_edges++;
+            }
+        }
+
+        // Parallel pass: every edge writes to its own buffer only
+        auto extract_edge = [&](int, int i)
+        {
+            Message_ProgressRange &range = edge_ranges[i];
+            const Handle(Poly_PolygonOnTriangulation) &poly = polygons[i];
+
+            if (!indicator.IsNull() && indicator->UserBreak())
+            {
+                range.Close();
+                return;
+            }
+
+            if (poly.IsNull())
+            {
+                free_edge_points[i] = discretize_free_edge(TopoDS::Edge(edge_map(i + 1)), deflection, angular_tolerance,
+                                                           relative, min_size, max_deflection);
+                range.Close();
+                return;
+            }
+
+            const Handle(Poly_Triangulation) &triangulation = triangulations[i];
+            const TopLoc_Location &loc = locations[i];
+            int num_nodes = poly->NbNodes();
+
+            for (int j = 0; j < num_nodes - 1; j++)
+            {
+                gp_Pnt p1 = triangulation->Node(poly->Node(j + 1)).Transformed(loc).Coord();
+                gp_Pnt p2 = triangulation->Node(poly->Node(j + 2)).Transformed(loc).Coord();
+                edge_list[i].segments[j * 6 + 0] = p1.X();
+                edge_list[i].segments[j * 6 + 1] = p1.Y();
+                edge_list[i].segments[j * 6 + 2] = p1.Z();
+                edge_list[i].segments[j * 6 + 3] = p2.X();
+                edge_list[i].segments[j * 6 + 4] = p2.Y();
+                edge_list[i].segments[j * 6 + 5] = p2.Z();
+                extend_bounds(edge_list[i].bounds, p1.X(), p1.Y(), p1.Z());
+                extend_bounds(edge_list[i].bounds, p2.X(), p2.Y(), p2.Z());
+            }
+
+            edge_list[i].num_segments = num_nodes - 1;
+            edge_list[i].edge_type = get_edge_type(TopoDS::Edge(edge_map(i + 1)));
+
+            range.Close();
+        };
+
+        try
+        {
+            OSD_ThreadPool::Launcher launcher(*OSD_ThreadPool::DefaultPool(), extraction_threads);
+            launcher.Perform(0, num_edges, extract_edge);
+            used_threads = std::max(used_threads, launcher.NbThreads());
+        }
+        catch (Standard_Failure &e)
+        {
+            logger.error(e.GetMessageString());
+        }
+        catch (...)
+        {
+            logger.error("unknown");
+        }
+
+        logger.debug("free edges", num_free_edges);
+
+        // edges that were not reached (exception or cancel) stay empty
+        for (int i = 0; i < num_edges; i++)
+        {
+            // the buffers of free edges are only known after sampling
+            if (!free_edge_points[i].empty())
+            {
+                set_edge_polyline(edge_list[i], free_edge_points[i], arena);
+                edge_list[i].edge_type = get_edge_type(TopoDS::Edge(edge_map(i + 1)));
+            }
+            total_num_segments += edge_list[i].num_segments;
+        }
+        timer.stop();
+
+        if (!indicator.IsNull())
+            indicator->check_cancelled();
+    }
+
+    /*
+     * Collect vertices
+     */
+
+    timer.start("Computing vertices", 1, timeit);
+
+    TopTools_IndexedMapOfShape vertex_map = TopTools_IndexedMapOfShape();
+    TopExp::MapShapes(shape, TopAbs_VERTEX, vertex_map);
+
+    int num_vertices = vertex_map.Extent();
+
+    double *vertex_list = arena.allocate<double>(3 * num_vertices);
+    for (int i = 0; i < num_vertices; i++)
+    {
+        const TopoDS_Vertex &topods_vertex = TopoDS::Vertex(vertex_map.FindKey(i + 1));
+        gp_Pnt p = BRep_Tool::Pnt(topods_vertex);
+        vertex_list[3 * i + 0] = p.X();
+        vertex_list[3 * i + 1] = p.Y();
+        vertex_list[3 * i + 2] = p.Z();
+    }
+
+    timer.reset("Collecting mesh data", 1);
+
+    auto result = collect_mesh_buffers(
+        face_list,
+        total_num_vertices,
+        total_num_triangles,
+        num_faces,
+        edge_list,
+        total_num_segments,
+        num_edges,
+        vertex_list,
+        num_vertices,
+        !has_normals,                             // interpolate normals
+        compute_edges ? (num_edges == 0) : false, // calculate all triangles edges
+        params.local_indices,
+        params.optimize_order,
+        arena,
+        timeit);
+
+    if (adjacency)
+    {
+        if (compute_edges && num_edges == 0)
+        {
+            // without topological edges every triangle became an edge bounding only its own face
+            edge_face_offsets.assign(1, 0);
+            edge_faces.clear();
+            for (int i = 0; i < result.num_faces(); i++)
+                for (int t = 0; t < result.triangles_per_face[i]; t++)
+                {
+                    edge_faces.push_back(i);
+                    edge_face_offsets.push_back(static_cast<int>(edge_faces.size()));
+                }
+        }
+        if (compute_edges)
+            set_adjacency(result, edge_face_offsets, edge_faces, face_map.Extent());
+        result.vertex_faces = vertex_face_indices(result.vertex_offsets.get(), result.num_faces());
+    }
+
+    if (params.flat_normals)
+        compact_flat_normals(result);
+
+    logger.debug("arena: bytes", arena.bytes_used(), "blocks", arena.num_blocks());
+
+    result.mesh_threads = parallel ? default_pool_threads(thread_pool) : 1;
+    result.extraction_threads = used_threads;
+    logger.debug("threads: mesh", result.mesh_threads, "extraction", result.extraction_threads);
+
+    timer.stop();
+
+    return result;
+}
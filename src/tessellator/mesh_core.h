@@ -0,0 +1,306 @@
+#pragma once
+
+/**
+ * @file mesh_core.h
+ * @brief Python-free tessellation core
+ *
+ * tessellate_shape() meshes a TopoDS_Shape and returns plain contiguous buffers in the layout
+ * of MeshData; it neither needs an interpreter nor the GIL, so C++ applications can link the
+ * core directly (see the core target of the Makefile). The Python module (tessellator.h) is
+ * a thin layer that hands these buffers over to numpy without copying.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <variant>
+#include <vector>
+
+#include <BinTools.hxx>
+#include <Bnd_Box.hxx>
+#include <BndLib_Add3dCurve.hxx>
+#include <BRep_Builder.hxx>
+#include <BRepAdaptor_Curve.hxx>
+#include <BRepBuilderAPI_Copy.hxx>
+#include <BRepAdaptor_Surface.hxx>
+#include <BRepCheck_Analyzer.hxx>
+#include <BRepCheck_Analyzer.hxx>
+#include <BRepCheck_Result.hxx>
+#include <BRepGProp_Face.hxx>
+#include <BRepMesh_IncrementalMesh.hxx>
+#include <BRep_Tool.hxx>
+#include <BRepTools.hxx>
+#include <GCPnts_TangentialDeflection.hxx>
+#include <gp_Pnt.hxx>
+#include <gp_Pnt2d.hxx>
+#include <gp_Trsf.hxx>
+#include <gp_Vec.hxx>
+#include <IMeshTools_Parameters.hxx>
+#include <OSD_Parallel.hxx>
+#include <OSD_ThreadPool.hxx>
+#include <Poly_Polygon3D.hxx>
+#include <Poly_PolygonOnTriangulation.hxx>
+#include <Poly_Triangulation.hxx>
+#include <ShapeFix_Shape.hxx>
+#include <ShapeFix_Face.hxx>
+#include <ShapeFix_Edge.hxx>
+#include <TColgp_Array1OfPnt.hxx>
+#include <TopAbs_ShapeEnum.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopExp.hxx>
+#include <TopoDS_Edge.hxx>
+#include <TopoDS_Face.hxx>
+#include <TopoDS_Shape.hxx>
+#include <TopoDS_Vertex.hxx>
+#include <TopoDS.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+
+#include "cancel.h"
+
+/**
+ * @struct FaceData
+ * @brief Container for tessellated face geometry data
+ *
+ * Holds the raw geometric data for a single tessellated face including
+ * vertex coordinates, surface normals, triangle indices, and face classification.
+ *
+ * @var vertices Pointer to array of vertex coordinates (x,y,z triplets)
+ * @var normals Pointer to array of normal vectors (nx,ny,nz triplets)
+ * @var triangles Pointer to array of face local (0 based) triangle vertex indices
+ * @var num_vertices Total number of vertices in the face
+ * @var num_triangles Total number of triangles in the face
+ * @var face_type Classification type of the face geometry
+ * @var bounds Axis aligned bounding box of the face vertices (xmin,ymin,zmin,xmax,ymax,zmax)
+ */
+struct FaceData
+{
+    Standard_Real *vertices;
+    Standard_Real *normals;
+    Standard_Integer *triangles;
+    Standard_Integer num_vertices;
+    Standard_Integer num_triangles;
+    Standard_Integer face_type;
+    Standard_Real bounds[6];
+};
+
+/**
+ * @struct EdgeData
+ * @brief Container for tessellated edge geometry data
+ *
+ * Holds the geometric data for a single tessellated edge as line segments.
+ *
+ * @var segments Pointer to array of line segment endpoints
+ * @var num_segments Total number of line segments in the edge
+ * @var edge_type Classification type of the edge geometry
+ * @var bounds Axis aligned bounding box of the segment points (xmin,ymin,zmin,xmax,ymax,zmax)
+ */
+
+struct EdgeData
+{
+    Standard_Real *segments;
+    Standard_Integer num_segments;
+    Standard_Integer edge_type;
+    Standard_Real bounds[6];
+};
+
+/**
+ * @brief Owned contiguous array, allocated with new[] so that it can be handed over to numpy
+ */
+template <typename T>
+struct Buffer
+{
+    std::unique_ptr<T[]> data;
+    size_t size = 0;
+
+    Buffer() : data(new T[0]) {}
+    explicit Buffer(size_t n) : data(new T[n]), size(n) {}
+    /// Takes ownership of an array allocated with new[]
+    Buffer(T *ptr, size_t n) : data(ptr), size(n) {}
+
+    T *get() const { return data.get(); }
+    T &operator[](size_t i) const { return data[i]; }
+};
+
+/**
+ * @brief Triangle indices: global int32, or face local uint16/uint32
+ */
+using IndexBuffer = std::variant<Buffer<int32_t>, Buffer<uint16_t>, Buffer<uint32_t>>;
+
+/**
+ * @struct MeshBuffers
+ * @brief Result of tessellate_shape(), the arrays of MeshData as plain buffers
+ *
+ * See MeshData (tessellator.h) for the meaning of the arrays; coordinates are float, counts,
+ * offsets and types int32.
+ */
+struct MeshBuffers
+{
+    Buffer<float> vertices;
+    Buffer<float> normals;
+    IndexBuffer triangles;
+    bool local_indices = false;
+    Buffer<int> vertex_offsets;
+    Buffer<int> index_offsets;
+    Buffer<int> triangles_per_face;
+    Buffer<int> face_types;
+    Buffer<float> segments;
+    Buffer<int> segments_per_edge;
+    Buffer<int> edge_types;
+    Buffer<float> obj_vertices;
+    Buffer<float> face_bounds;
+    Buffer<float> edge_bounds;
+    Buffer<float> bounds;
+    int mesh_threads = 1;
+    int extraction_threads = 1;
+    Buffer<int> edge_face_offsets;
+    Buffer<int> edge_faces;
+    Buffer<int> face_edge_offsets;
+    Buffer<int> face_edges;
+    Buffer<int> vertex_faces;
+    Buffer<float> face_normals;
+    Buffer<int> flat_faces;
+    Buffer<int> normal_offsets;
+
+    int num_faces() const { return static_cast<int>(triangles_per_face.size); }
+    int num_edges() const { return static_cast<int>(segments_per_edge.size); }
+};
+
+/**
+ * @struct TessellateParams
+ * @brief Parameters of tessellate_shape(), see tessellate() for their meaning
+ */
+struct TessellateParams
+{
+    double deflection = 0.1;
+    double angular_tolerance = 0.3;
+    bool compute_faces = true;
+    bool compute_edges = true;
+    bool parallel = true;
+    int debug = 0;
+    bool timeit = false;
+    bool local_indices = false;
+    bool relative = false;
+    double min_size = 0.0;
+    double max_deflection = 0.0;
+    int threads = 0;
+    bool optimize_order = false;
+    bool adjacency = false;
+    bool heal = false;
+    bool flat_normals = false;
+};
+
+class Arena;
+class Logger;
+
+/**
+ * @brief Classification of the face surface (GeomAbs_SurfaceType)
+ */
+GeomAbs_SurfaceType get_face_type(TopoDS_Face face);
+
+/**
+ * @brief Classification of the edge curve (GeomAbs_CurveType)
+ */
+GeomAbs_CurveType get_edge_type(TopoDS_Edge edge);
+
+/**
+ * @brief Discretizes an edge that has no polygon on a triangulation (free edges of wires,
+ *        sketches and edge-only compounds, or edges of faces that failed to mesh)
+ *
+ * Uses the Polygon3D of the edge if the mesher created one, otherwise samples the curve with
+ * GCPnts_TangentialDeflection. In relative mode, deflection is scaled by the largest dimension
+ * of the edge box and limited by max_deflection; min_size is the minimum segment length.
+ * Thread safe.
+ *
+ * @return Points of the polyline in world coordinates, empty for degenerated edges, edges
+ *         without 3D curve or if sampling fails
+ */
+std::vector<gp_Pnt> discretize_free_edge(const TopoDS_Edge &edge, double deflection, double angular_tolerance,
+                                         bool relative, double min_size, double max_deflection);
+
+/**
+ * @brief Heals a copy of a face whose triangulation is null and meshes it with relaxed parameters
+ *
+ * The face is deep copied, so its edges (shared with the neighbors) stay untouched and faces
+ * can be healed in parallel. ShapeFix_Face fixes the wires, ShapeFix_Edge adds missing 3D
+ * curves and pcurves and fixes SameParameter and vertex tolerances. The copy is then meshed
+ * serially with deflection and angle coarsened, quality decrease allowed and no surface
+ * deflection control. Thread safe.
+ *
+ * @param parameters Mesher parameters of the shape, the base of the relaxed ones
+ * @return The healed copy carrying a triangulation, or a null face if it still fails
+ */
+TopoDS_Face heal_face(const TopoDS_Face &face, const IMeshTools_Parameters &parameters, const Logger &logger);
+
+/**
+ * @brief Fills vertices, normals and face local triangles of one face into its buffers
+ *
+ * Picks the extraction kernel for the orientation, normals and location of the face (see
+ * tessellator.cpp). The buffers must hold 3 * NbNodes and 3 * NbTriangles values; normals are
+ * left untouched if the triangulation has no UV nodes. Thread safe.
+ */
+void extract_face_data(FaceData &face, const TopoDS_Face &topods_face, const Poly_Triangulation &triangulation,
+                       const TopLoc_Location &location, const Logger &logger);
+
+/**
+ * @brief Sets segments (taken from the arena), num_segments and bounds of an edge from a polyline
+ */
+void set_edge_polyline(EdgeData &edge_data, const std::vector<gp_Pnt> &points, Arena &arena);
+
+/**
+ * @brief Consolidates face and edge lists into plain buffers (see mesh_core.cpp)
+ */
+MeshBuffers collect_mesh_buffers(FaceData face_list[], int num_vertices, int num_triangles, int num_faces,
+                                 EdgeData edge_list[], int num_segments, int num_edges,
+                                 double obj_vertices[], int num_obj_vertices,
+                                 bool compute_missing_normals, bool compute_missing_edges, bool local_indices,
+                                 bool optimize_order, Arena &arena, bool timeit);
+
+/**
+ * @brief Converts doubles to a new[] allocated float array (the caller owns it)
+ */
+float *convert_to_float(const double *input, size_t size);
+
+/**
+ * @brief Face index of every vertex, expanded from the vertex offsets of the faces
+ *
+ * @param vertex_offsets num_faces + 1 offsets
+ */
+Buffer<int> vertex_face_indices(const int *vertex_offsets, int num_faces);
+
+/**
+ * @brief Replaces the per vertex normals of planar faces by one normal per face
+ *
+ * Sets face_normals (3 per face, zero for curved faces), flat_faces (1 for planar faces)
+ * and normal_offsets (num_faces + 1, first normal of each face, empty ranges for planar
+ * faces) and keeps only the per vertex normals of curved faces in normals.
+ */
+void compact_flat_normals(MeshBuffers &buffers);
+
+/**
+ * @brief Tessellates a shape without Python
+ *
+ * Meshes the shape with BRepMesh_IncrementalMesh and extracts faces, edges and vertices in
+ * parallel on the OCCT default thread pool. Logging and timing go through the log sink (see
+ * log.h). Safe to call concurrently for different shapes.
+ *
+ * @param shape Shape to tessellate
+ * @param params Tessellation parameters
+ * @param indicator Receives the progress and is checked for cancellation (may be null)
+ * @return Buffers in the MeshData layout
+ * @throws TessellationCancelled if the progress reports a user break
+ */
+MeshBuffers tessellate_shape(const TopoDS_Shape &shape, const TessellateParams &params,
+                             const Handle(CancellableProgress) &indicator = Handle(CancellableProgress)());
+
+/**
+ * @brief Resizes the OCCT default thread pool used by the mesher and the extraction stages
+ *
+ * Makes OSD_Parallel use the OCCT pool instead of TBB, so that the size is honored (the
+ * tessellator module already does so at import).
+ *
+ * @param num_threads Number of threads, -1 for the number of logical processors
+ * @return Number of threads of the pool
+ * @throws std::runtime_error if the pool is in use by a running tessellation
+ */
+int configure_threads(int num_threads);
@@ -0,0 +1,289 @@
+#include "mesh_delta.h"
+#include "hash.h"
+#include "mesh_view.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include <OSD_Parallel.hxx>
+#include <TopExp.hxx>
+#include <TopTools_DataMapOfShapeInteger.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+
+namespace
+{
+    uint64_t hash_face(const MeshView &view, int i)
+    {
+        const int v0 = view.vertex_offsets[i];
+        const int v1 = view.vertex_offsets[i + 1];
+        const int i0 = view.index_offsets[i];
+        const int i1 = view.index_offsets[i + 1];
+
+        Hasher hasher;
+        hasher.update(view.face_types[i]);
+        hasher.update(view.vertices + 3 * size_t(v0), 3 * size_t(v1 - v0) * sizeof(float));
+        hasher.update(view.normals + 3 * size_t(v0), 3 * size_t(v1 - v0) * sizeof(float));
+
+        // hash local indices, the global ones change when an earlier face changes
+        int chunk[256];
+        for (int k = i0; k < i1;)
+        {
+            int n = std::min(i1 - k, 256);
+            for (int j = 0; j < n; j++)
+                chunk[j] = view.triangles.local(k + j, v0);
+            hasher.update(chunk, n * sizeof(int));
+            k += n;
+        }
+        return hasher.digest();
+    }
+
+    uint64_t hash_edge(const MeshView &view, int i)
+    {
+        Hasher hasher;
+        hasher.update(view.edge_types[i]);
+        hasher.update(view.segments + view.segment_offsets[i],
+                      (view.segment_offsets[i + 1] - view.segment_offsets[i]) * sizeof(float));
+        return hasher.digest();
+    }
+
+    /*
+     * Topological keys in the order used by tessellate(), null shapes if the counts do not
+     * match (edges computed from triangles), which makes match() fall back to indices
+     */
+    std::vector<TopoDS_Shape> shape_keys(const TopoDS_Shape &shape, TopAbs_ShapeEnum type, int count)
+    {
+        TopTools_IndexedMapOfShape map;
+        TopExp::MapShapes(shape, type, map);
+
+        std::vector<TopoDS_Shape> keys(count);
+        if (map.Extent() == count)
+        {
+            for (int i = 0; i < count; i++)
+                keys[i] = map(i + 1);
+        }
+        return keys;
+    }
+
+    std::vector<int> match(const std::vector<TopoDS_Shape> &old_keys, const std::vector<TopoDS_Shape> &new_keys)
+    {
+        TopTools_DataMapOfShapeInteger old_index;
+        for (size_t i = 0; i < old_keys.size(); i++)
+        {
+            if (!old_keys[i].IsNull())
+                old_index.Bind(old_keys[i], static_cast<int>(i));
+        }
+
+        std::vector<int> remap(new_keys.size(), -1);
+        for (size_t j = 0; j < new_keys.size(); j++)
+        {
+            if (!new_keys[j].IsNull())
+            {
+                const Standard_Integer *found = old_index.Seek(new_keys[j]);
+                if (found != nullptr)
+                    remap[j] = *found;
+            }
+            else if (j < old_keys.size() && old_keys[j].IsNull())
+            {
+                remap[j] = static_cast<int>(j);
+            }
+        }
+        return remap;
+    }
+
+    struct Classification
+    {
+        std::vector<int> added;
+        std::vector<int> changed;
+        std::vector<int> removed;
+        std::vector<int> updated; // added and changed, ascending
+    };
+
+    Classification classify(const std::vector<int> &remap,
+                            const std::vector<uint64_t> &old_hashes,
+                            const std::vector<uint64_t> &new_hashes)
+    {
+        Classification result;
+        std::vector<char> matched(old_hashes.size(), 0);
+
+        for (size_t j = 0; j < remap.size(); j++)
+        {
+            if (remap[j] < 0)
+            {
+                result.added.push_back(static_cast<int>(j));
+                result.updated.push_back(static_cast<int>(j));
+            }
+            else
+            {
+                matched[remap[j]] = 1;
+                if (old_hashes[remap[j]] != new_hashes[j])
+                {
+                    result.changed.push_back(static_cast<int>(j));
+                    result.updated.push_back(static_cast<int>(j));
+                }
+            }
+        }
+        for (size_t i = 0; i < old_hashes.size(); i++)
+        {
+            if (!matched[i])
+                result.removed.push_back(static_cast<int>(i));
+        }
+        return result;
+    }
+
+    template <typename T>
+    std::unique_ptr<T[]> copy_vector(const std::vector<T> &values)
+    {
+        std::unique_ptr<T[]> result(new T[values.size()]);
+        std::copy(values.begin(), values.end(), result.get());
+        return result;
+    }
+
+    template <typename T>
+    py::array_t<T> to_numpy(std::unique_ptr<T[]> &values, size_t n)
+    {
+        return wrap_numpy(values.release(), static_cast<int>(n));
+    }
+}
+
+MeshDelta MeshState::update(py::object shape_obj, const MeshData &mesh_data)
+{
+    const TopoDS_Shape &shape = *shape_obj.cast<TopoDS_Shape *>();
+    MeshView view = view_mesh_data(mesh_data);
+    if (view.normals == nullptr)
+        throw std::invalid_argument("MeshState needs per vertex normals, tessellate without flat_normals");
+
+    std::optional<py::gil_scoped_release> release;
+    release.emplace();
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    std::vector<TopoDS_Shape> face_keys = shape_keys(shape, TopAbs_FACE, view.num_faces);
+    std::vector<TopoDS_Shape> edge_keys = shape_keys(shape, TopAbs_EDGE, view.num_edges);
+
+    std::vector<uint64_t> face_hashes(view.num_faces);
+    std::vector<uint64_t> edge_hashes(view.num_edges);
+    OSD_Parallel::For(0, view.num_faces, [&](int i)
+                      { face_hashes[i] = hash_face(view, i); }, view.num_faces < 64);
+    OSD_Parallel::For(0, view.num_edges, [&](int i)
+                      { edge_hashes[i] = hash_edge(view, i); }, view.num_edges < 64);
+
+    std::vector<int> face_remap = match(faces_, face_keys);
+    std::vector<int> edge_remap = match(edges_, edge_keys);
+    Classification faces = classify(face_remap, face_hashes_, face_hashes);
+    Classification edges = classify(edge_remap, edge_hashes_, edge_hashes);
+
+    /*
+     * Arrays of added and changed faces
+     */
+
+    const int num_updated_faces = static_cast<int>(faces.updated.size());
+    std::unique_ptr<int[]> vertex_offsets(new int[num_updated_faces + 1]);
+    std::unique_ptr<int[]> index_offsets(new int[num_updated_faces + 1]);
+    std::unique_ptr<int[]> face_types(new int[num_updated_faces]);
+
+    vertex_offsets[0] = 0;
+    index_offsets[0] = 0;
+    for (int u = 0; u < num_updated_faces; u++)
+    {
+        int i = faces.updated[u];
+        vertex_offsets[u + 1] = vertex_offsets[u] + (view.vertex_offsets[i + 1] - view.vertex_offsets[i]);
+        index_offsets[u + 1] = index_offsets[u] + (view.index_offsets[i + 1] - view.index_offsets[i]);
+        face_types[u] = view.face_types[i];
+    }
+
+    const size_t num_vertices = vertex_offsets[num_updated_faces];
+    const size_t num_indices = index_offsets[num_updated_faces];
+    std::unique_ptr<float[]> vertices(new float[3 * num_vertices]);
+    std::unique_ptr<float[]> normals(new float[3 * num_vertices]);
+    std::unique_ptr<int[]> triangles(new int[num_indices]);
+
+    OSD_Parallel::For(0, num_updated_faces, [&](int u)
+                      {
+        int i = faces.updated[u];
+        int v0 = view.vertex_offsets[i];
+        size_t n = 3 * size_t(view.vertex_offsets[i + 1] - v0);
+        std::copy(view.vertices + 3 * size_t(v0), view.vertices + 3 * size_t(v0) + n, vertices.get() + 3 * size_t(vertex_offsets[u]));
+        std::copy(view.normals + 3 * size_t(v0), view.normals + 3 * size_t(v0) + n, normals.get() + 3 * size_t(vertex_offsets[u]));
+
+        int *target = triangles.get() + index_offsets[u];
+        for (int k = view.index_offsets[i]; k < view.index_offsets[i + 1]; k++)
+            *target++ = view.triangles.local(k, v0); }, num_updated_faces < 64);
+
+    /*
+     * Arrays of added and changed edges
+     */
+
+    const int num_updated_edges = static_cast<int>(edges.updated.size());
+    std::unique_ptr<int[]> segments_per_edge(new int[num_updated_edges]);
+    std::unique_ptr<int[]> edge_types(new int[num_updated_edges]);
+    std::vector<size_t> segment_offsets(num_updated_edges + 1, 0);
+
+    for (int u = 0; u < num_updated_edges; u++)
+    {
+        int i = edges.updated[u];
+        segments_per_edge[u] = view.segments_per_edge[i];
+        edge_types[u] = view.edge_types[i];
+        segment_offsets[u + 1] = segment_offsets[u] + (view.segment_offsets[i + 1] - view.segment_offsets[i]);
+    }
+
+    const size_t num_segment_values = segment_offsets[num_updated_edges];
+    std::unique_ptr<float[]> segments(new float[num_segment_values]);
+
+    OSD_Parallel::For(0, num_updated_edges, [&](int u)
+                      {
+        int i = edges.updated[u];
+        std::copy(view.segments + view.segment_offsets[i], view.segments + view.segment_offsets[i + 1],
+                  segments.get() + segment_offsets[u]); }, num_updated_edges < 64);
+
+    // the delta is complete, hold the new tessellation
+    faces_ = std::move(face_keys);
+    edges_ = std::move(edge_keys);
+    face_hashes_ = std::move(face_hashes);
+    edge_hashes_ = std::move(edge_hashes);
+
+    lock.unlock();
+    release.reset();
+
+    MeshDelta delta;
+    auto to_array = [](const std::vector<int> &values)
+    {
+        std::unique_ptr<int[]> copy = copy_vector(values);
+        return to_numpy(copy, values.size());
+    };
+
+    delta.face_remap = to_array(face_remap);
+    delta.added_faces = to_array(faces.added);
+    delta.changed_faces = to_array(faces.changed);
+    delta.removed_faces = to_array(faces.removed);
+    delta.faces = to_array(faces.updated);
+    delta.vertices = to_numpy(vertices, 3 * num_vertices);
+    delta.normals = to_numpy(normals, 3 * num_vertices);
+    delta.triangles = to_numpy(triangles, num_indices);
+    delta.vertex_offsets = to_numpy(vertex_offsets, num_updated_faces + 1);
+    delta.index_offsets = to_numpy(index_offsets, num_updated_faces + 1);
+    delta.face_types = to_numpy(face_types, num_updated_faces);
+
+    delta.edge_remap = to_array(edge_remap);
+    delta.added_edges = to_array(edges.added);
+    delta.changed_edges = to_array(edges.changed);
+    delta.removed_edges = to_array(edges.removed);
+    delta.edges = to_array(edges.updated);
+    delta.segments = to_numpy(segments, num_segment_values);
+    delta.segments_per_edge = to_numpy(segments_per_edge, num_updated_edges);
+    delta.edge_types = to_numpy(edge_types, num_updated_edges);
+
+    return delta;
+}
+
+void MeshState::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    faces_.clear();
+    edges_.clear();
+    face_hashes_.clear();
+    edge_hashes_.clear();
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+/**
+ * @file mesh_delta.h
+ * @brief Incremental updates between successive tessellations of an edited shape
+ *
+ * MeshState keeps, per face and edge of the last tessellation, the topological identity
+ * (TShape and location) and a content hash of its arrays. Updating it with a new tessellation
+ * returns a MeshDelta with only the added, changed and removed faces and edges plus the
+ * remapping from new to old indices, so a viewer can reuse the arrays it already has.
+ */
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <TopoDS_Shape.hxx>
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include "tessellator.h"
+
+namespace py = pybind11;
+
+/**
+ * @struct MeshDelta
+ * @brief Difference between two tessellations
+ *
+ * New faces (edges) keep their index in the new MeshData. Faces in `faces` (added or changed)
+ * come with their arrays, all other new faces are unchanged copies of face_remap[i] of the
+ * previous tessellation.
+ *
+ * @var face_remap Old index of each new face, -1 for added faces
+ * @var added_faces New indices of faces without previous counterpart
+ * @var changed_faces New indices of faces whose arrays changed
+ * @var removed_faces Old indices of faces that no longer exist
+ * @var faces New indices of added and changed faces (ascending), the faces of the arrays below
+ * @var vertices Vertices of these faces
+ * @var normals Normals of these faces
+ * @var triangles Face local (0 based) int32 triangle indices of these faces
+ * @var vertex_offsets First vertex of each of these faces (plus total)
+ * @var index_offsets First entry in triangles of each of these faces (plus total)
+ * @var face_types Types of these faces
+ * @var edge_remap, added_edges, changed_edges, removed_edges, edges The same for edges
+ * @var segments Segments of the added and changed edges
+ * @var segments_per_edge Number of segments of each of these edges
+ * @var edge_types Types of these edges
+ */
+struct MeshDelta
+{
+    py::array_t<int> face_remap;
+    py::array_t<int> added_faces;
+    py::array_t<int> changed_faces;
+    py::array_t<int> removed_faces;
+    py::array_t<int> faces;
+    py::array_t<float> vertices;
+    py::array_t<float> normals;
+    py::array_t<int> triangles;
+    py::array_t<int> vertex_offsets;
+    py::array_t<int> index_offsets;
+    py::array_t<int> face_types;
+
+    py::array_t<int> edge_remap;
+    py::array_t<int> added_edges;
+    py::array_t<int> changed_edges;
+    py::array_t<int> removed_edges;
+    py::array_t<int> edges;
+    py::array_t<float> segments;
+    py::array_t<int> segments_per_edge;
+    py::array_t<int> edge_types;
+};
+
+/**
+ * @class MeshState
+ * @brief Natively held summary of the last tessellation sent to a viewer
+ */
+class MeshState
+{
+public:
+    /**
+     * @brief Compares a new tessellation with the held one and replaces the held one
+     *
+     * Faces and edges are matched by TShape identity and location (TopoDS_Shape::IsSame),
+     * in the order of TopExp::MapShapes as used by tessellate(). Edges computed from triangles
+     * (shapes without edges) are matched by index. A matched element counts as changed if the
+     * content hash of its arrays differs. Hashing and copying run in parallel without the GIL.
+     *
+     * @param shape The tessellated shape
+     * @param mesh_data Result of tessellate() for shape
+     * @return Delta with respect to the previous update (everything is added on the first call)
+     * @throws std::invalid_argument if mesh_data has inconsistent offsets
+     */
+    MeshDelta update(py::object shape, const MeshData &mesh_data);
+
+    /// Forgets the held tessellation
+    void reset();
+
+    int num_faces() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return static_cast<int>(face_hashes_.size());
+    }
+    int num_edges() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return static_cast<int>(edge_hashes_.size());
+    }
+
+private:
+    // update() holds it without the GIL, so callers must not hold the GIL while waiting
+    mutable std::mutex mutex_;
+
+    // null shapes for elements matched by index
+    std::vector<TopoDS_Shape> faces_;
+    std::vector<TopoDS_Shape> edges_;
+    std::vector<uint64_t> face_hashes_;
+    std::vector<uint64_t> edge_hashes_;
+};
@@ -0,0 +1,335 @@
+#include "mesh_export.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include <OSD_Parallel.hxx>
+#include <TopLoc_Location.hxx>
+
+namespace
+{
+
+constexpr size_t WRITE_BUFFER_BYTES = 1 << 20;
+constexpr int FACES_PER_BATCH = 256;
+
+using FilePtr = std::unique_ptr<FILE, int (*)(FILE *)>;
+
+std::runtime_error file_error(const std::string &what, const std::string &path)
+{
+    return std::runtime_error(what + " '" + path + "': " + std::strerror(errno));
+}
+
+/*
+ * Appends to a memory buffer and writes it to the file whenever it is full
+ */
+class BufferedWriter
+{
+public:
+    BufferedWriter(FILE *file, const std::string &path) : file_(file), path_(path)
+    {
+        buffer_.reserve(WRITE_BUFFER_BYTES);
+    }
+
+    void write(const void *data, size_t size)
+    {
+        if (buffer_.size() + size > WRITE_BUFFER_BYTES)
+            flush();
+        const char *bytes = static_cast<const char *>(data);
+        buffer_.insert(buffer_.end(), bytes, bytes + size);
+    }
+
+    template <typename T>
+    void put(T value)
+    {
+        write(&value, sizeof(T));
+    }
+
+    template <typename... Args>
+    void print(const char *format, Args... args)
+    {
+        char line[256];
+        int n = std::snprintf(line, sizeof(line), format, args...);
+        write(line, static_cast<size_t>(std::min(n, int(sizeof(line)) - 1)));
+    }
+
+    void flush()
+    {
+        if (!buffer_.empty() && std::fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size())
+            throw file_error("cannot write", path_);
+        buffer_.clear();
+    }
+
+private:
+    FILE *file_;
+    const std::string &path_;
+    std::vector<char> buffer_;
+};
+
+/*
+ * Extraction buffers of one face, reused across batches
+ */
+struct FaceMesh
+{
+    std::vector<double> vertices;
+    std::vector<double> normals;
+    std::vector<int> triangles;
+    int num_vertices = 0;
+    int num_triangles = 0;
+};
+
+/*
+ * Area weighted vertex normals for triangulations without UV nodes
+ */
+void average_normals(FaceMesh &mesh)
+{
+    std::fill(mesh.normals.begin(), mesh.normals.end(), 0.0);
+    for (int t = 0; t < mesh.num_triangles; t++)
+    {
+        const int *tri = mesh.triangles.data() + 3 * t;
+        const double *a = mesh.vertices.data() + 3 * tri[0];
+        const double *b = mesh.vertices.data() + 3 * tri[1];
+        const double *c = mesh.vertices.data() + 3 * tri[2];
+        gp_Vec n = gp_Vec(a[0], a[1], a[2]).Crossed(gp_Vec(b[0], b[1], b[2])) +
+                   gp_Vec(b[0], b[1], b[2]).Crossed(gp_Vec(c[0], c[1], c[2])) +
+                   gp_Vec(c[0], c[1], c[2]).Crossed(gp_Vec(a[0], a[1], a[2]));
+        for (int k = 0; k < 3; k++)
+        {
+            mesh.normals[3 * tri[k]] += n.X();
+            mesh.normals[3 * tri[k] + 1] += n.Y();
+            mesh.normals[3 * tri[k] + 2] += n.Z();
+        }
+    }
+    for (int v = 0; v < mesh.num_vertices; v++)
+    {
+        double *n = mesh.normals.data() + 3 * v;
+        double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0.0)
+        {
+            n[0] /= length;
+            n[1] /= length;
+            n[2] /= length;
+        }
+    }
+}
+
+void write_stl_face(BufferedWriter &out, const FaceMesh &mesh, bool binary)
+{
+    for (int t = 0; t < mesh.num_triangles; t++)
+    {
+        const int *tri = mesh.triangles.data() + 3 * t;
+        float p[3][3];
+        for (int k = 0; k < 3; k++)
+            for (int c = 0; c < 3; c++)
+                p[k][c] = static_cast<float>(mesh.vertices[3 * tri[k] + c]);
+
+        float e1[3] = {p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2]};
+        float e2[3] = {p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2]};
+        float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0.0f)
+        {
+            n[0] /= length;
+            n[1] /= length;
+            n[2] /= length;
+        }
+
+        if (binary)
+        {
+            out.write(n, sizeof(n));
+            out.write(p, sizeof(p));
+            out.put<uint16_t>(0);
+        }
+        else
+        {
+            out.print("facet normal %.9g %.9g %.9g\n  outer loop\n", n[0], n[1], n[2]);
+            for (int k = 0; k < 3; k++)
+                out.print("    vertex %.9g %.9g %.9g\n", p[k][0], p[k][1], p[k][2]);
+            out.print("  endloop\nendfacet\n");
+        }
+    }
+}
+
+void write_ply_face(BufferedWriter &vertex_out, BufferedWriter &face_out, const FaceMesh &mesh,
+                    int vertex_offset, bool binary)
+{
+    for (int v = 0; v < mesh.num_vertices; v++)
+    {
+        float values[6];
+        for (int c = 0; c < 3; c++)
+        {
+            values[c] = static_cast<float>(mesh.vertices[3 * v + c]);
+            values[3 + c] = static_cast<float>(mesh.normals[3 * v + c]);
+        }
+        if (binary)
+            vertex_out.write(values, sizeof(values));
+        else
+            vertex_out.print("%.9g %.9g %.9g %.9g %.9g %.9g\n",
+                             values[0], values[1], values[2], values[3], values[4], values[5]);
+    }
+    for (int t = 0; t < mesh.num_triangles; t++)
+    {
+        const int32_t tri[3] = {vertex_offset + mesh.triangles[3 * t], vertex_offset + mesh.triangles[3 * t + 1],
+                                vertex_offset + mesh.triangles[3 * t + 2]};
+        if (binary)
+        {
+            face_out.put<uint8_t>(3);
+            face_out.write(tri, sizeof(tri));
+        }
+        else
+        {
+            face_out.print("3 %d %d %d\n", tri[0], tri[1], tri[2]);
+        }
+    }
+}
+
+} // namespace
+
+size_t tessellate_to_file(const TopoDS_Shape &shape, const std::string &path, MeshFileFormat format, bool binary,
+                          double deflection, double angular_tolerance, bool parallel)
+{
+    BRepMesh_IncrementalMesh mesher(shape, deflection, Standard_False, angular_tolerance, parallel);
+
+    TopTools_IndexedMapOfShape face_map;
+    TopExp::MapShapes(shape, TopAbs_FACE, face_map);
+    const int num_faces = face_map.Extent();
+
+    // the headers need the totals, fetching the triangulations is cheap
+    std::vector<Handle(Poly_Triangulation)> triangulations(num_faces);
+    std::vector<TopLoc_Location> locations(num_faces);
+    size_t num_vertices = 0;
+    size_t num_triangles = 0;
+    for (int i = 0; i < num_faces; i++)
+    {
+        triangulations[i] = BRep_Tool::Triangulation(TopoDS::Face(face_map.FindKey(i + 1)), locations[i]);
+        if (triangulations[i].IsNull())
+            continue;
+        num_vertices += triangulations[i]->NbNodes();
+        num_triangles += triangulations[i]->NbTriangles();
+    }
+
+    if (format == MeshFileFormat::STL && num_triangles > UINT32_MAX)
+        throw std::length_error("STL files hold at most 2^32 - 1 triangles");
+    if (format == MeshFileFormat::PLY && num_vertices > INT32_MAX)
+        throw std::length_error("PLY files with int indices hold at most 2^31 - 1 vertices");
+
+    FilePtr file(std::fopen(path.c_str(), "wb"), &std::fclose);
+    if (!file)
+        throw file_error("cannot open", path);
+    BufferedWriter out(file.get(), path);
+
+    // PLY lists all vertices before the faces, the faces are spooled to a temporary file
+    FilePtr spool(nullptr, &std::fclose);
+    std::optional<BufferedWriter> face_out;
+    if (format == MeshFileFormat::STL)
+    {
+        if (binary)
+        {
+            char header[80] = {};
+            std::strncpy(header, "binary STL written by ocp_addons.tessellator", sizeof(header) - 1);
+            out.write(header, sizeof(header));
+            out.put<uint32_t>(static_cast<uint32_t>(num_triangles));
+        }
+        else
+        {
+            out.print("solid shape\n");
+        }
+    }
+    else
+    {
+        spool.reset(std::tmpfile());
+        if (!spool)
+            throw file_error("cannot create a temporary file for", path);
+        face_out.emplace(spool.get(), path);
+
+        out.print("ply\nformat %s 1.0\ncomment written by ocp_addons.tessellator\n",
+                  binary ? "binary_little_endian" : "ascii");
+        out.print("element vertex %zu\n", num_vertices);
+        out.print("property float x\nproperty float y\nproperty float z\n");
+        out.print("property float nx\nproperty float ny\nproperty float nz\n");
+        out.print("element face %zu\nproperty list uchar int vertex_indices\nend_header\n", num_triangles);
+    }
+
+    Logger logger(0);
+    std::vector<FaceMesh> batch(std::min(num_faces, FACES_PER_BATCH));
+    int vertex_offset = 0;
+
+    for (int first = 0; first < num_faces; first += FACES_PER_BATCH)
+    {
+        const int count = std::min(FACES_PER_BATCH, num_faces - first);
+
+        // Parallel pass: every face of the batch fills its own (reused) buffers
+        OSD_Parallel::For(0, count, [&](int k)
+                          {
+            const int i = first + k;
+            FaceMesh &mesh = batch[k];
+            mesh.num_vertices = 0;
+            mesh.num_triangles = 0;
+            const Handle(Poly_Triangulation) &triangulation = triangulations[i];
+            if (triangulation.IsNull())
+                return;
+
+            mesh.vertices.resize(3 * size_t(triangulation->NbNodes()));
+            mesh.normals.resize(3 * size_t(triangulation->NbNodes()));
+            mesh.triangles.resize(3 * size_t(triangulation->NbTriangles()));
+
+            FaceData face = FaceData();
+            face.vertices = mesh.vertices.data();
+            face.normals = mesh.normals.data();
+            face.triangles = mesh.triangles.data();
+            extract_face_data(face, TopoDS::Face(face_map.FindKey(i + 1)), *triangulation, locations[i], logger);
+            mesh.num_vertices = face.num_vertices;
+            mesh.num_triangles = face.num_triangles;
+
+            if (format == MeshFileFormat::PLY && !triangulation->HasUVNodes())
+                average_normals(mesh); }, !parallel || count < 2);
+
+        // Serial pass: faces are written in face map order
+        for (int k = 0; k < count; k++)
+        {
+            if (format == MeshFileFormat::STL)
+            {
+                write_stl_face(out, batch[k], binary);
+            }
+            else
+            {
+                write_ply_face(out, *face_out, batch[k], vertex_offset, binary);
+                vertex_offset += batch[k].num_vertices;
+            }
+        }
+    }
+
+    if (format == MeshFileFormat::STL)
+    {
+        if (!binary)
+            out.print("endsolid shape\n");
+    }
+    else
+    {
+        face_out->flush();
+        std::rewind(spool.get());
+        char chunk[1 << 16];
+        size_t n;
+        while ((n = std::fread(chunk, 1, sizeof(chunk), spool.get())) > 0)
+            out.write(chunk, n);
+        if (std::ferror(spool.get()))
+            throw file_error("cannot read the temporary file for", path);
+    }
+
+    out.flush();
+    if (std::fflush(file.get()) != 0)
+        throw file_error("cannot write", path);
+    FILE *raw = file.release();
+    if (std::fclose(raw) != 0)
+        throw file_error("cannot close", path);
+
+    return num_triangles;
+}
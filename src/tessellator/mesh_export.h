@@ -0,0 +1,48 @@
+#pragma once
+
+/**
+ * @file mesh_export.h
+ * @brief Streaming export of tessellated shapes to STL and PLY files
+ *
+ * The shape is meshed, then its faces are extracted in small batches (in parallel within a
+ * batch) with the extraction kernels of tessellate() and written through a buffered file
+ * writer right away, so memory stays flat independent of the shape size. No MeshData and no
+ * numpy arrays are created. Binary files use little endian byte order (native on all
+ * supported platforms).
+ */
+
+#include <cstddef>
+#include <string>
+
+#include "mesh_core.h"
+
+/**
+ * @brief Supported mesh file formats
+ */
+enum class MeshFileFormat
+{
+    STL,
+    PLY
+};
+
+/**
+ * @brief Meshes a shape and streams its triangles face by face into a mesh file
+ *
+ * STL gets one facet per triangle with the facet normal; PLY gets shared vertices with vertex
+ * normals (surface normals, or averaged triangle normals for triangulations without UV nodes)
+ * and triangles with global vertex indices. Faces without triangulation are skipped. Must be
+ * called without holding the GIL.
+ *
+ * @param shape Shape to tessellate
+ * @param path File to create (overwritten if it exists)
+ * @param format File format
+ * @param binary Binary (true) or ASCII (false) variant of the format
+ * @param deflection Maximum deviation of the mesh from the surfaces
+ * @param angular_tolerance Angular tolerance of the mesh in radians
+ * @param parallel Mesh and extract faces in parallel
+ * @return Number of triangles written
+ * @throws std::runtime_error if the file cannot be written
+ * @throws std::length_error if the mesh exceeds the index range of the format
+ */
+size_t tessellate_to_file(const TopoDS_Shape &shape, const std::string &path, MeshFileFormat format, bool binary,
+                          double deflection, double angular_tolerance, bool parallel);
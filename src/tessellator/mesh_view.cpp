@@ -0,0 +1,56 @@
+#include "mesh_view.h"
+
+#include <stdexcept>
+#include <string>
+
+MeshView view_mesh_data(const MeshData &mesh_data)
+{
+    MeshView view;
+    view.num_faces = static_cast<int>(mesh_data.face_types.size());
+    view.num_edges = static_cast<int>(mesh_data.edge_types.size());
+
+    if (mesh_data.vertex_offsets.size() != view.num_faces + 1 ||
+        mesh_data.index_offsets.size() != view.num_faces + 1 ||
+        mesh_data.segments_per_edge.size() != view.num_edges)
+        throw std::invalid_argument("MeshData has inconsistent face or edge counts");
+
+    view.vertices = mesh_data.vertices.data();
+    // compact flat normals (tessellate(flat_normals=True)) have no per vertex normals
+    const bool flat_normals = mesh_data.flat_faces.size() > 0;
+    view.normals = flat_normals ? nullptr : mesh_data.normals.data();
+    view.vertex_offsets = mesh_data.vertex_offsets.data();
+    view.index_offsets = mesh_data.index_offsets.data();
+    view.face_types = mesh_data.face_types.data();
+    view.segments = mesh_data.segments.data();
+    view.segments_per_edge = mesh_data.segments_per_edge.data();
+    view.edge_types = mesh_data.edge_types.data();
+
+    view.triangles.data = mesh_data.triangles.data();
+    view.triangles.itemsize = static_cast<int>(mesh_data.triangles.itemsize());
+    view.triangles.global = !mesh_data.local_indices;
+
+    for (int i = 0; i < view.num_faces; i++)
+    {
+        if (view.vertex_offsets[i] > view.vertex_offsets[i + 1] ||
+            view.index_offsets[i] > view.index_offsets[i + 1])
+            throw std::invalid_argument("MeshData has decreasing offsets at face " + std::to_string(i));
+    }
+    if (view.vertex_offsets[0] != 0 || view.index_offsets[0] != 0 ||
+        mesh_data.vertices.size() != 3 * py::ssize_t(view.vertex_offsets[view.num_faces]) ||
+        (!flat_normals && mesh_data.normals.size() != mesh_data.vertices.size()) ||
+        mesh_data.triangles.size() != py::ssize_t(view.index_offsets[view.num_faces]))
+        throw std::invalid_argument("MeshData offsets do not match the array sizes");
+
+    view.segment_offsets.resize(view.num_edges + 1);
+    view.segment_offsets[0] = 0;
+    for (int i = 0; i < view.num_edges; i++)
+    {
+        if (view.segments_per_edge[i] < 0)
+            throw std::invalid_argument("MeshData has a negative segment count at edge " + std::to_string(i));
+        view.segment_offsets[i + 1] = view.segment_offsets[i] + 6 * size_t(view.segments_per_edge[i]);
+    }
+    if (size_t(mesh_data.segments.size()) != view.segment_offsets[view.num_edges])
+        throw std::invalid_argument("MeshData segment counts do not match the segments array");
+
+    return view;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+/**
+ * @file mesh_view.h
+ * @brief Validated raw read access to the arrays of a MeshData
+ *
+ * Native passes over a tessellation result (hashing, meshlets, ...) take a MeshView while
+ * holding the GIL and then work on plain pointers with the GIL released.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tessellator.h"
+
+/*
+ * Read access to the triangles of a MeshData in any of its index dtypes,
+ * returning face local indices
+ */
+struct TriangleIndices
+{
+    const void *data = nullptr;
+    int itemsize = 4;
+    bool global = true;
+
+    int local(size_t k, int vertex_offset) const
+    {
+        if (itemsize == 2)
+            return static_cast<const uint16_t *>(data)[k];
+        int value = static_cast<const int32_t *>(data)[k];
+        return global ? value - vertex_offset : value;
+    }
+};
+
+/*
+ * Raw pointers into the arrays of a MeshData, taken while holding the GIL
+ */
+struct MeshView
+{
+    int num_faces = 0;
+    int num_edges = 0;
+    const float *vertices = nullptr;
+    const float *normals = nullptr; // nullptr for compact flat normals
+    const int *vertex_offsets = nullptr;
+    const int *index_offsets = nullptr;
+    const int *face_types = nullptr;
+    TriangleIndices triangles;
+    const float *segments = nullptr;
+    const int *segments_per_edge = nullptr;
+    const int *edge_types = nullptr;
+    std::vector<size_t> segment_offsets;
+};
+
+/**
+ * @brief Takes the pointers of a MeshData and validates its offsets against the array sizes
+ *
+ * @throws std::invalid_argument if the counts or offsets are inconsistent
+ */
+MeshView view_mesh_data(const MeshData &mesh_data);
@@ -0,0 +1,238 @@
+#include "meshlets.h"
+#include "mesh_view.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include <OSD_Parallel.hxx>
+
+namespace
+{
+
+/*
+ * Meshlets of one face, vertex indices already global
+ */
+struct FaceMeshlets
+{
+    std::vector<int> vertex_indices;
+    std::vector<int> vertex_offsets{0};
+    std::vector<uint16_t> triangles;
+    std::vector<int> index_offsets{0};
+    std::vector<float> spheres;
+    std::vector<float> cones;
+
+    int size() const
+    {
+        return static_cast<int>(vertex_offsets.size()) - 1;
+    }
+};
+
+/*
+ * Bounding sphere (center of the box, radius to the farthest vertex) and normal cone of the
+ * last meshlet of a face
+ */
+void close_meshlet(FaceMeshlets &out, const float *vertices)
+{
+    const int v0 = out.vertex_offsets[out.vertex_offsets.size() - 2];
+    const int v1 = out.vertex_offsets.back();
+    const int t0 = out.index_offsets[out.index_offsets.size() - 2];
+    const int t1 = out.index_offsets.back();
+
+    float lo[3] = {INFINITY, INFINITY, INFINITY};
+    float hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (int k = v0; k < v1; k++)
+    {
+        const float *p = vertices + 3 * size_t(out.vertex_indices[k]);
+        for (int c = 0; c < 3; c++)
+        {
+            lo[c] = std::min(lo[c], p[c]);
+            hi[c] = std::max(hi[c], p[c]);
+        }
+    }
+    float center[3] = {0.5f * (lo[0] + hi[0]), 0.5f * (lo[1] + hi[1]), 0.5f * (lo[2] + hi[2])};
+    float radius2 = 0.0f;
+    for (int k = v0; k < v1; k++)
+    {
+        const float *p = vertices + 3 * size_t(out.vertex_indices[k]);
+        float dx = p[0] - center[0], dy = p[1] - center[1], dz = p[2] - center[2];
+        radius2 = std::max(radius2, dx * dx + dy * dy + dz * dz);
+    }
+    out.spheres.insert(out.spheres.end(), {center[0], center[1], center[2], std::sqrt(radius2)});
+
+    // unit triangle normals, degenerated triangles do not count
+    std::vector<float> normals;
+    normals.reserve(t1 - t0);
+    float axis[3] = {0.0f, 0.0f, 0.0f};
+    for (int k = t0; k < t1; k += 3)
+    {
+        const float *a = vertices + 3 * size_t(out.vertex_indices[v0 + out.triangles[k]]);
+        const float *b = vertices + 3 * size_t(out.vertex_indices[v0 + out.triangles[k + 1]]);
+        const float *c = vertices + 3 * size_t(out.vertex_indices[v0 + out.triangles[k + 2]]);
+        float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0f)
+            continue;
+        for (int j = 0; j < 3; j++)
+        {
+            normals.push_back(n[j] / length);
+            axis[j] += n[j] / length;
+        }
+    }
+
+    float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    float cutoff = 1.0f;
+    if (length > 0.0f)
+    {
+        for (int j = 0; j < 3; j++)
+            axis[j] /= length;
+
+        float min_dot = 1.0f;
+        for (size_t k = 0; k < normals.size(); k += 3)
+            min_dot = std::min(min_dot, normals[k] * axis[0] + normals[k + 1] * axis[1] + normals[k + 2] * axis[2]);
+
+        // spreads beyond ~84 degrees cannot be culled in practice
+        if (min_dot > 0.1f)
+            cutoff = std::sqrt(1.0f - min_dot * min_dot);
+    }
+    out.cones.insert(out.cones.end(), {axis[0], axis[1], axis[2], cutoff});
+}
+
+FaceMeshlets split_face(const MeshView &view, int face, int max_vertices, int max_triangles,
+                        std::vector<int> &local_index)
+{
+    FaceMeshlets out;
+
+    const int v_base = view.vertex_offsets[face];
+    const int i0 = view.index_offsets[face];
+    const int i1 = view.index_offsets[face + 1];
+    if (i0 == i1)
+        return out;
+
+    const int num_vertices = view.vertex_offsets[face + 1] - v_base;
+    local_index.assign(num_vertices, -1);
+
+    int meshlet_vertices = 0;
+    int meshlet_triangles = 0;
+
+    auto close = [&]()
+    {
+        out.vertex_offsets.push_back(static_cast<int>(out.vertex_indices.size()));
+        out.index_offsets.push_back(static_cast<int>(out.triangles.size()));
+        close_meshlet(out, view.vertices);
+        for (int k = out.vertex_offsets[out.vertex_offsets.size() - 2]; k < out.vertex_offsets.back(); k++)
+            local_index[out.vertex_indices[k] - v_base] = -1;
+        meshlet_vertices = 0;
+        meshlet_triangles = 0;
+    };
+
+    for (int k = i0; k < i1; k += 3)
+    {
+        int corners[3];
+        int new_vertices = 0;
+        for (int c = 0; c < 3; c++)
+        {
+            corners[c] = view.triangles.local(k + c, v_base);
+            if (local_index[corners[c]] < 0 && (c == 0 || corners[c] != corners[0]) &&
+                (c < 2 || corners[c] != corners[1]))
+                new_vertices++;
+        }
+
+        if (meshlet_vertices + new_vertices > max_vertices || meshlet_triangles == max_triangles)
+            close();
+
+        for (int c = 0; c < 3; c++)
+        {
+            int &local = local_index[corners[c]];
+            if (local < 0)
+            {
+                local = meshlet_vertices++;
+                out.vertex_indices.push_back(v_base + corners[c]);
+            }
+            out.triangles.push_back(static_cast<uint16_t>(local));
+        }
+        meshlet_triangles++;
+    }
+    close();
+
+    return out;
+}
+
+} // namespace
+
+Meshlets build_meshlets(const MeshData &mesh_data, int max_vertices, int max_triangles)
+{
+    if (max_vertices < 3 || max_vertices > 65536)
+        throw std::invalid_argument("max_vertices must be between 3 and 65536");
+    if (max_triangles < 1)
+        throw std::invalid_argument("max_triangles must be at least 1");
+
+    MeshView view = view_mesh_data(mesh_data);
+
+    std::optional<py::gil_scoped_release> release;
+    release.emplace();
+
+    std::vector<FaceMeshlets> per_face(view.num_faces);
+    OSD_Parallel::For(0, view.num_faces, [&](int i)
+                      {
+        std::vector<int> local_index;
+        per_face[i] = split_face(view, i, max_vertices, max_triangles, local_index); }, view.num_faces < 64);
+
+    int num_meshlets = 0;
+    size_t num_vertex_indices = 0;
+    size_t num_indices = 0;
+    for (const FaceMeshlets &f : per_face)
+    {
+        num_meshlets += f.size();
+        num_vertex_indices += f.vertex_indices.size();
+        num_indices += f.triangles.size();
+    }
+
+    auto vertex_indices = new int[num_vertex_indices];
+    auto vertex_offsets = new int[num_meshlets + 1];
+    auto triangles = new uint16_t[num_indices];
+    auto index_offsets = new int[num_meshlets + 1];
+    auto faces = new int[num_meshlets];
+    auto spheres = new float[4 * num_meshlets];
+    auto cones = new float[4 * num_meshlets];
+
+    int m = 0;
+    size_t v_total = 0;
+    size_t t_total = 0;
+    for (int i = 0; i < view.num_faces; i++)
+    {
+        const FaceMeshlets &f = per_face[i];
+        for (int j = 0; j < f.size(); j++)
+        {
+            vertex_offsets[m + j] = static_cast<int>(v_total) + f.vertex_offsets[j];
+            index_offsets[m + j] = static_cast<int>(t_total) + f.index_offsets[j];
+            faces[m + j] = i;
+        }
+        std::copy(f.vertex_indices.begin(), f.vertex_indices.end(), vertex_indices + v_total);
+        std::copy(f.triangles.begin(), f.triangles.end(), triangles + t_total);
+        std::copy(f.spheres.begin(), f.spheres.end(), spheres + 4 * m);
+        std::copy(f.cones.begin(), f.cones.end(), cones + 4 * m);
+        m += f.size();
+        v_total += f.vertex_indices.size();
+        t_total += f.triangles.size();
+    }
+    vertex_offsets[num_meshlets] = static_cast<int>(v_total);
+    index_offsets[num_meshlets] = static_cast<int>(t_total);
+
+    release.reset();
+
+    Meshlets meshlets;
+    meshlets.vertex_indices = wrap_numpy(vertex_indices, static_cast<int>(num_vertex_indices));
+    meshlets.vertex_offsets = wrap_numpy(vertex_offsets, num_meshlets + 1);
+    meshlets.triangles = wrap_numpy(triangles, static_cast<int>(num_indices));
+    meshlets.index_offsets = wrap_numpy(index_offsets, num_meshlets + 1);
+    meshlets.faces = wrap_numpy(faces, num_meshlets);
+    meshlets.spheres = wrap_numpy(spheres, 4 * num_meshlets);
+    meshlets.cones = wrap_numpy(cones, 4 * num_meshlets);
+    return meshlets;
+}
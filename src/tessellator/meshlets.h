@@ -0,0 +1,57 @@
+#pragma once
+
+/**
+ * @file meshlets.h
+ * @brief Partitioning of tessellated faces into meshlets of bounded size
+ *
+ * Large faces (e.g. imported STL shells) give one huge draw range. Meshlets split every face
+ * into chunks of at most max_vertices vertices and max_triangles triangles with 16 bit local
+ * indices, a bounding sphere and a normal cone, so that chunks can be culled and drawn
+ * individually. Meshlets never span faces.
+ */
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include "tessellator.h"
+
+namespace py = pybind11;
+
+/**
+ * @struct Meshlets
+ * @brief Meshlets of a MeshData, concatenated in face order
+ *
+ * @var vertex_indices Index into MeshData.vertices (and normals) of each meshlet vertex
+ * @var vertex_offsets First entry in vertex_indices of each meshlet, num_meshlets + 1 entries
+ * @var triangles Triangle indices local to the meshlet vertices (uint16)
+ * @var index_offsets First entry in triangles of each meshlet, num_meshlets + 1 entries
+ * @var faces Source face index of each meshlet
+ * @var spheres Bounding sphere of each meshlet (center xyz, radius)
+ * @var cones Normal cone of each meshlet (axis xyz, cutoff); the meshlet faces away from a
+ *      camera at position c if dot(center - c, axis) >= cutoff * |center - c| + radius.
+ *      cutoff is 1 when the normals are too spread out to ever cull.
+ */
+struct Meshlets
+{
+    py::array_t<int> vertex_indices;
+    py::array_t<int> vertex_offsets;
+    py::array_t<uint16_t> triangles;
+    py::array_t<int> index_offsets;
+    py::array_t<int> faces;
+    py::array_t<float> spheres;
+    py::array_t<float> cones;
+};
+
+/**
+ * @brief Splits every face of a tessellation into meshlets
+ *
+ * Triangles are taken greedily in face order, so meshlets are most compact for triangles in
+ * vertex cache order (tessellate(optimize_order=True)). Faces are processed in parallel
+ * without the GIL.
+ *
+ * @param mesh_data Result of tessellate() (global or local indices)
+ * @param max_vertices Maximum number of vertices per meshlet (3 to 65536)
+ * @param max_triangles Maximum number of triangles per meshlet (at least 1)
+ * @throws std::invalid_argument for invalid limits or an inconsistent MeshData
+ */
+Meshlets build_meshlets(const MeshData &mesh_data, int max_vertices, int max_triangles);
@@ -0,0 +1,47 @@
+#include "progress.h"
+
+TessellationProgress::TessellationProgress(py::handle callback, const CancelToken *token, double interval)
+    : CancellableProgress(token),
+      callback_(callback),
+      interval_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(interval))),
+      last_(std::chrono::steady_clock::now())
+{
+}
+
+void TessellationProgress::Show(const Message_ProgressScope &, const Standard_Boolean isForce)
+{
+    // called with the indicator mutex locked, so last_ and error_ are not shared concurrently
+    if (callback_.is_none() || failed_)
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+    if (!isForce && now - last_ < interval_)
+        return;
+    last_ = now;
+
+    double position = GetPosition();
+
+    py::gil_scoped_acquire acquire;
+    try
+    {
+        callback_(position);
+    }
+    catch (py::error_already_set &e)
+    {
+        // must not propagate through OCCT, treat it as a cancel request
+        error_ = e.what();
+        failed_ = true;
+    }
+}
+
+Standard_Boolean TessellationProgress::UserBreak()
+{
+    return failed_ || CancellableProgress::UserBreak();
+}
+
+void TessellationProgress::check_cancelled()
+{
+    if (failed_)
+        throw TessellationCancelled("Tessellation cancelled, progress callback raised: " + error_);
+    CancellableProgress::check_cancelled();
+}
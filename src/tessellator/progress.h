@@ -0,0 +1,56 @@
+#pragma once
+
+/**
+ * @file progress.h
+ * @brief Progress reporting and cancellation for long running tessellations
+ *
+ * TessellationProgress is an OCCT progress indicator: its range is passed into
+ * BRepMesh_IncrementalMesh and the face/edge extraction loops. It forwards the position to
+ * a Python callback at a throttled rate and reports a user break when a CancelToken has been
+ * cancelled (or the callback raised), which makes tessellate() stop and throw
+ * TessellationCancelled.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include <pybind11/pybind11.h>
+
+#include "cancel.h"
+
+namespace py = pybind11;
+
+/**
+ * @class TessellationProgress
+ * @brief Cancellable progress indicator that also calls a Python function
+ *
+ * Show() may be called from OCCT worker threads while the GIL is released; the GIL is only
+ * acquired when the callback is due.
+ */
+class TessellationProgress : public CancellableProgress
+{
+public:
+    /**
+     * @param callback Python callable taking the progress as float in [0, 1] (may be None)
+     * @param token Cancel token (may be nullptr)
+     * @param interval Minimum time in seconds between two callback invocations
+     */
+    TessellationProgress(py::handle callback, const CancelToken *token, double interval);
+
+    void Show(const Message_ProgressScope &theScope, const Standard_Boolean isForce) override;
+
+    Standard_Boolean UserBreak() override;
+
+    /**
+     * @brief Throws TessellationCancelled if a user break has been requested or the callback raised
+     */
+    void check_cancelled() override;
+
+private:
+    py::handle callback_;
+    std::chrono::steady_clock::duration interval_;
+    std::chrono::steady_clock::time_point last_;
+    std::atomic<bool> failed_{false};
+    std::string error_;
+};
@@ -0,0 +1,628 @@
+#include "sharding.h"
+#include "arena.h"
+#include "mesh_buffer.h"
+#include "../serializer/serializer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <BRep_Builder.hxx>
+#include <BRep_Tool.hxx>
+#include <OSD_Parallel.hxx>
+#include <TopExp.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Compound.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+
+namespace
+{
+
+/*
+ * A compound of faces of the shape. faces and edges map the faces and edges of the shard (in
+ * the order of tessellate(compound)) to their index in the shape; edges that are owned by an
+ * earlier shard or do not belong to the shape map to -1.
+ */
+struct Shard
+{
+    TopoDS_Compound compound;
+    std::vector<int> faces;
+    std::vector<int> edges;
+};
+
+/*
+ * Raw pointers into the packed result of a worker, valid as long as mesh_data is alive
+ */
+struct ShardArrays
+{
+    bool valid = false;
+    MeshData mesh_data;
+    const float *vertices = nullptr;
+    const float *normals = nullptr;
+    const void *triangles = nullptr;
+    size_t index_size = 0;
+    const int *vertex_offsets = nullptr;
+    const int *index_offsets = nullptr;
+    const int *triangles_per_face = nullptr;
+    const int *face_types = nullptr;
+    const float *face_bounds = nullptr;
+    const float *segments = nullptr;
+    const int *segments_per_edge = nullptr;
+    const int *edge_types = nullptr;
+    const float *edge_bounds = nullptr;
+    std::vector<int> segment_offsets;
+    int num_faces = 0;
+    int num_edges = 0;
+};
+
+struct Source
+{
+    int shard = -1;
+    int index = -1;
+};
+
+std::vector<Shard> make_shards(const TopoDS_Shape &shape, const TopTools_IndexedMapOfShape &face_map,
+                               const TopTools_IndexedMapOfShape &edge_map, bool by_solid, int faces_per_shard)
+{
+    const int num_faces = face_map.Extent();
+    std::vector<std::vector<int>> groups;
+    std::vector<int> group;
+    std::vector<char> assigned(num_faces, 0);
+
+    auto add_face = [&](int index)
+    {
+        if (index > 0 && !assigned[index - 1])
+        {
+            assigned[index - 1] = 1;
+            group.push_back(index - 1);
+        }
+    };
+    auto close_group = [&](bool force)
+    {
+        if (!group.empty() && (force || static_cast<int>(group.size()) >= faces_per_shard))
+        {
+            groups.push_back(std::move(group));
+            group.clear();
+        }
+    };
+
+    if (by_solid)
+    {
+        // solids are never split, small ones are packed together
+        for (TopExp_Explorer solids(shape, TopAbs_SOLID); solids.More(); solids.Next())
+        {
+            for (TopExp_Explorer faces(solids.Current(), TopAbs_FACE); faces.More(); faces.Next())
+                add_face(face_map.FindIndex(faces.Current()));
+            close_group(false);
+        }
+        close_group(true);
+    }
+
+    // all faces, or the faces outside of solids
+    for (int i = 1; i <= num_faces; i++)
+    {
+        add_face(i);
+        close_group(false);
+    }
+    close_group(true);
+
+    std::vector<Shard> shards(groups.size());
+    std::vector<char> edge_owned(edge_map.Extent(), 0);
+    BRep_Builder builder;
+
+    for (size_t s = 0; s < groups.size(); s++)
+    {
+        Shard &shard = shards[s];
+        shard.faces = std::move(groups[s]);
+
+        // the faces keep their location, so the workers return world coordinates
+        builder.MakeCompound(shard.compound);
+        for (int i : shard.faces)
+            builder.Add(shard.compound, face_map(i + 1));
+
+        // serialization keeps the structure, so the workers see the edges in this order
+        TopTools_IndexedMapOfShape shard_edges;
+        TopExp::MapShapes(shard.compound, TopAbs_EDGE, shard_edges);
+        shard.edges.assign(shard_edges.Extent(), -1);
+        for (int k = 0; k < shard_edges.Extent(); k++)
+        {
+            int index = edge_map.FindIndex(shard_edges(k + 1)) - 1;
+            if (index >= 0 && !edge_owned[index])
+            {
+                edge_owned[index] = 1;
+                shard.edges[k] = index;
+            }
+        }
+    }
+
+    return shards;
+}
+
+/*
+ * Runs the shards of group on pool and returns the shards lost to a broken pool. results[s]
+ * receives the packed MeshData of shard s, or errors[s] the reason why it failed.
+ */
+std::vector<int> run_group(py::object pool, const std::vector<int> &group, const std::vector<py::object> &payloads,
+                           const py::dict &options, std::vector<py::object> &results, std::vector<std::string> &errors)
+{
+    py::object broken_pool = py::module_::import("concurrent.futures.process").attr("BrokenProcessPool");
+    py::object run = py::type::of<ShardWorker>().attr("run");
+
+    std::vector<py::object> futures;
+    for (int s : group)
+    {
+        try
+        {
+            futures.push_back(pool.attr("submit")(run, payloads[s], options, s));
+        }
+        catch (py::error_already_set &e)
+        {
+            if (!e.matches(broken_pool))
+                throw;
+            break;
+        }
+    }
+
+    std::vector<int> lost;
+    for (size_t k = 0; k < group.size(); k++)
+    {
+        int s = group[k];
+        if (k >= futures.size())
+        {
+            lost.push_back(s);
+            continue;
+        }
+        try
+        {
+            results[s] = futures[k].attr("result")();
+        }
+        catch (py::error_already_set &e)
+        {
+            if (e.matches(broken_pool))
+                lost.push_back(s);
+            else if (e.matches(PyExc_Exception))
+                errors[s] = e.what();
+            else
+                throw;
+        }
+    }
+    return lost;
+}
+
+/*
+ * Runs the shards on the executor. results[s] receives the packed MeshData of shard s, or
+ * errors[s] the reason why it failed.
+ *
+ * When a worker process dies, the executor is broken and all its unfinished shards are lost.
+ * The lost shards are bisected: each half runs again in a fresh executor of up to processes
+ * workers, so the shards next to a crashing one keep running in parallel. A shard that is lost
+ * on its own is the one whose worker died.
+ *
+ * Own executors spawn their workers: a forked child would inherit the OCCT and TessellatorPool
+ * thread pools of the parent without their threads, and deadlock in the first parallel loop.
+ */
+void run_shards(const std::vector<py::object> &payloads, const py::dict &options, int processes,
+                py::object executor, std::vector<py::object> &results, std::vector<std::string> &errors)
+{
+    py::object process_pool = py::module_::import("concurrent.futures").attr("ProcessPoolExecutor");
+    py::object spawn = py::module_::import("multiprocessing").attr("get_context")("spawn");
+
+    std::vector<int> all(payloads.size());
+    std::iota(all.begin(), all.end(), 0);
+    std::vector<std::vector<int>> groups = {all};
+    bool first = true;
+
+    while (!groups.empty())
+    {
+        std::vector<std::vector<int>> next;
+        for (const std::vector<int> &group : groups)
+        {
+            // a user executor is broken after a crash, reruns use own executors
+            bool own = executor.is_none() || !first;
+            int workers = std::min(processes, static_cast<int>(group.size()));
+            py::object pool = own ? process_pool(workers, py::arg("mp_context") = spawn) : executor;
+
+            std::vector<int> lost;
+            try
+            {
+                lost = run_group(pool, group, payloads, options, results, errors);
+            }
+            catch (...)
+            {
+                if (own)
+                    pool.attr("shutdown")(py::arg("wait") = false, py::arg("cancel_futures") = true);
+                throw;
+            }
+            if (own)
+                pool.attr("shutdown")();
+
+            if (lost.size() == 1)
+            {
+                errors[lost.front()] = "worker process died";
+            }
+            else if (!lost.empty())
+            {
+                auto middle = lost.begin() + lost.size() / 2;
+                next.emplace_back(lost.begin(), middle);
+                next.emplace_back(middle, lost.end());
+            }
+        }
+        groups = std::move(next);
+        first = false;
+    }
+}
+
+/*
+ * Takes the arrays of a packed worker result and checks them against the shard
+ */
+void view_shard(py::object packed, const Shard &shard, bool compute_faces, bool compute_edges,
+                bool edges_by_index, ShardArrays &a)
+{
+    a.mesh_data = unpack_mesh_data(packed);
+    const MeshData &m = a.mesh_data;
+
+    a.num_faces = static_cast<int>(m.face_types.size());
+    a.num_edges = static_cast<int>(m.edge_types.size());
+    if (!m.local_indices)
+        throw std::invalid_argument("worker returned global indices");
+    if (compute_faces && a.num_faces != static_cast<int>(shard.faces.size()))
+        throw std::invalid_argument("worker returned an unexpected number of faces");
+    if (compute_edges && !edges_by_index && a.num_edges != static_cast<int>(shard.edges.size()))
+        throw std::invalid_argument("worker returned an unexpected number of edges");
+
+    a.vertices = m.vertices.data();
+    a.normals = m.normals.data();
+    a.triangles = m.triangles.data();
+    a.index_size = static_cast<size_t>(m.triangles.itemsize());
+    a.vertex_offsets = m.vertex_offsets.data();
+    a.index_offsets = m.index_offsets.data();
+    a.triangles_per_face = m.triangles_per_face.data();
+    a.face_types = m.face_types.data();
+    a.face_bounds = m.face_bounds.data();
+    a.segments = m.segments.data();
+    a.segments_per_edge = m.segments_per_edge.data();
+    a.edge_types = m.edge_types.data();
+    a.edge_bounds = m.edge_bounds.data();
+
+    a.segment_offsets.resize(a.num_edges + 1);
+    a.segment_offsets[0] = 0;
+    for (int k = 0; k < a.num_edges; k++)
+        a.segment_offsets[k + 1] = a.segment_offsets[k] + a.segments_per_edge[k];
+
+    a.valid = true;
+}
+
+/*
+ * Parameters of discretize_free_edge() for the edges without faces, which are in no shard
+ */
+struct FreeEdgeSampling
+{
+    double deflection;
+    double angular_tolerance;
+    bool relative;
+    double min_size;
+    double max_deflection;
+};
+
+/*
+ * Merges the worker results into the face and edge order of the shape. Faces and edges of
+ * failed shards stay empty, edges without faces are discretized here.
+ */
+MeshData merge_shards(const TopoDS_Shape &shape, const TopTools_IndexedMapOfShape &face_map,
+                      const TopTools_IndexedMapOfShape &edge_map, const std::vector<Shard> &shards,
+                      const std::vector<ShardArrays> &arrays, bool compute_faces, bool compute_edges,
+                      bool local_indices, const FreeEdgeSampling &sampling)
+{
+    const int num_shards = static_cast<int>(shards.size());
+    const int num_faces = compute_faces ? face_map.Extent() : 0;
+
+    // shapes without edges get the triangle edges computed by the workers, in shard order
+    const bool edges_by_index = edge_map.Extent() == 0;
+    int num_edges = 0;
+    if (compute_edges)
+    {
+        num_edges = edge_map.Extent();
+        if (edges_by_index)
+            for (const ShardArrays &a : arrays)
+                num_edges += a.valid ? a.num_edges : 0;
+    }
+
+    Arena arena;
+
+    std::optional<py::gil_scoped_release> release;
+    release.emplace();
+
+    const double inf = std::numeric_limits<double>::infinity();
+    auto empty_bounds = [inf](double bounds[6])
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            bounds[k] = inf;
+            bounds[k + 3] = -inf;
+        }
+    };
+
+    std::vector<Source> face_sources(num_faces);
+    std::vector<Source> edge_sources(num_edges);
+    int next_edge = 0;
+    for (int s = 0; s < num_shards; s++)
+    {
+        const ShardArrays &a = arrays[s];
+        if (!a.valid)
+            continue;
+        if (compute_faces)
+            for (int k = 0; k < a.num_faces; k++)
+                face_sources[shards[s].faces[k]] = {s, k};
+        if (compute_edges)
+            for (int k = 0; k < a.num_edges; k++)
+            {
+                int i = edges_by_index ? next_edge++ : shards[s].edges[k];
+                if (i >= 0)
+                    edge_sources[i] = {s, k};
+            }
+    }
+
+    std::vector<std::vector<gp_Pnt>> free_edge_points;
+    if (compute_edges && !edges_by_index)
+    {
+        std::vector<char> in_shard(num_edges, 0);
+        for (const Shard &shard : shards)
+            for (int i : shard.edges)
+                if (i >= 0)
+                    in_shard[i] = 1;
+
+        free_edge_points.resize(num_edges);
+        OSD_Parallel::For(0, num_edges, [&](int i)
+                          {
+            if (!in_shard[i])
+                free_edge_points[i] = discretize_free_edge(TopoDS::Edge(edge_map(i + 1)), sampling.deflection,
+                                                           sampling.angular_tolerance, sampling.relative,
+                                                           sampling.min_size, sampling.max_deflection); }, num_edges < 64);
+    }
+
+    // Serial pass: take the buffers from the arena, which is not thread safe
+
+    int total_num_vertices = 0;
+    int total_num_triangles = 0;
+    FaceData *face_list = arena.allocate<FaceData>(num_faces);
+    for (int i = 0; i < num_faces; i++)
+    {
+        FaceData &f = face_list[i];
+        f = FaceData();
+        f.face_type = -1;
+        empty_bounds(f.bounds);
+
+        const Source &src = face_sources[i];
+        if (src.shard < 0)
+            continue;
+        const ShardArrays &a = arrays[src.shard];
+
+        f.num_vertices = a.vertex_offsets[src.index + 1] - a.vertex_offsets[src.index];
+        f.num_triangles = a.triangles_per_face[src.index];
+        f.face_type = a.face_types[src.index];
+        f.vertices = arena.allocate<Standard_Real>(3 * f.num_vertices);
+        f.normals = arena.allocate<Standard_Real>(3 * f.num_vertices);
+        f.triangles = arena.allocate<Standard_Integer>(3 * f.num_triangles);
+        std::copy(a.face_bounds + 6 * src.index, a.face_bounds + 6 * src.index + 6, f.bounds);
+
+        total_num_vertices += f.num_vertices;
+        total_num_triangles += f.num_triangles;
+    }
+
+    int total_num_segments = 0;
+    EdgeData *edge_list = arena.allocate<EdgeData>(num_edges);
+    for (int i = 0; i < num_edges; i++)
+    {
+        EdgeData &e = edge_list[i];
+        e.segments = nullptr;
+        e.num_segments = 0;
+        e.edge_type = -1;
+        empty_bounds(e.bounds);
+
+        const Source &src = edge_sources[i];
+        if (src.shard < 0)
+        {
+            if (!free_edge_points.empty() && !free_edge_points[i].empty())
+            {
+                set_edge_polyline(e, free_edge_points[i], arena);
+                e.edge_type = get_edge_type(TopoDS::Edge(edge_map(i + 1)));
+                total_num_segments += e.num_segments;
+            }
+            continue;
+        }
+        const ShardArrays &a = arrays[src.shard];
+
+        e.num_segments = a.segments_per_edge[src.index];
+        e.edge_type = a.edge_types[src.index];
+        e.segments = arena.allocate<Standard_Real>(6 * e.num_segments);
+        std::copy(a.edge_bounds + 6 * src.index, a.edge_bounds + 6 * src.index + 6, e.bounds);
+
+        total_num_segments += e.num_segments;
+    }
+
+    // Parallel pass: widen the worker arrays into the lists collect_mesh_data expects
+
+    OSD_Parallel::For(0, num_faces, [&](int i)
+                      {
+        const Source &src = face_sources[i];
+        if (src.shard < 0)
+            return;
+        const ShardArrays &a = arrays[src.shard];
+        FaceData &f = face_list[i];
+
+        const float *v = a.vertices + 3 * a.vertex_offsets[src.index];
+        const float *n = a.normals + 3 * a.vertex_offsets[src.index];
+        std::copy(v, v + 3 * f.num_vertices, f.vertices);
+        std::copy(n, n + 3 * f.num_vertices, f.normals);
+
+        const int first = a.index_offsets[src.index];
+        if (a.index_size == sizeof(uint16_t))
+        {
+            const uint16_t *t = static_cast<const uint16_t *>(a.triangles) + first;
+            std::copy(t, t + 3 * f.num_triangles, f.triangles);
+        }
+        else
+        {
+            const uint32_t *t = static_cast<const uint32_t *>(a.triangles) + first;
+            std::copy(t, t + 3 * f.num_triangles, f.triangles);
+        } }, num_faces < 64);
+
+    OSD_Parallel::For(0, num_edges, [&](int i)
+                      {
+        const Source &src = edge_sources[i];
+        if (src.shard < 0)
+            return;
+        const ShardArrays &a = arrays[src.shard];
+        EdgeData &e = edge_list[i];
+
+        const float *segments = a.segments + 6 * a.segment_offsets[src.index];
+        std::copy(segments, segments + 6 * e.num_segments, e.segments); }, num_edges < 64);
+
+    TopTools_IndexedMapOfShape vertex_map;
+    TopExp::MapShapes(shape, TopAbs_VERTEX, vertex_map);
+
+    const int num_vertices = vertex_map.Extent();
+    double *vertex_list = arena.allocate<double>(3 * num_vertices);
+    for (int i = 0; i < num_vertices; i++)
+    {
+        gp_Pnt p = BRep_Tool::Pnt(TopoDS::Vertex(vertex_map.FindKey(i + 1)));
+        vertex_list[3 * i + 0] = p.X();
+        vertex_list[3 * i + 1] = p.Y();
+        vertex_list[3 * i + 2] = p.Z();
+    }
+
+    release.reset();
+
+    // the workers already interpolated missing normals, computed missing edges and reordered
+    return collect_mesh_data(face_list, total_num_vertices, total_num_triangles, num_faces,
+                             edge_list, total_num_segments, num_edges, vertex_list, num_vertices,
+                             false, false, local_indices, false, arena, false);
+}
+
+} // namespace
+
+py::array run_shard(py::object /* cls */, py::bytes payload, py::dict options, int shard)
+{
+    // testing aid: simulates a crash of the worker running one shard
+    const char *crash_shard = std::getenv("OCP_ADDONS_SHARD_CRASH");
+    if (crash_shard != nullptr && std::atoi(crash_shard) == shard)
+        std::_Exit(1);
+
+    // a fresh worker process has only imported ocp_addons to unpickle this call
+    py::module_::import("OCP.TopoDS");
+    py::object tessellate_function = py::module_::import("ocp_addons.tessellator").attr("tessellate");
+
+    TopoDS_Shape shape = deserialize_shape(payload);
+    MeshData mesh_data = tessellate_function(py::cast(shape), **options).cast<MeshData>();
+    return pack_mesh_data(mesh_data);
+}
+
+MeshData tessellate_sharded(py::object obj, double deflection, double angular_tolerance,
+                            bool compute_faces, bool compute_edges, bool local_indices,
+                            const std::string &shard_by, int faces_per_shard, int processes,
+                            py::object executor, py::kwargs options)
+{
+    const TopoDS_Shape &shape = *obj.cast<TopoDS_Shape *>();
+
+    if (shard_by != "solid" && shard_by != "faces")
+        throw std::invalid_argument("shard_by must be \"solid\" or \"faces\"");
+    for (const char *key : {"progress", "cancel_token", "output", "adjacency", "flat_normals"})
+    {
+        if (options.contains(key))
+            throw std::invalid_argument(std::string(key) + " is not supported by tessellate_sharded()");
+    }
+
+    if (processes <= 0)
+    {
+        py::object cpu_count = py::module_::import("os").attr("cpu_count")();
+        processes = cpu_count.is_none() ? 1 : cpu_count.cast<int>();
+    }
+
+    py::dict worker_options;
+    for (auto item : options)
+        worker_options[item.first] = item.second;
+    if (!worker_options.contains("parallel"))
+        worker_options["parallel"] = false;
+    worker_options["deflection"] = deflection;
+    worker_options["angular_tolerance"] = angular_tolerance;
+    worker_options["compute_faces"] = compute_faces;
+    worker_options["compute_edges"] = compute_edges;
+    // merging reads face local indices
+    worker_options["local_indices"] = true;
+
+    TopTools_IndexedMapOfShape face_map;
+    TopTools_IndexedMapOfShape edge_map;
+    std::vector<Shard> shards;
+    {
+        py::gil_scoped_release release;
+
+        TopExp::MapShapes(shape, TopAbs_FACE, face_map);
+        TopExp::MapShapes(shape, TopAbs_EDGE, edge_map);
+
+        if (faces_per_shard <= 0)
+            faces_per_shard = std::max(1, (face_map.Extent() + 4 * processes - 1) / (4 * processes));
+        if (compute_faces || compute_edges)
+            shards = make_shards(shape, face_map, edge_map, shard_by == "solid", faces_per_shard);
+    }
+
+    const int num_shards = static_cast<int>(shards.size());
+    std::vector<py::object> results(num_shards);
+    std::vector<std::string> errors(num_shards);
+    {
+        std::vector<py::object> payloads;
+        payloads.reserve(num_shards);
+        for (const Shard &shard : shards)
+            payloads.push_back(serialize_shape(shard.compound));
+
+        run_shards(payloads, worker_options, processes, executor, results, errors);
+    }
+
+    const bool edges_by_index = edge_map.Extent() == 0;
+    std::vector<ShardArrays> arrays(num_shards);
+    std::string failures;
+    int num_failed = 0;
+    for (int s = 0; s < num_shards; s++)
+    {
+        if (results[s])
+        {
+            try
+            {
+                view_shard(results[s], shards[s], compute_faces, compute_edges, edges_by_index, arrays[s]);
+            }
+            catch (std::exception &e)
+            {
+                arrays[s] = ShardArrays();
+                errors[s] = e.what();
+            }
+        }
+        if (!arrays[s].valid)
+        {
+            num_failed++;
+            failures += "\n  shard " + std::to_string(s) + " (" + std::to_string(shards[s].faces.size()) +
+                        " faces from face " + std::to_string(shards[s].faces.front()) + "): " + errors[s];
+        }
+    }
+
+    if (num_failed > 0)
+    {
+        std::string message = std::to_string(num_failed) + " of " + std::to_string(num_shards) +
+                              " shards failed, their faces and edges are empty:" + failures;
+        if (PyErr_WarnEx(PyExc_RuntimeWarning, message.c_str(), 1) != 0)
+            throw py::error_already_set();
+    }
+
+    auto option = [&options](const char *key, auto fallback)
+    { return options.contains(key) ? options[key].cast<decltype(fallback)>() : fallback; };
+    FreeEdgeSampling sampling{deflection, angular_tolerance, option("relative", false),
+                              option("min_size", 0.0), option("max_deflection", 0.0)};
+
+    return merge_shards(shape, face_map, edge_map, shards, arrays, compute_faces, compute_edges, local_indices,
+                        sampling);
+}
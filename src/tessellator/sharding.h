@@ -0,0 +1,73 @@
+#pragma once
+
+/**
+ * @file sharding.h
+ * @brief Multi-process sharded tessellation of large compounds
+ *
+ * The faces of a shape are split into shards (whole solids packed together, or groups of
+ * faces), each shard is serialized with the serializer and tessellated by tessellate() in a
+ * worker process of a concurrent.futures.ProcessPoolExecutor. The packed results are merged
+ * into one MeshData in the face and edge order of tessellate(shape).
+ *
+ * A worker process that dies (e.g. a crash inside an OCCT algorithm) breaks the executor. The
+ * shards that were lost are bisected and run again in fresh executors of up to processes
+ * workers until the crashing shard is lost on its own, so that only it fails; its faces and
+ * edges stay empty and a RuntimeWarning is issued. For tests, the worker of the shard given by
+ * the environment variable OCP_ADDONS_SHARD_CRASH exits immediately.
+ */
+
+#include <string>
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include "tessellator.h"
+
+namespace py = pybind11;
+
+/**
+ * @struct ShardWorker
+ * @brief Holder of the classmethod run(payload, options, shard) executed in the worker processes
+ *
+ * Executors pickle the callable by reference as getattr(ShardWorker, "run"), plain pybind11
+ * functions cannot be pickled.
+ */
+struct ShardWorker
+{
+};
+
+/**
+ * @brief Tessellates one serialized shard (ShardWorker.run)
+ *
+ * @param payload Shard serialized with serialize_shape()
+ * @param options Keyword arguments of tessellate()
+ * @param shard Index of the shard, compared with OCP_ADDONS_SHARD_CRASH
+ * @return Packed MeshData (see pack_mesh_data()), one buffer to send back to the parent process
+ */
+py::array run_shard(py::object cls, py::bytes payload, py::dict options, int shard);
+
+/**
+ * @brief Tessellates a shape in shards in worker processes and merges the results
+ *
+ * Shards are meshed independently, so edges shared by faces of different shards can be
+ * discretized differently on both sides (no such edges with shard_by="solid" unless solids
+ * share faces). Edges without faces are in no shard and discretized in the calling process.
+ * The shape itself does not receive triangulations.
+ *
+ * @param obj The shape to tessellate
+ * @param deflection, angular_tolerance, compute_faces, compute_edges, local_indices As for tessellate()
+ * @param shard_by "solid" packs whole solids (faces outside of solids are grouped) into shards
+ *        of about faces_per_shard faces, "faces" splits the faces into groups of faces_per_shard
+ * @param faces_per_shard Target number of faces per shard (0 = num_faces / (4 * processes))
+ * @param processes Number of worker processes (0 = os.cpu_count())
+ * @param executor concurrent.futures executor to use instead of a new ProcessPoolExecutor (whose
+ *        workers are spawned, not forked); a process executor should not use fork either
+ * @param options Further keyword arguments of tessellate() for the workers (picklable), parallel
+ *        defaults to False since the processes already use all cores
+ * @return MeshData in the face and edge order of tessellate(shape)
+ * @throws std::invalid_argument for an unknown shard_by or options that cannot be forwarded
+ */
+MeshData tessellate_sharded(py::object obj, double deflection, double angular_tolerance,
+                            bool compute_faces, bool compute_edges, bool local_indices,
+                            const std::string &shard_by, int faces_per_shard, int processes,
+                            py::object executor, py::kwargs options);
@@ -0,0 +1,498 @@
+#include "simplify.h"
+#include "mesh_view.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <vector>
+
+#include <OSD_Parallel.hxx>
+
+namespace
+{
+
+constexpr double MIN_NORMAL_COSINE = 0.5;
+
+struct Vec3
+{
+    double x, y, z;
+
+    Vec3 operator-(const Vec3 &o) const { return {x - o.x, y - o.y, z - o.z}; }
+    double dot(const Vec3 &o) const { return x * o.x + y * o.y + z * o.z; }
+    Vec3 cross(const Vec3 &o) const { return {y * o.z - z * o.y, z * o.x - x * o.z, x * o.y - y * o.x}; }
+    double length() const { return std::sqrt(dot(*this)); }
+};
+
+/*
+ * Symmetric 4x4 quadric, upper triangle a2 ab ac ad b2 bc bd c2 cd d2
+ */
+struct Quadric
+{
+    double q[10] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+
+    void add_plane(const Vec3 &n, double d, double weight)
+    {
+        const double p[4] = {n.x, n.y, n.z, d};
+        int k = 0;
+        for (int i = 0; i < 4; i++)
+            for (int j = i; j < 4; j++)
+                q[k++] += weight * p[i] * p[j];
+    }
+
+    Quadric &operator+=(const Quadric &o)
+    {
+        for (int k = 0; k < 10; k++)
+            q[k] += o.q[k];
+        return *this;
+    }
+
+    double error(const Vec3 &p) const
+    {
+        return q[0] * p.x * p.x + 2 * q[1] * p.x * p.y + 2 * q[2] * p.x * p.z + 2 * q[3] * p.x +
+               q[4] * p.y * p.y + 2 * q[5] * p.y * p.z + 2 * q[6] * p.y +
+               q[7] * p.z * p.z + 2 * q[8] * p.z + q[9];
+    }
+};
+
+/*
+ * Half-edge collapse of vertex u into vertex v, valid while both vertices keep their stamps.
+ * cost (area weighted) orders the collapses, distance (sum of the squared distances to the
+ * unit weight planes) bounds the largest squared distance to one of the original planes.
+ */
+struct Collapse
+{
+    double cost;
+    double distance;
+    int u, v;
+    int stamp_u, stamp_v;
+
+    bool operator>(const Collapse &o) const { return cost > o.cost; }
+};
+
+struct FaceResult
+{
+    std::vector<float> vertices;
+    std::vector<float> normals;
+    std::vector<int> triangles;
+    float bounds[6] = {INFINITY, INFINITY, INFINITY, -INFINITY, -INFINITY, -INFINITY};
+};
+
+class FaceSimplifier
+{
+public:
+    FaceSimplifier(const MeshView &view, int face) : view_(view)
+    {
+        v_base_ = view.vertex_offsets[face];
+        num_vertices_ = view.vertex_offsets[face + 1] - v_base_;
+        const int i0 = view.index_offsets[face];
+        num_triangles_ = (view.index_offsets[face + 1] - i0) / 3;
+
+        positions_.resize(num_vertices_);
+        for (int v = 0; v < num_vertices_; v++)
+        {
+            const float *p = view.vertices + 3 * size_t(v_base_ + v);
+            positions_[v] = {p[0], p[1], p[2]};
+        }
+        triangles_.resize(3 * size_t(num_triangles_));
+        for (size_t k = 0; k < triangles_.size(); k++)
+            triangles_[k] = view.triangles.local(i0 + k, v_base_);
+    }
+
+    FaceResult run(double ratio, double max_error, double cos_feature)
+    {
+        const int target = static_cast<int>(std::ceil(ratio * num_triangles_));
+        if (num_triangles_ > target)
+            collapse(target, max_error, cos_feature);
+        return compact();
+    }
+
+private:
+    const MeshView &view_;
+    int v_base_;
+    int num_vertices_;
+    int num_triangles_;
+    std::vector<Vec3> positions_;
+    std::vector<int> triangles_;
+    std::vector<char> removed_;
+    std::vector<std::vector<int>> vertex_triangles_;
+
+    Vec3 normal(int t, int moved = -1, const Vec3 *to = nullptr) const
+    {
+        Vec3 p[3];
+        for (int c = 0; c < 3; c++)
+        {
+            const int v = triangles_[3 * t + c];
+            p[c] = v == moved ? *to : positions_[v];
+        }
+        return (p[1] - p[0]).cross(p[2] - p[0]);
+    }
+
+    bool contains(int t, int v) const
+    {
+        return triangles_[3 * t] == v || triangles_[3 * t + 1] == v || triangles_[3 * t + 2] == v;
+    }
+
+    void neighbors(int v, std::vector<int> &out) const
+    {
+        out.clear();
+        for (int t : vertex_triangles_[v])
+            for (int c = 0; c < 3; c++)
+            {
+                const int w = triangles_[3 * t + c];
+                if (w != v && std::find(out.begin(), out.end(), w) == out.end())
+                    out.push_back(w);
+            }
+    }
+
+    /*
+     * Face boundary vertices (edges with one triangle), vertices of non-manifold edges and
+     * vertices of edges sharper than the feature angle must not move
+     */
+    std::vector<char> locked_vertices(double cos_feature) const
+    {
+        std::vector<std::pair<int64_t, int>> edges;
+        edges.reserve(triangles_.size());
+        for (int t = 0; t < num_triangles_; t++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                int a = triangles_[3 * t + c];
+                int b = triangles_[3 * t + (c + 1) % 3];
+                if (a > b)
+                    std::swap(a, b);
+                edges.emplace_back(int64_t(a) * num_vertices_ + b, t);
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        std::vector<char> locked(num_vertices_, 0);
+        for (size_t k = 0; k < edges.size();)
+        {
+            size_t end = k + 1;
+            while (end < edges.size() && edges[end].first == edges[k].first)
+                end++;
+
+            bool lock = end - k != 2;
+            if (!lock)
+            {
+                Vec3 n1 = normal(edges[k].second);
+                Vec3 n2 = normal(edges[k + 1].second);
+                double length = n1.length() * n2.length();
+                lock = length > 0.0 && n1.dot(n2) < cos_feature * length;
+            }
+            if (lock)
+            {
+                locked[edges[k].first / num_vertices_] = 1;
+                locked[edges[k].first % num_vertices_] = 1;
+            }
+            k = end;
+        }
+        return locked;
+    }
+
+    /*
+     * Moving u onto v must not flip or degenerate the remaining triangles of u, and u and v
+     * may only share the neighbors of their common triangles (link condition)
+     */
+    bool is_valid(int u, int v, std::vector<int> &nu, std::vector<int> &nv) const
+    {
+        int shared = 0;
+        for (int t : vertex_triangles_[u])
+        {
+            if (contains(t, v))
+            {
+                shared++;
+                continue;
+            }
+            Vec3 before = normal(t);
+            Vec3 after = normal(t, u, &positions_[v]);
+            // also rejects slivers whose normal tilts away
+            if (after.dot(before) <= MIN_NORMAL_COSINE * after.length() * before.length())
+                return false;
+        }
+        if (shared == 0)
+            return false;
+
+        neighbors(u, nu);
+        neighbors(v, nv);
+        int common = 0;
+        for (int w : nu)
+            if (std::find(nv.begin(), nv.end(), w) != nv.end())
+                common++;
+        return common == shared;
+    }
+
+    void collapse(int target, double max_error, double cos_feature)
+    {
+        std::vector<char> locked = locked_vertices(cos_feature);
+
+        removed_.assign(num_triangles_, 0);
+        vertex_triangles_.assign(num_vertices_, {});
+        std::vector<Quadric> quadrics(num_vertices_);
+        std::vector<Quadric> planes(num_vertices_);
+        for (int t = 0; t < num_triangles_; t++)
+        {
+            Vec3 n = normal(t);
+            double length = n.length();
+            if (length == 0.0)
+                removed_[t] = 1;
+            for (int c = 0; c < 3; c++)
+            {
+                const int v = triangles_[3 * t + c];
+                if (!removed_[t])
+                    vertex_triangles_[v].push_back(t);
+            }
+            if (removed_[t])
+                continue;
+            // area weighted plane of the triangle for the order, unit weight for max_error
+            Vec3 unit = {n.x / length, n.y / length, n.z / length};
+            double d = -unit.dot(positions_[triangles_[3 * t]]);
+            for (int c = 0; c < 3; c++)
+            {
+                quadrics[triangles_[3 * t + c]].add_plane(unit, d, 0.5 * length);
+                planes[triangles_[3 * t + c]].add_plane(unit, d, 1.0);
+            }
+        }
+        int live = static_cast<int>(std::count(removed_.begin(), removed_.end(), 0));
+
+        std::vector<int> stamps(num_vertices_, 0);
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+        auto push = [&](int u, int v)
+        {
+            if (locked[u])
+                return;
+            Quadric q = quadrics[u];
+            q += quadrics[v];
+            Quadric p = planes[u];
+            p += planes[v];
+            heap.push({q.error(positions_[v]), p.error(positions_[v]), u, v, stamps[u], stamps[v]});
+        };
+
+        std::vector<int> nu, nv;
+        for (int u = 0; u < num_vertices_; u++)
+        {
+            neighbors(u, nu);
+            for (int v : nu)
+                push(u, v);
+        }
+
+        const double max_distance = max_error * max_error;
+        std::vector<char> vertex_removed(num_vertices_, 0);
+        while (live > target && !heap.empty())
+        {
+            Collapse c = heap.top();
+            heap.pop();
+            const int u = c.u, v = c.v;
+            if (vertex_removed[u] || vertex_removed[v] || stamps[u] != c.stamp_u || stamps[v] != c.stamp_v)
+                continue;
+            // the distance does not follow the area weighted order, so skip instead of stopping
+            if (max_error > 0.0 && c.distance > max_distance)
+                continue;
+            if (!is_valid(u, v, nu, nv))
+                continue;
+
+            for (int t : vertex_triangles_[u])
+            {
+                if (contains(t, v))
+                {
+                    removed_[t] = 1;
+                    live--;
+                    for (int k = 0; k < 3; k++)
+                    {
+                        const int w = triangles_[3 * t + k];
+                        if (w == u)
+                            continue;
+                        auto &list = vertex_triangles_[w];
+                        list.erase(std::find(list.begin(), list.end(), t));
+                    }
+                }
+                else
+                {
+                    for (int k = 0; k < 3; k++)
+                        if (triangles_[3 * t + k] == u)
+                            triangles_[3 * t + k] = v;
+                    vertex_triangles_[v].push_back(t);
+                }
+            }
+            vertex_triangles_[u].clear();
+            vertex_removed[u] = 1;
+            quadrics[v] += quadrics[u];
+            planes[v] += planes[u];
+            stamps[v]++;
+
+            neighbors(v, nv);
+            for (int w : nv)
+            {
+                push(v, w);
+                push(w, v);
+            }
+        }
+    }
+
+    FaceResult compact() const
+    {
+        FaceResult out;
+        auto kept = [&](int t)
+        { return removed_.empty() || !removed_[t]; };
+
+        // referenced vertices keep their order, without triangles all vertices are kept as
+        // collect_mesh_data does
+        std::vector<int> remap(num_vertices_, -1);
+        for (int t = 0; t < num_triangles_; t++)
+            if (kept(t))
+                for (int c = 0; c < 3; c++)
+                    remap[triangles_[3 * t + c]] = 0;
+        const bool keep_all = std::find(remap.begin(), remap.end(), 0) == remap.end();
+        int next = 0;
+        for (int &r : remap)
+            if (keep_all || r == 0)
+                r = next++;
+
+        for (int t = 0; t < num_triangles_; t++)
+            if (kept(t))
+                for (int c = 0; c < 3; c++)
+                    out.triangles.push_back(remap[triangles_[3 * t + c]]);
+
+        out.vertices.resize(3 * size_t(next));
+        out.normals.resize(3 * size_t(next));
+        for (int v = 0; v < num_vertices_; v++)
+        {
+            if (remap[v] < 0)
+                continue;
+            const size_t src = 3 * size_t(v_base_ + v);
+            const size_t dst = 3 * size_t(remap[v]);
+            for (int c = 0; c < 3; c++)
+            {
+                out.vertices[dst + c] = view_.vertices[src + c];
+                out.normals[dst + c] = view_.normals[src + c];
+                out.bounds[c] = std::min(out.bounds[c], view_.vertices[src + c]);
+                out.bounds[3 + c] = std::max(out.bounds[3 + c], view_.vertices[src + c]);
+            }
+        }
+        return out;
+    }
+};
+
+template <typename T>
+T *pack_triangles(const std::vector<FaceResult> &per_face, size_t num_indices, bool local_indices)
+{
+    auto triangles = new T[num_indices];
+    size_t k = 0;
+    int v_total = 0;
+    for (const FaceResult &f : per_face)
+    {
+        const int offset = local_indices ? 0 : v_total;
+        for (int index : f.triangles)
+            triangles[k++] = static_cast<T>(index + offset);
+        v_total += static_cast<int>(f.vertices.size() / 3);
+    }
+    return triangles;
+}
+
+} // namespace
+
+MeshData simplify_mesh(const MeshData &mesh_data, double ratio, double max_error, double feature_angle)
+{
+    if (!(ratio >= 0.0 && ratio <= 1.0))
+        throw std::invalid_argument("ratio must be between 0 and 1");
+    if (!(max_error >= 0.0))
+        throw std::invalid_argument("max_error must not be negative");
+    if (!(feature_angle >= 0.0))
+        throw std::invalid_argument("feature_angle must not be negative");
+
+    MeshView view = view_mesh_data(mesh_data);
+    if (view.normals == nullptr)
+        throw std::invalid_argument("simplify needs per vertex normals, tessellate without flat_normals");
+    const int num_faces = view.num_faces;
+    const bool local_indices = mesh_data.local_indices;
+    const int itemsize = view.triangles.itemsize;
+    const double cos_feature = std::cos(feature_angle);
+
+    std::optional<py::gil_scoped_release> release;
+    release.emplace();
+
+    std::vector<FaceResult> per_face(num_faces);
+    OSD_Parallel::For(0, num_faces, [&](int i)
+                      {
+        FaceSimplifier simplifier(view, i);
+        per_face[i] = simplifier.run(ratio, max_error, cos_feature); }, num_faces < 64);
+
+    size_t num_vertices = 0;
+    size_t num_indices = 0;
+    for (const FaceResult &f : per_face)
+    {
+        num_vertices += f.vertices.size() / 3;
+        num_indices += f.triangles.size();
+    }
+
+    auto vertices = new float[3 * num_vertices];
+    auto normals = new float[3 * num_vertices];
+    auto vertex_offsets = new int[num_faces + 1];
+    auto index_offsets = new int[num_faces + 1];
+    auto triangles_per_face = new int[num_faces];
+    auto face_bounds = new float[6 * num_faces];
+
+    size_t v_total = 0;
+    size_t i_total = 0;
+    for (int i = 0; i < num_faces; i++)
+    {
+        const FaceResult &f = per_face[i];
+        vertex_offsets[i] = static_cast<int>(v_total);
+        index_offsets[i] = static_cast<int>(i_total);
+        triangles_per_face[i] = static_cast<int>(f.triangles.size() / 3);
+        std::copy(f.vertices.begin(), f.vertices.end(), vertices + 3 * v_total);
+        std::copy(f.normals.begin(), f.normals.end(), normals + 3 * v_total);
+        std::copy(f.bounds, f.bounds + 6, face_bounds + 6 * i);
+        v_total += f.vertices.size() / 3;
+        i_total += f.triangles.size();
+    }
+    vertex_offsets[num_faces] = static_cast<int>(v_total);
+    index_offsets[num_faces] = static_cast<int>(i_total);
+
+    void *triangles;
+    if (itemsize == 2)
+        triangles = pack_triangles<uint16_t>(per_face, num_indices, local_indices);
+    else if (local_indices)
+        triangles = pack_triangles<uint32_t>(per_face, num_indices, local_indices);
+    else
+        triangles = pack_triangles<int>(per_face, num_indices, local_indices);
+
+    release.reset();
+
+    MeshData result;
+    result.vertices = wrap_numpy(vertices, static_cast<int>(3 * num_vertices));
+    result.normals = wrap_numpy(normals, static_cast<int>(3 * num_vertices));
+    if (itemsize == 2)
+        result.triangles = wrap_numpy(static_cast<uint16_t *>(triangles), static_cast<int>(num_indices));
+    else if (local_indices)
+        result.triangles = wrap_numpy(static_cast<uint32_t *>(triangles), static_cast<int>(num_indices));
+    else
+        result.triangles = wrap_numpy(static_cast<int *>(triangles), static_cast<int>(num_indices));
+    result.local_indices = local_indices;
+    result.vertex_offsets = wrap_numpy(vertex_offsets, num_faces + 1);
+    result.index_offsets = wrap_numpy(index_offsets, num_faces + 1);
+    result.triangles_per_face = wrap_numpy(triangles_per_face, num_faces);
+    result.face_bounds = wrap_numpy(face_bounds, 6 * num_faces);
+
+    // edges, object vertices, face types and the adjacency do not change
+    result.face_types = mesh_data.face_types;
+    result.segments = mesh_data.segments;
+    result.segments_per_edge = mesh_data.segments_per_edge;
+    result.edge_types = mesh_data.edge_types;
+    result.obj_vertices = mesh_data.obj_vertices;
+    result.edge_bounds = mesh_data.edge_bounds;
+    result.bounds = mesh_data.bounds;
+    result.edge_face_offsets = mesh_data.edge_face_offsets;
+    result.edge_faces = mesh_data.edge_faces;
+    result.face_edge_offsets = mesh_data.face_edge_offsets;
+    result.face_edges = mesh_data.face_edges;
+    if (mesh_data.vertex_faces.size() > 0)
+        result.vertex_faces = expand_vertex_faces(result.vertex_offsets);
+    result.mesh_threads = mesh_data.mesh_threads;
+    result.extraction_threads = mesh_data.extraction_threads;
+    return result;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+/**
+ * @file simplify.h
+ * @brief Quadric error metric simplification of tessellated faces for coarse LODs
+ *
+ * Every face is simplified on its own with half-edge collapses ordered by the quadric error
+ * (Garland-Heckbert) of the collapsed vertex. Vertices on face boundaries and on sharp edges
+ * inside a face are locked, so faces stay watertight against their neighbors and against
+ * the edge polylines, and creases of imported meshes survive. Collapses that flip a triangle
+ * or create non-manifold connectivity are rejected. Kept vertices keep their position and normal.
+ */
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include "tessellator.h"
+
+namespace py = pybind11;
+
+/**
+ * @brief Simplifies all faces of a tessellation, in parallel across faces without the GIL
+ *
+ * A face stops collapsing when its triangle count reaches ratio times the original count or
+ * when every remaining collapse would exceed max_error, whichever comes first.
+ *
+ * @param mesh_data Result of tessellate() (global or local indices, kept in the result)
+ * @param ratio Target fraction of triangles per face (0 to 1)
+ * @param max_error Maximum distance of a kept vertex from the original triangle planes of the
+ *        vertices collapsed into it (0 = no limit). The area weighted quadrics only order the
+ *        collapses, the bound uses unit weight planes, so it holds for small and large faces.
+ * @param feature_angle Edges with a dihedral angle above this angle (radians) are kept sharp
+ * @return New MeshData with the simplified faces; edges, object vertices, adjacency and the
+ *         overall bounds are shared with the input
+ * @throws std::invalid_argument for invalid parameters or an inconsistent MeshData
+ */
+MeshData simplify_mesh(const MeshData &mesh_data, double ratio, double max_error, double feature_angle);
@@ -1,575 +1,526 @@
 #include "tessellator.h"
+#include "arena.h"
+#include "bvh.h"
+#include "mesh_buffer.h"
+#include "mesh_delta.h"
+#include "mesh_export.h"
+#include "meshlets.h"
+#include "progress.h"
+#include "sharding.h"
+#include "simplify.h"
 #include "utils.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <OSD_Parallel.hxx>
 
 namespace py = pybind11;
 
-GeomAbs_SurfaceType get_face_type(TopoDS_Face face)
+/*
+ * Zero copy hand over of the core buffers to numpy
+ */
+
+template <typename T>
+py::array_t<T> to_numpy(Buffer<T> &buffer)
 {
-    return BRepAdaptor_Surface(face).GetType();
+    return wrap_numpy(buffer.data.release(), static_cast<int>(buffer.size));
 }
 
-GeomAbs_CurveType get_edge_type(TopoDS_Edge edge)
+MeshData wrap_mesh_buffers(MeshBuffers &&buffers)
 {
-    return BRepAdaptor_Curve(edge).GetType();
-}
+    MeshData mesh_data;
 
-/**
- * @brief Collects and processes mesh data from face and edge lists into a unified MeshData structure.
- *
- * This function aggregates vertex, triangle, and edge data from multiple faces and edges into
- * consolidated arrays. It can optionally compute missing vertex normals using face normal
- * interpolation and generate triangle edges when edge data is not provided.
- *
- * @param face_list Array of FaceData structures containing face geometry information
- * @param num_vertices Total number of vertices across all faces
- * @param num_triangles Total number of triangles across all faces
- * @param num_faces Number of faces in the face_list array
- * @param edge_list Array of EdgeData structures containing edge segment information
- * @param num_segments Total number of edge segments across all edges
- * @param num_edges Number of edges in the edge_list array
- * @param obj_vertices Array of additional object vertices (external geometry)
- * @param num_obj_vertices Number of vertices in obj_vertices array
- * @param compute_missing_normals If true, computes vertex normals by interpolating face normals
- * @param compute_missing_edges If true, generates edge segments from triangle edges when edge data is unavailable
- * @param timeit If true, enables timing measurements for performance profiling
- *
- * @return MeshData structure containing consolidated mesh geometry with numpy-wrapped arrays
- *
- * @details The function performs the following operations:
- * - Consolidates vertices, normals, and triangles from all faces into unified arrays
- * - Optionally computes vertex normals by averaging adjacent face normals and normalizing
- * - Collects edge segments from provided edge data or generates them from triangle edges
- * - Converts all floating-point data from double to float precision
- * - Wraps all arrays in numpy-compatible format with automatic memory management
- * - Tracks triangles and segments per face/edge for proper indexing
- * - Includes timing measurements for performance analysis when enabled
- *
- * @note Memory for intermediate arrays is automatically cleaned up after numpy wrapping.
- *       The returned MeshData uses capsules for proper Python memory management.
- */
+    // wrap_numpy use a capsule, so Python triggers deletion
+    mesh_data.vertices = to_numpy(buffers.vertices);
+    mesh_data.normals = to_numpy(buffers.normals);
+    mesh_data.triangles = std::visit([](auto &triangles) -> py::array
+                                     { return to_numpy(triangles); }, buffers.triangles);
+    mesh_data.local_indices = buffers.local_indices;
+    mesh_data.vertex_offsets = to_numpy(buffers.vertex_offsets);
+    mesh_data.index_offsets = to_numpy(buffers.index_offsets);
+    mesh_data.triangles_per_face = to_numpy(buffers.triangles_per_face);
+    mesh_data.face_types = to_numpy(buffers.face_types);
+    mesh_data.segments = to_numpy(buffers.segments);
+    mesh_data.segments_per_edge = to_numpy(buffers.segments_per_edge);
+    mesh_data.edge_types = to_numpy(buffers.edge_types);
+    mesh_data.obj_vertices = to_numpy(buffers.obj_vertices);
+    mesh_data.face_bounds = to_numpy(buffers.face_bounds);
+    mesh_data.edge_bounds = to_numpy(buffers.edge_bounds);
+    mesh_data.bounds = to_numpy(buffers.bounds);
+    mesh_data.mesh_threads = buffers.mesh_threads;
+    mesh_data.extraction_threads = buffers.extraction_threads;
+    mesh_data.edge_face_offsets = to_numpy(buffers.edge_face_offsets);
+    mesh_data.edge_faces = to_numpy(buffers.edge_faces);
+    mesh_data.face_edge_offsets = to_numpy(buffers.face_edge_offsets);
+    mesh_data.face_edges = to_numpy(buffers.face_edges);
+    mesh_data.vertex_faces = to_numpy(buffers.vertex_faces);
+    mesh_data.face_normals = to_numpy(buffers.face_normals);
+    mesh_data.flat_faces = to_numpy(buffers.flat_faces);
+    mesh_data.normal_offsets = to_numpy(buffers.normal_offsets);
+
+    return mesh_data;
+}
 
-MeshData collect_mesh_data(
-    FaceData face_list[],
-    int num_vertices,
-    int num_triangles,
-    int num_faces,
-    EdgeData edge_list[],
-    int num_segments,
-    int num_edges,
-    double obj_vertices[],
-    int num_obj_vertices,
-    bool compute_missing_normals,
-    bool compute_missing_edges,
-    bool timeit)
+MeshData collect_mesh_data(FaceData face_list[], int num_vertices, int num_triangles, int num_faces,
+                           EdgeData edge_list[], int num_segments, int num_edges,
+                           double obj_vertices[], int num_obj_vertices,
+                           bool compute_missing_normals, bool compute_missing_edges, bool local_indices,
+                           bool optimize_order, Arena &arena, bool timeit)
 {
-    /*
-     * Collect vertices and triangles
-     */
+    std::optional<py::gil_scoped_release> release;
+    release.emplace();
 
-    Timer timer("Collect vertices and triangles", 2, timeit);
+    MeshBuffers buffers = collect_mesh_buffers(face_list, num_vertices, num_triangles, num_faces,
+                                               edge_list, num_segments, num_edges, obj_vertices, num_obj_vertices,
+                                               compute_missing_normals, compute_missing_edges, local_indices,
+                                               optimize_order, arena, timeit);
 
-    auto vertices = new double[3 * num_vertices];
-    auto normals = new double[3 * num_vertices];
-    auto triangles = new int[3 * num_triangles];
-    auto triangles_per_face = new int[num_faces];
-    auto face_types = new int[num_faces];
-    auto edge_types = new int[num_edges];
+    release.reset();
 
-    int v_total = 0;
-    int t_total = 0;
+    return wrap_mesh_buffers(std::move(buffers));
+}
 
-    for (int i = 0; i < num_faces; i++)
+py::array_t<int> expand_vertex_faces(const py::array_t<int> &vertex_offsets)
+{
+    const int num_faces = std::max(static_cast<int>(vertex_offsets.size()) - 1, 0);
+    Buffer<int> vertex_faces;
     {
+        py::gil_scoped_release release;
+        vertex_faces = vertex_face_indices(vertex_offsets.data(), num_faces);
+    }
+    return to_numpy(vertex_faces);
+}
+
+/*
+ * Printable form of a Python object for the debug output
+ */
+std::string printable(const py::handle &obj)
+{
+    return py::str(obj).cast<std::string>();
+}
+
+/**
+ * @brief Python entry point of tessellate_shape()
+ *
+ * Builds the progress indicator from the callback and the cancel token, releases the GIL while
+ * the core meshes the shape (so other Python threads, e.g. an asyncio event loop, keep running)
+ * and hands the resulting buffers over to numpy without copying. See tessellate_shape() in
+ * mesh_core.cpp for the algorithm and tessellator.h for the parameters.
+ */
+MeshData tessellate(py::object obj, double deflection, double angular_tolerance,
+                    bool compute_faces, bool compute_edges, bool parallel, int debug, bool timeit,
+                    bool local_indices, py::object progress, const CancelToken *cancel_token,
+                    double progress_interval, bool relative, double min_size, double max_deflection,
+                    int threads, py::object output, bool optimize_order, bool adjacency, bool heal,
+                    bool flat_normals)
+{
+    auto *shape_ptr = obj.cast<TopoDS_Shape *>();
+    const TopoDS_Shape &shape = *shape_ptr;
 
-        auto f = face_list[i];
+    if (adjacency && !compute_faces)
+        throw std::invalid_argument("adjacency needs compute_faces");
+
+    TessellateParams params;
+    params.deflection = deflection;
+    params.angular_tolerance = angular_tolerance;
+    params.compute_faces = compute_faces;
+    params.compute_edges = compute_edges;
+    params.parallel = parallel;
+    params.debug = debug;
+    params.timeit = timeit;
+    params.local_indices = local_indices;
+    params.relative = relative;
+    params.min_size = min_size;
+    params.max_deflection = max_deflection;
+    params.threads = threads;
+    params.optimize_order = optimize_order;
+    params.adjacency = adjacency;
+    params.heal = heal;
+    params.flat_normals = flat_normals;
 
-        auto v = f.vertices;
-        auto n = f.normals;
-        auto t = f.triangles;
+    Logger logger(debug);
+    Timer overall("Overall", 0, timeit);
 
-        for (int j = 0; j < f.num_vertices * 3; j++)
-        {
-            vertices[v_total + j] = v[j];
-            normals[v_total + j] = n[j];
-        }
+    Handle(TessellationProgress) indicator;
+    if (!progress.is_none() || cancel_token != nullptr)
+        indicator = new TessellationProgress(progress, cancel_token, progress_interval);
 
-        for (int j = 0; j < f.num_triangles * 3; j++)
-        {
-            triangles[t_total + j] = t[j];
-        }
+    std::optional<py::gil_scoped_release> release;
+    release.emplace();
 
-        triangles_per_face[i] = f.num_triangles;
-        face_types[i] = f.face_type;
+    MeshBuffers buffers = tessellate_shape(shape, params, indicator);
 
-        v_total += 3 * f.num_vertices;
-        t_total += 3 * f.num_triangles;
-    }
-    if (compute_missing_normals)
-    {
-        timer.reset("Interpolating normals", 2);
+    release.reset();
 
-        for (int i = 0; i < 3 * num_vertices; i++)
-        {
-            normals[i] = 0.0;
-        }
+    MeshData result = wrap_mesh_buffers(std::move(buffers));
 
-        for (int i = 0; i < num_triangles; i++)
-        {
-            double c0_0 = (vertices[3 * triangles[3 * i + 0] + 0]);
-            double c0_1 = (vertices[3 * triangles[3 * i + 0] + 1]);
-            double c0_2 = (vertices[3 * triangles[3 * i + 0] + 2]);
-            double c1_0 = (vertices[3 * triangles[3 * i + 1] + 0]);
-            double c1_1 = (vertices[3 * triangles[3 * i + 1] + 1]);
-            double c1_2 = (vertices[3 * triangles[3 * i + 1] + 2]);
-            double c2_0 = (vertices[3 * triangles[3 * i + 2] + 0]);
-            double c2_1 = (vertices[3 * triangles[3 * i + 2] + 1]);
-            double c2_2 = (vertices[3 * triangles[3 * i + 2] + 2]);
-            // c2 - c1
-            double v1_0 = (c2_0 - c1_0);
-            double v1_1 = (c2_1 - c1_1);
-            double v1_2 = (c2_2 - c1_2);
-            // c0 - c1
-            double v2_0 = (c0_0 - c1_0);
-            double v2_1 = (c0_1 - c1_1);
-            double v2_2 = (c0_2 - c1_2);
-            // cross product of v1 and v2
-            double n_0 = (v1_1 * v2_2 - v1_2 * v2_1);
-            double n_1 = (v1_2 * v2_0 - v1_0 * v2_2);
-            double n_2 = (v1_0 * v2_1 - v1_1 * v2_0);
-            // interpolate vertex normal by blending all face normals of a vertex
-            for (int j = 0; j < 3; j++)
-            {
-                normals[3 * triangles[3 * i + j] + 0] += n_0;
-                normals[3 * triangles[3 * i + j] + 1] += n_1;
-                normals[3 * triangles[3 * i + j] + 2] += n_2;
-            }
-        }
-        // and normalize later
-        for (int i = 0; i < num_vertices; i++)
-        {
-            double norm = sqrt(normals[3 * i] * normals[3 * i] + normals[3 * i + 1] * normals[3 * i + 1] + normals[3 * i + 2] * normals[3 * i + 2]);
-            normals[3 * i] /= norm;
-            normals[3 * i + 1] /= norm;
-            normals[3 * i + 2] /= norm;
-        }
+    if (!output.is_none())
+    {
+        result.output_size = write_mesh_buffer(result, output);
+        logger.debug("output: bytes", result.output_size);
     }
 
-    auto segments = new double[6 * num_segments];
-    auto segments_per_edge = new int[num_edges];
+    if (!progress.is_none())
+        progress(1.0);
 
-    /*
-     * Collect segments
-     */
-    int e_total = 0;
+    overall.stop();
 
-    if (compute_missing_edges)
+    if (debug >= 2)
     {
-        timer.reset("Compute missing edges", 2);
+        const std::pair<const char *, const py::array *> arrays[] = {
+            {"vertices", &result.vertices},
+            {"normals", &result.normals},
+            {"triangles", &result.triangles},
+            {"vertex_offsets", &result.vertex_offsets},
+            {"index_offsets", &result.index_offsets},
+            {"triangles_per_face", &result.triangles_per_face},
+            {"face_types", &result.face_types},
+            {"segments", &result.segments},
+            {"segments_per_edge", &result.segments_per_edge},
+            {"edge_types", &result.edge_types},
+            {"obj_vertices", &result.obj_vertices},
+            {"face_bounds", &result.face_bounds},
+            {"edge_bounds", &result.edge_bounds},
+            {"bounds", &result.bounds},
+            {"edge_face_offsets", &result.edge_face_offsets},
+            {"edge_faces", &result.edge_faces},
+            {"face_edge_offsets", &result.face_edge_offsets},
+            {"face_edges", &result.face_edges},
+            {"vertex_faces", &result.vertex_faces},
+            {"face_normals", &result.face_normals},
+            {"flat_faces", &result.flat_faces},
+            {"normal_offsets", &result.normal_offsets},
+        };
+        for (const auto &[name, array] : arrays)
+            logger.debug(name, printable(*array), printable(array->dtype()));
+    }
+
+    return result;
+}
 
-        num_edges = num_triangles;
-        num_segments = 3 * num_triangles;
-        segments = new double[18 * num_edges];
-        segments_per_edge = new int[num_edges];
+/*
+ * Ray picking
+ */
 
-        for (int i = 0; i < num_triangles; i++)
-        {
-            double c0_0 = vertices[3 * triangles[3 * i + 0] + 0];
-            double c0_1 = vertices[3 * triangles[3 * i + 0] + 1];
-            double c0_2 = vertices[3 * triangles[3 * i + 0] + 2];
-            double c1_0 = vertices[3 * triangles[3 * i + 1] + 0];
-            double c1_1 = vertices[3 * triangles[3 * i + 1] + 1];
-            double c1_2 = vertices[3 * triangles[3 * i + 1] + 2];
-            double c2_0 = vertices[3 * triangles[3 * i + 2] + 0];
-            double c2_1 = vertices[3 * triangles[3 * i + 2] + 1];
-            double c2_2 = vertices[3 * triangles[3 * i + 2] + 2];
-            segments[e_total + 0] = c0_0;
-            segments[e_total + 1] = c0_1;
-            segments[e_total + 2] = c0_2;
-            segments[e_total + 3] = c1_0;
-            segments[e_total + 4] = c1_1;
-            segments[e_total + 5] = c1_2;
-            segments[e_total + 6] = c1_0;
-            segments[e_total + 7] = c1_1;
-            segments[e_total + 8] = c1_2;
-            segments[e_total + 9] = c2_0;
-            segments[e_total + 10] = c2_1;
-            segments[e_total + 11] = c2_2;
-            segments[e_total + 12] = c2_0;
-            segments[e_total + 13] = c2_1;
-            segments[e_total + 14] = c2_2;
-            segments[e_total + 15] = c0_0;
-            segments[e_total + 16] = c0_1;
-            segments[e_total + 17] = c0_2;
-            e_total += 18;
-            segments_per_edge[i] = 3;
-        }
+using RayArray = py::array_t<float, py::array::c_style | py::array::forcecast>;
+
+/**
+ * @brief Validate a batch of rays given as two (n, 3) float arrays and return n
+ */
+int check_rays(const RayArray &origins, const RayArray &directions)
+{
+    if (origins.ndim() != 2 || origins.shape(1) != 3 || directions.ndim() != 2 || directions.shape(1) != 3)
+    {
+        throw std::invalid_argument("origins and directions need to have the shape (n, 3)");
     }
-    else
+    if (origins.shape(0) != directions.shape(0))
     {
-        timer.reset("Collecting edges", 2);
-        for (int i = 0; i < num_edges; i++)
-        {
-            auto e = edge_list[i];
+        throw std::invalid_argument("origins and directions need to have the same length");
+    }
+    return static_cast<int>(origins.shape(0));
+}
+
+/**
+ * @brief Build a MeshBVH from the triangles and segments of a MeshData structure
+ */
+MeshBVH *create_mesh_bvh(const MeshData &mesh_data)
+{
+    const float *vertices = mesh_data.vertices.data();
+    const int *triangles_per_face = mesh_data.triangles_per_face.data();
+    const float *segments = mesh_data.segments.data();
+    const int *segments_per_edge = mesh_data.segments_per_edge.data();
 
-            for (int j = 0; j < 6 * e.num_segments; j++)
+    int num_vertices = static_cast<int>(mesh_data.vertices.size() / 3);
+    int num_faces = static_cast<int>(mesh_data.triangles_per_face.size());
+    int num_edges = static_cast<int>(mesh_data.segments_per_edge.size());
+
+    // the arrays are kept alive by mesh_data, so the build does not need the GIL
+    py::gil_scoped_release release;
+
+    const int *triangles = static_cast<const int *>(mesh_data.triangles.data());
+    std::vector<int> global_triangles;
+    if (mesh_data.local_indices)
+    {
+        const int *vertex_offsets = mesh_data.vertex_offsets.data();
+        const int *index_offsets = mesh_data.index_offsets.data();
+        bool is_uint16 = mesh_data.triangles.itemsize() == 2;
+        global_triangles.resize(mesh_data.triangles.size());
+        for (int i = 0; i < num_faces; i++)
+        {
+            for (int j = index_offsets[i]; j < index_offsets[i + 1]; j++)
             {
-                segments[e_total + j] = e.segments[j];
+                int local = is_uint16 ? static_cast<const uint16_t *>(mesh_data.triangles.data())[j]
+                                      : static_cast<int>(static_cast<const uint32_t *>(mesh_data.triangles.data())[j]);
+                global_triangles[j] = vertex_offsets[i] + local;
             }
-            segments_per_edge[i] = e.num_segments;
-            edge_types[i] = e.edge_type;
-
-            e_total += 6 * e.num_segments;
         }
+        triangles = global_triangles.data();
     }
 
-    timer.reset("Create MeshData", 2);
+    return new MeshBVH(vertices, num_vertices, triangles, triangles_per_face, num_faces,
+                       segments, segments_per_edge, num_edges);
+}
 
-    MeshData mesh_data;
+/**
+ * @brief Intersect a batch of rays with the faces of a MeshBVH
+ *
+ * @return Tuple of face indices (int32, -1 for a miss) and hit distances (float32, inf for a miss)
+ */
+py::tuple intersect_faces(const MeshBVH &bvh, const RayArray &origins, const RayArray &directions)
+{
+    int n = check_rays(origins, directions);
+    const float *o = origins.data();
+    const float *d = directions.data();
+    int *faces = new int[n];
+    float *distances = new float[n];
+    {
+        py::gil_scoped_release release;
+        OSD_Parallel::For(0, n, [&](int i)
+                          { faces[i] = bvh.intersect_face(&o[3 * i], &d[3 * i], distances[i]); },
+                          n < 64);
+    }
+    return py::make_tuple(wrap_numpy(faces, n), wrap_numpy(distances, n));
+}
 
-    timer.reset("Cast to float", 2);
+/**
+ * @brief Find the nearest edge within a tolerance for a batch of rays
+ *
+ * @return Tuple of edge indices (int32, -1 if no edge is close enough) and distances along the ray (float32)
+ */
+py::tuple nearest_edges(const MeshBVH &bvh, const RayArray &origins, const RayArray &directions,
+                        float tolerance, float tolerance_slope)
+{
+    int n = check_rays(origins, directions);
+    const float *o = origins.data();
+    const float *d = directions.data();
+    int *edges = new int[n];
+    float *distances = new float[n];
+    {
+        py::gil_scoped_release release;
+        OSD_Parallel::For(0, n, [&](int i)
+                          { edges[i] = bvh.nearest_edge(&o[3 * i], &d[3 * i], tolerance, tolerance_slope, distances[i]); },
+                          n < 64);
+    }
+    return py::make_tuple(wrap_numpy(edges, n), wrap_numpy(distances, n));
+}
 
-    float *vertices32 = convert_to_float(vertices, 3 * num_vertices);
-    float *normals32 = convert_to_float(normals, 3 * num_vertices);
-    float *obj_vertices32 = convert_to_float(obj_vertices, 3 * num_obj_vertices);
-    float *segments32 = convert_to_float(segments, 6 * num_segments);
+/**
+ * @brief Stream a tessellation of a shape into a STL or PLY file (see mesh_export.h)
+ *
+ * @param path str or os.PathLike
+ * @return Number of triangles written
+ */
+size_t export_mesh_file(py::object obj, py::object path, MeshFileFormat format, double deflection,
+                        double angular_tolerance, bool binary, bool parallel)
+{
+    const TopoDS_Shape &shape = *obj.cast<TopoDS_Shape *>();
+    std::string filename = py::str(py::module_::import("os").attr("fspath")(path));
 
-    timer.reset("Cast to numpy", 2);
+    py::gil_scoped_release release;
+    return tessellate_to_file(shape, filename, format, binary, deflection, angular_tolerance, parallel);
+}
 
-    // wrap_numpy use a capsule, so Python triggers deletion
-    mesh_data.vertices = wrap_numpy(vertices32, 3 * num_vertices);
-    mesh_data.normals = wrap_numpy(normals32, 3 * num_vertices);
-    mesh_data.triangles = wrap_numpy(triangles, 3 * num_triangles);
-    mesh_data.triangles_per_face = wrap_numpy(triangles_per_face, num_faces);
-    mesh_data.face_types = wrap_numpy(face_types, num_faces);
-    mesh_data.edge_types = wrap_numpy(edge_types, num_edges);
-    mesh_data.obj_vertices = wrap_numpy(obj_vertices32, 3 * num_obj_vertices);
-    mesh_data.segments = wrap_numpy(segments32, 6 * num_segments);
-    mesh_data.segments_per_edge = wrap_numpy(segments_per_edge, num_edges);
-
-    delete[] vertices;
-    delete[] obj_vertices;
-    delete[] normals;
-    delete[] segments;
-
-    timer.stop();
+/*
+ * Asynchronous tessellation
+ */
 
-    return mesh_data;
-}
+const int DEFAULT_POOL_WORKERS = 2;
+const int DEFAULT_POOL_QUEUE = 16;
 
 /**
- * @brief Tessellates a TopoDS_Shape into a mesh representation with vertices, triangles, and edges.
- *
- * This function performs mesh tessellation on an OpenCascade TopoDS_Shape object, generating
- * triangulated faces, edge segments, and vertex data. It uses BRepMesh_IncrementalMesh for
- * the underlying tessellation and supports parallel processing.
- *
- * @param shape The TopoDS_Shape object to tessellate
- * @param deflection Maximum allowed deviation between the original surface and the tessellated mesh
- * @param angular_tolerance Angular tolerance for tessellation in radians
- * @param compute_faces Whether to compute face triangulation data
- * @param compute_edges Whether to compute edge segment data
- * @param parallel Whether to enable parallel processing during tessellation
- * @param debug Debug level for logging (0 = no debug output)
- * @param timeit Whether to measure and report timing information
+ * @brief Calls def with the py::arg list of tessellate()
  *
- * @return MeshData structure containing:
- *         - vertices: Array of vertex coordinates (x,y,z)
- *         - normals: Array of vertex normals (if available)
- *         - triangles: Array of triangle indices
- *         - triangles_per_face: Number of triangles per face
- *         - face_types: Type classification for each face
- *         - segments: Array of edge segment coordinates
- *         - segments_per_edge: Number of segments per edge
- *         - edge_types: Type classification for each edge
- *         - obj_vertices: Original shape vertices
- *
- * @note The function handles orientation correction for reversed faces and computes normals
- *       when UV nodes are available in the triangulation. Edge processing requires face
- *       ancestors to be present.
- *
- * @warning Memory allocation is performed for face and edge data arrays. Proper cleanup
- *          should be handled by the MeshData structure or calling code.
+ * Shared by the bindings of tessellate(), TessellatorPool.submit() and tessellate_async(),
+ * so that their signatures and defaults stay in sync. The parameters after timeit are
+ * keyword-only, so that callers cannot shift them by position.
  */
-
-MeshData tessellate(py::object obj, double deflection, double angular_tolerance,
-                    bool compute_faces, bool compute_edges, bool parallel, int debug, bool timeit)
+template <typename Def>
+void with_tessellate_args(Def &&def)
 {
-    /*
-     * Tessellate mesh
-     */
+    def(py::arg("shape"),
+        py::arg("deflection"),
+        py::arg("angular_tolerance") = 0.3,
+        py::arg("compute_faces") = true,
+        py::arg("compute_edges") = true,
+        py::arg("parallel") = true,
+        py::arg("debug") = 0,
+        py::arg("timeit") = false,
+        py::kw_only(),
+        py::arg("local_indices") = false,
+        py::arg("progress") = py::none(),
+        py::arg("cancel_token") = nullptr,
+        py::arg("progress_interval") = 0.1,
+        py::arg("relative") = false,
+        py::arg("min_size") = 0.0,
+        py::arg("max_deflection") = 0.0,
+        py::arg("threads") = 0,
+        py::arg("output") = py::none(),
+        py::arg("optimize_order") = false,
+        py::arg("adjacency") = false,
+        py::arg("heal") = false,
+        py::arg("flat_normals") = false);
+}
 
-    auto *shape_ptr = obj.cast<TopoDS_Shape *>();
-    const TopoDS_Shape &shape = *shape_ptr;
+/**
+ * @struct TessellateJob
+ * @brief Keyword arguments of a queued tessellate() call and the future receiving its result
+ *
+ * Holds Python objects, so it must only be created and destroyed while holding the GIL.
+ */
+struct TessellateJob
+{
+    py::dict kwargs;
+    py::object future;
+};
 
-    Logger logger(debug);
-    Timer overall("Overall", 0, timeit);
-    Timer timer;
+// Python tessellate() function, set when the module is registered
+py::handle tessellate_function;
 
-    if (compute_edges || compute_faces)
-    {
-        logger.info("deflection", deflection, "angular_tolerance", angular_tolerance, "parallel", parallel);
-        timer.start("Computing BRep incremental mesh", 1, timeit);
+/**
+ * @brief Runs a queued tessellation on a worker thread and resolves its future
+ *
+ * Takes ownership of the job. The job calls the Python level tessellate() so that C++
+ * exceptions are translated exactly as for a direct call.
+ * tessellate() releases the GIL while meshing, so several jobs and the Python threads of
+ * the caller run concurrently.
+ */
+void run_tessellate_job(TessellateJob *job)
+{
+    py::gil_scoped_acquire acquire;
+    std::unique_ptr<TessellateJob> owner(job);
 
-        // https://dev.opencascade.org/node/81262#comment-21130
-        // BRepTools::Clean(shape);
-        BRepMesh_IncrementalMesh mesher(shape, deflection, Standard_False, angular_tolerance, parallel);
-        logger.debug("IsDone", mesher.IsDone());
-        logger.debug("GetStatusFlags", mesher.GetStatusFlags());
+    if (!job->future.attr("set_running_or_notify_cancel")().cast<bool>())
+        return; // cancelled while queued
 
-        timer.stop();
+    try
+    {
+        py::object result = tessellate_function(**job->kwargs);
+        job->future.attr("set_result")(result);
     }
-    TopLoc_Location loc;
-
-    int has_normals = false; // assumption: if one face has no normal, no faces has normals
-    int num_faces = 0;
-    FaceData *face_list;
-
-    int total_num_vertices = 0;
-    int total_num_triangles = 0;
-
-    if (compute_faces)
+    catch (py::error_already_set &e)
     {
-        timer.start("Computing tessellation", 1, timeit);
-
-        TopTools_IndexedMapOfShape face_map = TopTools_IndexedMapOfShape();
-        TopExp::MapShapes(shape, TopAbs_FACE, face_map);
-
-        num_faces = face_map.Extent();
-        face_list = new FaceData[num_faces];
+        job->future.attr("set_exception")(e.value());
+    }
+}
 
-        logger.debug("num_faces", num_faces);
+/**
+ * @class TessellatorPool
+ * @brief Native worker pool that runs tessellate() calls and returns concurrent.futures.Future objects
+ *
+ * The pool has a fixed number of worker threads and a bounded queue; submit() blocks (with
+ * the GIL released) while the queue is full. Asyncio code can await the returned futures
+ * with asyncio.wrap_future(). A shape must not be tessellated by two jobs at the same time,
+ * since OCCT stores the triangulation in the shape.
+ */
+class TessellatorPool
+{
+public:
+    TessellatorPool(int num_workers, int max_queue) : pool_(num_workers, max_queue) {}
 
-        try
-        {
-            long offset = -1;
+    ~TessellatorPool()
+    {
+        shutdown();
+    }
 
-            for (int i = 0; i < num_faces; i++)
-            {
-                const TopoDS_Face &topods_face = TopoDS::Face(face_map.FindKey(i + 1));
-
-                TopAbs_Orientation orient = topods_face.Orientation();
-                Handle(Poly_Triangulation) triangulation = BRep_Tool::Triangulation(topods_face, loc);
-
-                if (!triangulation.IsNull())
-                {
-                    const Standard_Integer num_nodes = triangulation->NbNodes();
-                    const Standard_Integer num_triangles = triangulation->NbTriangles();
-
-                    face_list[i].vertices = new Standard_Real[num_nodes * 3];
-                    face_list[i].normals = new Standard_Real[num_nodes * 3];
-                    face_list[i].triangles = new Standard_Integer[num_triangles * 3];
-
-                    BRepGProp_Face prop(topods_face);
-
-                    for (Standard_Integer j = 0; j < num_nodes; j++)
-                    {
-                        gp_Pnt point = triangulation->Node(j + 1).Transformed(loc).XYZ();
-                        face_list[i].vertices[3 * j] = point.X();
-                        face_list[i].vertices[3 * j + 1] = point.Y();
-                        face_list[i].vertices[3 * j + 2] = point.Z();
-
-                        logger.trace_xyz("vertex", point.X(), point.Y(), point.Z(), false);
-
-                        if (triangulation->HasUVNodes())
-                        {
-                            has_normals = true;
-                            const gp_Pnt2d &uv = triangulation->UVNode(j + 1);
-                            gp_Pnt point;
-                            gp_Vec normal;
-                            prop.Normal(uv.X(), uv.Y(), point, normal);
-                            if (normal.SquareMagnitude() > 0.0)
-                                normal.Normalize();
-                            if (topods_face.Orientation() == TopAbs_INTERNAL)
-                                normal.Reverse();
-
-                            face_list[i].normals[3 * j] = normal.X();
-                            face_list[i].normals[3 * j + 1] = normal.Y();
-                            face_list[i].normals[3 * j + 2] = normal.Z();
-
-                            logger.trace_xyz(" normal", normal.X(), normal.Y(), normal.Z(), false);
-                        }
-                    }
-
-                    for (Standard_Integer j = 0; j < num_triangles; j++)
-                    {
-                        Standard_Integer index0, index1, index2;
-                        triangulation->Triangle(j + 1).Get(index0, index1, index2);
-
-                        face_list[i].triangles[3 * j] = offset + index0;
-                        face_list[i].triangles[3 * j + 1] = offset + ((orient == TopAbs_REVERSED) ? index2 : index1);
-                        face_list[i].triangles[3 * j + 2] = offset + ((orient == TopAbs_REVERSED) ? index1 : index2);
-
-                        logger.trace_xyz("triangle ", offset + index0,
-                                         offset + ((orient == TopAbs_REVERSED) ? index2 : index1),
-                                         offset + ((orient == TopAbs_REVERSED) ? index1 : index2), false);
-                    }
-
-                    // triangle_count += num_triangles * 3;
-
-                    face_list[i].num_vertices = num_nodes;
-                    face_list[i].num_triangles = num_triangles;
-                    face_list[i].face_type = get_face_type(topods_face);
-
-                    offset += num_nodes;
-                    total_num_vertices += num_nodes;
-                    total_num_triangles += num_triangles;
-                }
-                else
-                {
-                    logger.info("=> warning: Triangulation is null for face ", i, "\n");
-
-                    face_list[i].vertices = nullptr;
-                    face_list[i].normals = nullptr;
-                    face_list[i].triangles = nullptr;
-                    face_list[i].num_vertices = 0;
-                    face_list[i].num_triangles = 0;
-                    face_list[i].face_type = -1;
-                }
-            }
-        }
-        catch (Standard_Failure &e)
+    /**
+     * @brief Queues a tessellate() call with the given arguments and returns its future
+     *
+     * Takes the parameters of tessellate(), see tessellator.h.
+     */
+    py::object submit(py::object shape, double deflection, double angular_tolerance,
+                      bool compute_faces, bool compute_edges, bool parallel, int debug, bool timeit,
+                      bool local_indices, py::object progress, const CancelToken *cancel_token,
+                      double progress_interval, bool relative, double min_size, double max_deflection,
+                      int threads, py::object output, bool optimize_order, bool adjacency, bool heal,
+                      bool flat_normals)
+    {
+        py::dict kwargs(py::arg("shape") = shape,
+                        py::arg("deflection") = deflection,
+                        py::arg("angular_tolerance") = angular_tolerance,
+                        py::arg("compute_faces") = compute_faces,
+                        py::arg("compute_edges") = compute_edges,
+                        py::arg("parallel") = parallel,
+                        py::arg("debug") = debug,
+                        py::arg("timeit") = timeit,
+                        py::arg("local_indices") = local_indices,
+                        py::arg("progress") = progress,
+                        // the token is owned by its Python object
+                        py::arg("cancel_token") = py::cast(cancel_token, py::return_value_policy::reference),
+                        py::arg("progress_interval") = progress_interval,
+                        py::arg("relative") = relative,
+                        py::arg("min_size") = min_size,
+                        py::arg("max_deflection") = max_deflection,
+                        py::arg("threads") = threads,
+                        py::arg("output") = output,
+                        py::arg("optimize_order") = optimize_order,
+                        py::arg("adjacency") = adjacency,
+                        py::arg("heal") = heal,
+                        py::arg("flat_normals") = flat_normals);
+
+        py::object future = py::module_::import("concurrent.futures").attr("Future")();
+        auto *job = new TessellateJob{kwargs, future};
+        bool queued;
         {
-            py::print("Error:", e.GetMessageString(), "\n");
+            py::gil_scoped_release release;
+            queued = pool_.submit([job]()
+                                  { run_tessellate_job(job); });
         }
-        catch (...)
+        if (!queued)
         {
-            py::print("Error: unknown\n");
+            delete job;
+            throw std::runtime_error("TessellatorPool has been shut down");
         }
-
-        timer.stop();
+        return future;
     }
 
-    /*
-     * Compute edges
+    /**
+     * @brief Runs all queued jobs and stops the workers (the GIL is released while waiting)
      */
-
-    int num_edges = 0;
-
-    int total_num_segments = 0;
-    EdgeData *edge_list = new EdgeData[num_edges];
-
-    if (compute_edges)
+    void shutdown()
     {
-        timer.start("Computing edges", 1, timeit);
-
-        TopTools_IndexedMapOfShape edge_map = TopTools_IndexedMapOfShape();
-        TopTools_IndexedDataMapOfShapeListOfShape ancestor_map = TopTools_IndexedDataMapOfShapeListOfShape();
-
-        TopExp::MapShapes(shape, TopAbs_EDGE, edge_map);
-        TopExp::MapShapesAndAncestors(shape, TopAbs_EDGE, TopAbs_FACE, ancestor_map);
-
-        num_edges = edge_map.Extent();
-        edge_list = new EdgeData[num_edges];
-
-        // int edges_offset = 0;
-        for (int i = 0; i < num_edges; i++)
-        {
-            const TopTools_ListOfShape &face_list = ancestor_map.FindFromIndex(i + 1);
-
-            if (face_list.Extent() > 0)
-            {
-
-                const TopoDS_Face &topods_face = TopoDS::Face(face_list.First());
-                const TopoDS_Edge &topods_edge = TopoDS::Edge(edge_map(i + 1));
-
-                TopLoc_Location loc = TopLoc_Location();
-
-                Handle(Poly_Triangulation) triangulation = BRep_Tool::Triangulation(topods_face, loc);
-                Handle(Poly_PolygonOnTriangulation) poly = BRep_Tool::PolygonOnTriangulation(topods_edge, triangulation, loc);
-
-                if (!poly.IsNull())
-                {
-                    int num_nodes = poly->NbNodes();
-
-                    edge_list[i].segments = new Standard_Real[6 * (num_nodes - 1)];
-
-                    for (int j = 0; j < num_nodes - 1; j++)
-                    {
-                        gp_Pnt p1 = triangulation->Node(poly->Node(j + 1)).Transformed(loc).Coord();
-                        gp_Pnt p2 = triangulation->Node(poly->Node(j + 2)).Transformed(loc).Coord();
-                        edge_list[i].segments[j * 6 + 0] = p1.X();
-                        edge_list[i].segments[j * 6 + 1] = p1.Y();
-                        edge_list[i].segments[j * 6 + 2] = p1.Z();
-                        edge_list[i].segments[j * 6 + 3] = p2.X();
-                        edge_list[i].segments[j * 6 + 4] = p2.Y();
-                        edge_list[i].segments[j * 6 + 5] = p2.Z();
-                    }
-
-                    total_num_segments += (num_nodes - 1);
-                    edge_list[i].num_segments = num_nodes - 1;
-                    edge_list[i].edge_type = get_edge_type(topods_edge);
-                }
-                else
-                {
-                    logger.debug("=> warning: no face polygon for egde ", i);
-                    edge_list[i].segments = nullptr;
-                    edge_list[i].num_segments = 0;
-                    edge_list[i].edge_type = -1;
-                }
-            }
-            else
-            {
-                logger.debug("=> warning: no face ancestors for egde ", i);
-                edge_list[i].segments = nullptr;
-                edge_list[i].num_segments = 0;
-                edge_list[i].edge_type = -1;
-            }
-        }
-        timer.stop();
+        py::gil_scoped_release release;
+        pool_.shutdown();
     }
 
-    /*
-     * Collect vertices
-     */
-
-    timer.start("Computing vertices", 1, timeit);
-
-    TopTools_IndexedMapOfShape vertex_map = TopTools_IndexedMapOfShape();
-    TopExp::MapShapes(shape, TopAbs_VERTEX, vertex_map);
+    int num_workers() const { return pool_.num_workers(); }
+    int max_queue() const { return pool_.max_queue(); }
+    int pending() const { return static_cast<int>(pool_.pending()); }
 
-    int num_vertices = vertex_map.Extent();
+private:
+    WorkerPool pool_;
+};
 
-    double *vertex_list = new double[3 * num_vertices];
-    for (int i = 0; i < num_vertices; i++)
+/**
+ * @brief Replaces the default pool of tessellate_async(), waiting for the jobs of the old one
+ */
+void configure_pool(py::module_ &m, int num_workers, int max_queue)
+{
+    if (py::hasattr(m, "_default_pool") && !m.attr("_default_pool").is_none())
     {
-        const TopoDS_Vertex &topods_vertex = TopoDS::Vertex(vertex_map.FindKey(i + 1));
-        gp_Pnt p = BRep_Tool::Pnt(topods_vertex);
-        vertex_list[3 * i + 0] = p.X();
-        vertex_list[3 * i + 1] = p.Y();
-        vertex_list[3 * i + 2] = p.Z();
+        m.attr("_default_pool").cast<TessellatorPool &>().shutdown();
     }
+    m.attr("_default_pool") = py::cast(new TessellatorPool(num_workers, max_queue), py::return_value_policy::take_ownership);
+}
 
-    timer.reset("Collecting mesh data", 1);
-
-    // Return the struct
-    auto result = collect_mesh_data(
-        face_list,
-        total_num_vertices,
-        total_num_triangles,
-        num_faces,
-        edge_list,
-        total_num_segments,
-        num_edges,
-        vertex_list,
-        num_vertices,
-        !has_normals,                             // interpolate normals
-        compute_edges ? (num_edges == 0) : false, // calculate all triangles edges
-        timeit);
-
-    timer.stop();
-    overall.stop();
-
-    logger.debug("vertices", result.vertices, result.vertices.dtype());
-    logger.debug("normals", result.normals, result.normals.dtype());
-    logger.debug("triangles", result.triangles, result.triangles.dtype());
-    logger.debug("triangles_per_face", result.triangles_per_face, result.triangles_per_face.dtype());
-    logger.debug("face_types", result.face_types, result.face_types.dtype());
-    logger.debug("segments", result.segments, result.segments.dtype());
-    logger.debug("segments_per_edge", result.segments_per_edge, result.segments_per_edge.dtype());
-    logger.debug("edge_types", result.edge_types, result.edge_types.dtype());
-    logger.debug("obj_vertices", result.obj_vertices, result.obj_vertices.dtype());
-
-    return result;
+/**
+ * @brief Returns the default pool of tessellate_async(), creating it on first use
+ */
+TessellatorPool &default_pool(py::module_ &m)
+{
+    if (!py::hasattr(m, "_default_pool") || m.attr("_default_pool").is_none())
+    {
+        configure_pool(m, DEFAULT_POOL_WORKERS, DEFAULT_POOL_QUEUE);
+    }
+    return m.attr("_default_pool").cast<TessellatorPool &>();
 }
 
 /**
@@ -582,27 +533,119 @@ MeshData tessellate(py::object obj, double deflection, double angular_tolerance,
  * - vertices: Vertex coordinates
  * - normals: Normal vectors
  * - triangles: Triangle indices
+ * - local_indices: Whether triangle indices are local to each face
+ * - vertex_offsets: First vertex of each face
+ * - index_offsets: First triangle index of each face
  * - face_types: Types of faces
  * - triangles_per_face: Number of triangles per face
  * - segments: Line segments
  * - segments_per_edge: Number of segments per edge
  * - edge_types: Types of edges
  * - obj_vertices: Object vertices
+ * - face_bounds: Bounding box per face
+ * - edge_bounds: Bounding box per edge
+ * - bounds: Bounding box of the whole shape
+ * - edge_faces, face_edges (CSR with their offsets) and vertex_faces: adjacency (optional)
+ * - face_normals, flat_faces and normal_offsets: compact normals of planar faces (optional)
+ *
+ * The MeshBVH class provides batched ray picking against faces and edges of a MeshData object.
+ *
+ * CancelToken and the TessellationCancelled exception support cancelling running tessellations.
+ *
+ * tessellate_async() queues tessellate() calls on a TessellatorPool (a module wide default pool
+ * configured with configure_pool(), or an explicit one) and returns a concurrent.futures.Future.
  */
 void register_tessellator(pybind11::module_ &m_gbl)
 {
     auto m = m_gbl.def_submodule("tessellator");
 
+    // the core logs through Python, so that its output interleaves with Python prints
+    set_log_sink([](const std::string &line)
+                 {
+        py::gil_scoped_acquire acquire;
+        py::print(line); });
+
+    // pickle looks up classes by module name
+    py::module_::import("sys").attr("modules")[m.attr("__name__")] = m;
+
+    // with TBB, OSD_Parallel (and hence BRepMesh) would not use the OCCT pool, whose size
+    // threads, configure_threads() and mesh_threads refer to
+    OSD_Parallel::SetUseOcctThreads(Standard_True);
+
     py::class_<MeshData>(m, "MeshData")
+        .def(py::init<>())
         .def_readonly("vertices", &MeshData::vertices)
         .def_readonly("normals", &MeshData::normals)
         .def_readonly("triangles", &MeshData::triangles)
+        .def_readonly("local_indices", &MeshData::local_indices)
+        .def_readonly("vertex_offsets", &MeshData::vertex_offsets)
+        .def_readonly("index_offsets", &MeshData::index_offsets)
         .def_readonly("face_types", &MeshData::face_types)
         .def_readonly("triangles_per_face", &MeshData::triangles_per_face)
         .def_readonly("segments", &MeshData::segments)
         .def_readonly("segments_per_edge", &MeshData::segments_per_edge)
         .def_readonly("edge_types", &MeshData::edge_types)
-        .def_readonly("obj_vertices", &MeshData::obj_vertices);
+        .def_readonly("obj_vertices", &MeshData::obj_vertices)
+        .def_readonly("face_bounds", &MeshData::face_bounds)
+        .def_readonly("edge_bounds", &MeshData::edge_bounds)
+        .def_readonly("bounds", &MeshData::bounds)
+        .def_readonly("mesh_threads", &MeshData::mesh_threads)
+        .def_readonly("extraction_threads", &MeshData::extraction_threads)
+        .def_readonly("output_size", &MeshData::output_size)
+        .def_readonly("edge_face_offsets", &MeshData::edge_face_offsets)
+        .def_readonly("edge_faces", &MeshData::edge_faces)
+        .def_readonly("face_edge_offsets", &MeshData::face_edge_offsets)
+        .def_readonly("face_edges", &MeshData::face_edges)
+        .def_readonly("vertex_faces", &MeshData::vertex_faces)
+        .def_readonly("face_normals", &MeshData::face_normals)
+        .def_readonly("flat_faces", &MeshData::flat_faces)
+        .def_readonly("normal_offsets", &MeshData::normal_offsets)
+        .def("pack", &pack_mesh_data,
+             R"pbdoc(
+             Pack all arrays into one contiguous, aligned and versioned buffer (uint8 array)
+
+             The layout is the one of tessellate(output=...); MeshData.unpack() and
+             load_mesh_buffer() read it without copying.
+             )pbdoc")
+        .def_static("unpack", &unpack_mesh_data, py::arg("buffer"),
+                    R"pbdoc(
+                    Create a MeshData whose arrays are views into a packed buffer
+
+                    The buffer (or shared memory segment name) stays alive as long as the arrays.
+                    )pbdoc")
+        .def("__reduce_ex__", [](const MeshData &self, int protocol)
+             { return py::make_tuple(py::type::of<MeshData>(), py::tuple(), mesh_data_state(self, protocol)); })
+        .def("__setstate__", &set_mesh_data_state);
+
+    py::class_<MeshBVH>(m, "MeshBVH")
+        .def(py::init(&create_mesh_bvh), py::arg("mesh_data"))
+        .def_property_readonly("num_triangles", &MeshBVH::num_triangles)
+        .def_property_readonly("num_segments", &MeshBVH::num_segments)
+        .def("intersect_faces", &intersect_faces,
+             py::arg("origins"), py::arg("directions"),
+             R"pbdoc(
+             Intersect rays with the faces
+
+             origins and directions are (n, 3) arrays. Returns the face index (-1 for a miss)
+             and the hit distance along the ray for each ray.
+             )pbdoc")
+        .def("nearest_edges", &nearest_edges,
+             py::arg("origins"), py::arg("directions"), py::arg("tolerance"), py::arg("tolerance_slope") = 0.0f,
+             R"pbdoc(
+             Find the nearest edge for each ray
+
+             An edge is accepted if its distance to the ray is below tolerance + tolerance_slope * t,
+             with t the distance along the ray (use tolerance_slope = pixel size / focal length for
+             perspective cameras). Returns the edge index (-1 if none) and t for each ray.
+             )pbdoc");
+
+    py::class_<CancelToken>(m, "CancelToken")
+        .def(py::init<>())
+        .def("cancel", &CancelToken::cancel)
+        .def("reset", &CancelToken::reset)
+        .def_property_readonly("cancelled", &CancelToken::cancelled);
+
+    py::register_exception<TessellationCancelled>(m, "TessellationCancelled");
 
     m.doc() = R"pbdoc(
         OCP Tessellator
@@ -614,20 +657,310 @@ void register_tessellator(pybind11::module_ &m_gbl)
            :toctree: _generate
     )pbdoc";
 
+    with_tessellate_args([&](auto... args)
+                         { m.def("tessellate", &tessellate, args..., R"pbdoc(
+        Tessellate a shape
+
+        Tessellate OCP object with a native function via pybind11 and arrow
+
+        progress(fraction) is called at most every progress_interval seconds. Cancelling
+        cancel_token (a CancelToken) from another thread stops the tessellation and raises
+        TessellationCancelled.
+
+        With relative=True, deflection is a factor that is scaled per edge and face by its size,
+        limited by max_deflection (absolute). min_size is the minimum length of mesh elements
+        and edge segments, not a deflection.
+
+        threads caps the number of threads extracting faces and edges (0 = size of the thread
+        pool, see configure_threads()); threads=1 also meshes serially. The effective values are
+        reported as mesh_threads and extraction_threads of the result.
+
+        Edges without faces (wires, sketches) or without polygon on a triangulation are
+        discretized from the Polygon3D of the mesher or by sampling their curve with deflection
+        and angular_tolerance.
+
+        output (a shared memory segment name to create, or a writable buffer) additionally
+        receives all arrays in one contiguous buffer, see load_mesh_buffer(). The number of
+        bytes written is returned as output_size.
+
+        optimize_order=True reorders the triangles of each face for GPU vertex cache reuse
+        (Forsyth) and the vertices of each face in order of first use. Faces keep their
+        triangle and vertex ranges.
+
+        adjacency=True additionally returns edge_face_offsets/edge_faces (faces of each edge)
+        and face_edge_offsets/face_edges (edges of each face) in CSR layout, both built from
+        the edge ancestors already mapped for the edges (needs compute_edges), and
+        vertex_faces, the int32 face index of every vertex for ID buffer picking. A shape
+        without topological edges gets one edge per triangle, bounding only that face.
+        adjacency=True without compute_faces raises a ValueError, the face indices would refer
+        to faces that are not returned.
+
+        heal=True recovers faces the mesher could not triangulate: a copy of each such face is
+        healed (ShapeFix_Face, ShapeFix_Edge) and re-meshed with doubled deflection and angle,
+        in parallel, and merged back in. The rest of the shape is not touched, there is no
+        ShapeFix_Shape pass. Faces that still fail stay empty.
+
+        flat_normals=True stores the normal of every planar face once in face_normals
+        (flat_faces flags these faces) and keeps per vertex normals only for curved faces:
+        the normals of face i are normals[3 * normal_offsets[i]:3 * normal_offsets[i + 1]].
+        simplify() and MeshState need per vertex normals.
+        )pbdoc"); });
+
+    m.def(
+        "mesh_buffer_size",
+        &mesh_buffer_size,
+        py::arg("mesh"),
+        "Number of bytes needed to write a MeshData as mesh buffer");
+
+    m.def(
+        "load_mesh_buffer",
+        &load_mesh_buffer,
+        py::arg("source"),
+        R"pbdoc(
+        Map a mesh buffer written by tessellate(output=...) without copying
+
+        source is a shared memory segment name or a buffer (e.g. SharedMemory.buf). Returns a
+        dict of numpy views keyed by the MeshData field names, plus local_indices. The segment
+        stays mapped while a view is alive; unlinking it is up to the caller.
+        )pbdoc");
+
+    m.def(
+        "configure_threads",
+        &configure_threads,
+        py::arg("num_threads") = -1,
+        R"pbdoc(
+        Resize the OCCT thread pool used for meshing and extraction
+
+        num_threads=-1 uses the number of logical processors. Returns the pool size. Raises
+        RuntimeError while a tessellation is running.
+        )pbdoc");
+
+    m.def(
+        "thread_count",
+        []()
+        { return OSD_ThreadPool::DefaultPool()->NbThreads(); },
+        "Size of the OCCT thread pool used for meshing and extraction");
+
+    tessellate_function = m.attr("tessellate");
+
+    py::class_<ShardWorker> shard_worker(m, "ShardWorker", "Entry point of the worker processes of tessellate_sharded()");
+    shard_worker.attr("run") = py::reinterpret_steal<py::object>(PyClassMethod_New(py::cpp_function(&run_shard, py::name("run")).ptr()));
+
     m.def(
-        "tessellate",
-        &tessellate,
+        "tessellate_sharded",
+        &tessellate_sharded,
         py::arg("shape"),
         py::arg("deflection"),
         py::arg("angular_tolerance") = 0.3,
         py::arg("compute_faces") = true,
         py::arg("compute_edges") = true,
+        py::arg("local_indices") = false,
+        py::arg("shard_by") = "solid",
+        py::arg("faces_per_shard") = 0,
+        py::arg("processes") = 0,
+        py::arg("executor") = py::none(),
+        R"pbdoc(
+        Tessellate a large compound in shards in worker processes
+
+        The faces are split into shards (shard_by="solid" packs whole solids, "faces" splits
+        the faces into groups) of about faces_per_shard faces (0 = num_faces / (4 * processes)).
+        Every shard is serialized and tessellated by tessellate() in a ProcessPoolExecutor with
+        processes spawned workers (0 = os.cpu_count()), or in executor if given. Forked workers
+        can deadlock on the thread pools inherited from the parent, so a process executor
+        should use the "spawn" or "forkserver" start method. The results are merged into one
+        MeshData in the face and edge order of tessellate(shape).
+
+        Further keyword arguments are passed to tessellate() in the workers (parallel defaults
+        to False). If a worker process dies, the lost shards are bisected and retried in fresh
+        process pools until the crashing shard is found; faces and edges of shards that fail
+        stay empty and a RuntimeWarning names them.
+
+        Shards are meshed independently: edges shared between shards (only with
+        shard_by="faces") can be discretized differently on both sides.
+        )pbdoc");
+
+    py::class_<MeshDelta>(m, "MeshDelta")
+        .def_readonly("face_remap", &MeshDelta::face_remap)
+        .def_readonly("added_faces", &MeshDelta::added_faces)
+        .def_readonly("changed_faces", &MeshDelta::changed_faces)
+        .def_readonly("removed_faces", &MeshDelta::removed_faces)
+        .def_readonly("faces", &MeshDelta::faces)
+        .def_readonly("vertices", &MeshDelta::vertices)
+        .def_readonly("normals", &MeshDelta::normals)
+        .def_readonly("triangles", &MeshDelta::triangles)
+        .def_readonly("vertex_offsets", &MeshDelta::vertex_offsets)
+        .def_readonly("index_offsets", &MeshDelta::index_offsets)
+        .def_readonly("face_types", &MeshDelta::face_types)
+        .def_readonly("edge_remap", &MeshDelta::edge_remap)
+        .def_readonly("added_edges", &MeshDelta::added_edges)
+        .def_readonly("changed_edges", &MeshDelta::changed_edges)
+        .def_readonly("removed_edges", &MeshDelta::removed_edges)
+        .def_readonly("edges", &MeshDelta::edges)
+        .def_readonly("segments", &MeshDelta::segments)
+        .def_readonly("segments_per_edge", &MeshDelta::segments_per_edge)
+        .def_readonly("edge_types", &MeshDelta::edge_types);
+
+    py::class_<Meshlets>(m, "Meshlets")
+        .def_readonly("vertex_indices", &Meshlets::vertex_indices)
+        .def_readonly("vertex_offsets", &Meshlets::vertex_offsets)
+        .def_readonly("triangles", &Meshlets::triangles)
+        .def_readonly("index_offsets", &Meshlets::index_offsets)
+        .def_readonly("faces", &Meshlets::faces)
+        .def_readonly("spheres", &Meshlets::spheres)
+        .def_readonly("cones", &Meshlets::cones)
+        .def_property_readonly("num_meshlets", [](const Meshlets &self)
+                               { return self.faces.size(); });
+
+    m.def(
+        "build_meshlets",
+        &build_meshlets,
+        py::arg("mesh"),
+        py::arg("max_vertices") = 64,
+        py::arg("max_triangles") = 124,
+        R"pbdoc(
+        Split every face of a tessellation into meshlets of bounded size
+
+        Each meshlet has at most max_vertices vertices (up to 65536) and max_triangles
+        triangles, uint16 triangle indices into its vertex_indices (indices into mesh.vertices),
+        its source face, a bounding sphere (center, radius) and a normal cone (axis, cutoff) for
+        culling: it faces away from a camera at c if
+        dot(center - c, axis) >= cutoff * |center - c| + radius.
+
+        Triangles are taken in face order, use tessellate(optimize_order=True) for compact
+        meshlets. Use large limits (e.g. 65536 and 1 << 20) to get WebGL draw chunks.
+        )pbdoc");
+
+    m.def(
+        "simplify",
+        &simplify_mesh,
+        py::arg("mesh"),
+        py::arg("ratio") = 0.5,
+        py::arg("max_error") = 0.0,
+        py::arg("feature_angle") = 0.7854,
+        R"pbdoc(
+        Simplify every face of a tessellation with quadric error edge collapses (coarse LODs)
+
+        A face stops at ratio times its triangle count or when every remaining collapse would
+        move a vertex further than max_error from an original triangle plane (0 = no limit). Face boundaries and edges whose
+        dihedral angle exceeds feature_angle (radians) are kept, so faces stay watertight and
+        match the edge segments. Kept vertices keep their positions and normals.
+
+        Faces are simplified in parallel without the GIL. Returns a new MeshData with the same
+        faces, edges and index mode; face_bounds are recomputed.
+        )pbdoc");
+
+    m.def(
+        "tessellate_to_stl",
+        [](py::object shape, py::object path, double deflection, double angular_tolerance, bool binary, bool parallel)
+        { return export_mesh_file(shape, path, MeshFileFormat::STL, deflection, angular_tolerance, binary, parallel); },
+        py::arg("shape"),
+        py::arg("path"),
+        py::arg("deflection"),
+        py::arg("angular_tolerance") = 0.3,
+        py::arg("binary") = true,
         py::arg("parallel") = true,
-        py::arg("debug") = 0,
-        py::arg("timeit") = false,
         R"pbdoc(
-        Tessellate a shape
+        Tessellate a shape and write it as binary or ASCII STL file
 
-        Tessellate OCP object with a native function via pybind11 and arrow
+        Faces are extracted in small batches and streamed through a buffered writer with the
+        GIL released, so memory stays flat for large shapes. Every triangle gets its facet
+        normal. Returns the number of triangles written.
         )pbdoc");
+
+    m.def(
+        "tessellate_to_ply",
+        [](py::object shape, py::object path, double deflection, double angular_tolerance, bool binary, bool parallel)
+        { return export_mesh_file(shape, path, MeshFileFormat::PLY, deflection, angular_tolerance, binary, parallel); },
+        py::arg("shape"),
+        py::arg("path"),
+        py::arg("deflection"),
+        py::arg("angular_tolerance") = 0.3,
+        py::arg("binary") = true,
+        py::arg("parallel") = true,
+        R"pbdoc(
+        Tessellate a shape and write it as binary (little endian) or ASCII PLY file
+
+        Vertices (float x, y, z, nx, ny, nz) are shared within a face like in tessellate(),
+        triangles use global int indices. Streams like tessellate_to_stl(); the triangles are
+        spooled to a temporary file until all vertices are written. Returns the number of
+        triangles written.
+        )pbdoc");
+
+    py::class_<MeshState>(m, "MeshState")
+        .def(py::init<>())
+        .def("update", &MeshState::update, py::arg("shape"), py::arg("mesh"),
+             R"pbdoc(
+             Compare a new tessellation of an edited shape with the held one and hold the new one
+
+             Faces and edges are matched by TShape identity and location and compared by a
+             content hash of their arrays. Returns a MeshDelta with the added, changed and
+             removed faces and edges, the arrays of added and changed ones (face local
+             triangle indices) and the remapping of new to old indices.
+             )pbdoc")
+        .def("reset", &MeshState::reset, py::call_guard<py::gil_scoped_release>())
+        .def_property_readonly("num_faces", py::cpp_function(&MeshState::num_faces, py::call_guard<py::gil_scoped_release>()))
+        .def_property_readonly("num_edges", py::cpp_function(&MeshState::num_edges, py::call_guard<py::gil_scoped_release>()));
+
+    py::class_<TessellatorPool> pool_class(m, "TessellatorPool");
+    pool_class
+        .def(py::init<int, int>(),
+             py::arg("num_workers") = DEFAULT_POOL_WORKERS,
+             py::arg("max_queue") = DEFAULT_POOL_QUEUE)
+        .def("shutdown", &TessellatorPool::shutdown)
+        .def_property_readonly("num_workers", &TessellatorPool::num_workers)
+        .def_property_readonly("max_queue", &TessellatorPool::max_queue)
+        .def_property_readonly("pending", &TessellatorPool::pending);
+
+    with_tessellate_args([&](auto... args)
+                         { pool_class.def("submit", &TessellatorPool::submit, args..., R"pbdoc(
+             Queue a tessellate() call and return a concurrent.futures.Future resolving to MeshData
+
+             Takes the same arguments as tessellate().
+             )pbdoc"); });
+
+    m.attr("_default_pool") = py::none();
+
+    m.def(
+        "configure_pool",
+        [m](int num_workers, int max_queue) mutable
+        { configure_pool(m, num_workers, max_queue); },
+        py::arg("num_workers") = DEFAULT_POOL_WORKERS,
+        py::arg("max_queue") = DEFAULT_POOL_QUEUE,
+        R"pbdoc(
+        Configure the default pool used by tessellate_async()
+
+        Waits for the jobs queued on the previous default pool.
+        )pbdoc");
+
+    auto tessellate_async = [m](py::object shape, double deflection, double angular_tolerance,
+                                bool compute_faces, bool compute_edges, bool parallel, int debug, bool timeit,
+                                bool local_indices, py::object progress, const CancelToken *cancel_token,
+                                double progress_interval, bool relative, double min_size, double max_deflection,
+                                int threads, py::object output, bool optimize_order, bool adjacency, bool heal,
+                                bool flat_normals, TessellatorPool *pool) mutable
+    {
+        TessellatorPool &p = pool == nullptr ? default_pool(m) : *pool;
+        return p.submit(shape, deflection, angular_tolerance, compute_faces, compute_edges, parallel, debug, timeit,
+                        local_indices, progress, cancel_token, progress_interval, relative, min_size,
+                        max_deflection, threads, output, optimize_order, adjacency, heal, flat_normals);
+    };
+
+    with_tessellate_args([&](auto... args)
+                         { m.def("tessellate_async", tessellate_async, args..., py::arg("pool") = nullptr, R"pbdoc(
+        Tessellate a shape asynchronously
+
+        Takes the same arguments as tessellate() plus an optional pool (TessellatorPool, the
+        default pool if None). Queues the tessellation on the native worker pool and returns a
+        concurrent.futures.Future resolving to MeshData (use asyncio.wrap_future() to await it).
+        )pbdoc"); });
+
+    // finish queued jobs before the interpreter shuts down
+    py::module_::import("atexit").attr("register")(py::cpp_function(
+        [m]() mutable
+        {
+            if (!m.attr("_default_pool").is_none())
+            {
+                m.attr("_default_pool").cast<TessellatorPool &>().shutdown();
+            }
+        }));
 }
@@ -1,3 +1,5 @@
+#pragma once
+
 /**
  * @file tessellator.h
  * @brief Tessellation utilities for converting OpenCASCADE shapes to mesh data for rendering
@@ -6,81 +8,18 @@
  * mesh representations suitable for visualization in web-based renderers like Three.js.
  * The tessellation process converts BREP (Boundary Representation) geometry into
  * triangulated meshes and polyline segments.
+ *
+ * The tessellation itself is Python-free (see mesh_core.h); this header holds the pybind11
+ * layer that hands its buffers over to numpy without copying.
  */
 
-#include <BinTools.hxx>
-#include <BRep_Builder.hxx>
-#include <BRepAdaptor_Curve.hxx>
-#include <BRepAdaptor_Surface.hxx>
-#include <BRepCheck_Analyzer.hxx>
-#include <BRepCheck_Analyzer.hxx>
-#include <BRepCheck_Result.hxx>
-#include <BRepGProp_Face.hxx>
-#include <BRepMesh_IncrementalMesh.hxx>
-#include <BRepTools.hxx>
-#include <IMeshTools_Parameters.hxx>
-#include <Poly_PolygonOnTriangulation.hxx>
-#include <Poly_Triangulation.hxx>
-#include <ShapeFix_Shape.hxx>
-#include <ShapeFix_Face.hxx>
-#include <ShapeFix_Edge.hxx>
-#include <TopAbs_ShapeEnum.hxx>
-#include <TopExp_Explorer.hxx>
-#include <TopExp_Explorer.hxx>
-#include <TopExp.hxx>
-#include <TopoDS_Edge.hxx>
-#include <TopoDS_Face.hxx>
-#include <TopoDS_Shape.hxx>
-#include <TopoDS_Vertex.hxx>
-#include <TopoDS.hxx>
-#include <TopTools_IndexedMapOfShape.hxx>
-
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
 
-namespace py = pybind11;
-
-/**
- * @struct FaceData
- * @brief Container for tessellated face geometry data
- *
- * Holds the raw geometric data for a single tessellated face including
- * vertex coordinates, surface normals, triangle indices, and face classification.
- *
- * @var vertices Pointer to array of vertex coordinates (x,y,z triplets)
- * @var normals Pointer to array of normal vectors (nx,ny,nz triplets)
- * @var triangles Pointer to array of triangle vertex indices
- * @var num_vertices Total number of vertices in the face
- * @var num_triangles Total number of triangles in the face
- * @var face_type Classification type of the face geometry
- */
-struct FaceData
-{
-    Standard_Real *vertices;
-    Standard_Real *normals;
-    Standard_Integer *triangles;
-    Standard_Integer num_vertices;
-    Standard_Integer num_triangles;
-    Standard_Integer face_type;
-};
-
-/**
- * @struct EdgeData
- * @brief Container for tessellated edge geometry data
- *
- * Holds the geometric data for a single tessellated edge as line segments.
- *
- * @var segments Pointer to array of line segment endpoints
- * @var num_segments Total number of line segments in the edge
- * @var edge_type Classification type of the edge geometry
- */
+#include "mesh_core.h"
+#include "progress.h"
 
-struct EdgeData
-{
-    Standard_Real *segments;
-    Standard_Integer num_segments;
-    Standard_Integer edge_type;
-};
+namespace py = pybind11;
 
 /**
  * @struct MeshData
@@ -92,28 +31,91 @@ struct EdgeData
  *
  * @var vertices Combined vertex coordinates for all faces
  * @var normals Combined normal vectors for all faces
- * @var triangles Combined triangle indices for all faces
+ * @var triangles Combined triangle indices for all faces, global int32 indices or, with
+ *      local_indices, indices local to each face as uint16 (all faces have fewer than
+ *      65536 vertices) or uint32
+ * @var local_indices Whether triangles holds face local indices
+ * @var vertex_offsets First vertex of each face, num_faces + 1 entries (last is the total)
+ * @var index_offsets First entry in triangles of each face, num_faces + 1 entries (last is the total)
  * @var triangles_per_face Number of triangles per individual face
  * @var face_types Classification types for each face
  * @var segments Combined line segments for all edges
  * @var segments_per_edge Number of segments per individual edge
  * @var edge_types Classification types for each edge
  * @var obj_vertices Object-level vertex data
+ * @var face_bounds Bounding box per face (6 values per face: min xyz, max xyz)
+ * @var edge_bounds Bounding box per edge (6 values per edge: min xyz, max xyz)
+ * @var bounds Bounding box of the whole shape (min xyz, max xyz)
+ * @var mesh_threads Number of threads the mesher could use (1 when not meshing in parallel)
+ * @var extraction_threads Number of threads that extracted faces and edges
+ * @var output_size Number of bytes written to the output target of tessellate() (0 without)
+ * @var edge_face_offsets With adjacency: first entry in edge_faces of each edge, num_edges + 1 entries
+ * @var edge_faces With adjacency: indices of the faces bounding each edge (CSR); the triangle edges
+ *      of a shape without topological edges each list the face of their triangle
+ * @var face_edge_offsets With adjacency: first entry in face_edges of each face, num_faces + 1 entries
+ * @var face_edges With adjacency: indices of the edges bounding each face (CSR)
+ * @var vertex_faces With adjacency: face index of every vertex (for ID buffer picking)
+ * @var face_normals With flat_normals: normal of each planar face (3 per face, zero for curved faces)
+ * @var flat_faces With flat_normals: 1 for planar faces, whose normals are in face_normals
+ * @var normal_offsets With flat_normals: first entry (in vertices) in normals of each face,
+ *      num_faces + 1 entries; planar faces have an empty range
+ *
+ * Empty faces and edges get an inverted box (min = +inf, max = -inf). The adjacency and flat
+ * normal arrays are empty unless requested; with flat_normals, normals only holds the per
+ * vertex normals of curved faces.
  */
 
 struct MeshData
 {
     py::array_t<float> vertices;
     py::array_t<float> normals;
-    py::array_t<int> triangles;
+    py::array triangles;
+    bool local_indices = false;
+    py::array_t<int> vertex_offsets;
+    py::array_t<int> index_offsets;
     py::array_t<int> triangles_per_face;
     py::array_t<int> face_types;
     py::array_t<float> segments;
     py::array_t<int> segments_per_edge;
     py::array_t<int> edge_types;
     py::array_t<float> obj_vertices;
+    py::array_t<float> face_bounds;
+    py::array_t<float> edge_bounds;
+    py::array_t<float> bounds;
+    int mesh_threads = 1;
+    int extraction_threads = 1;
+    size_t output_size = 0;
+    py::array_t<int> edge_face_offsets;
+    py::array_t<int> edge_faces;
+    py::array_t<int> face_edge_offsets;
+    py::array_t<int> face_edges;
+    py::array_t<int> vertex_faces;
+    py::array_t<float> face_normals;
+    py::array_t<int> flat_faces;
+    py::array_t<int> normal_offsets;
 };
 
+/**
+ * @brief Consolidates face and edge lists into a MeshData (see collect_mesh_buffers())
+ *
+ * Must be called with the GIL held; it is released while the arrays are collected.
+ */
+MeshData collect_mesh_data(FaceData face_list[], int num_vertices, int num_triangles, int num_faces,
+                           EdgeData edge_list[], int num_segments, int num_edges,
+                           double obj_vertices[], int num_obj_vertices,
+                           bool compute_missing_normals, bool compute_missing_edges, bool local_indices,
+                           bool optimize_order, Arena &arena, bool timeit);
+
+/**
+ * @brief Face index of every vertex, expanded from the vertex offsets of the faces
+ */
+py::array_t<int> expand_vertex_faces(const py::array_t<int> &vertex_offsets);
+
+/**
+ * @brief Hands the buffers of the core over to numpy arrays without copying
+ */
+MeshData wrap_mesh_buffers(MeshBuffers &&buffers);
+
 /**
  * @brief Tessellate a CAD shape into renderable mesh data
  *
@@ -129,7 +131,34 @@ struct MeshData
  * @param parallel Enable parallel processing for tessellation
  * @param debug Debug output level (0=none, higher=more verbose)
  * @param timeit Enable timing measurements for performance analysis
+ * @param local_indices Keep triangle indices local to each face (uint16 when all faces have
+ *        fewer than 65536 vertices) instead of global int32 indices
+ * @param progress Python callable receiving the progress in [0, 1], or None
+ * @param cancel_token Token to cancel the tessellation from another thread, or nullptr
+ * @param progress_interval Minimum time in seconds between two progress callbacks
+ * @param relative Treat deflection as a factor scaled per edge and face by its size
+ * @param min_size Relative mode: minimum size of mesh elements and edge segments
+ *        (IMeshTools_Parameters::MinSize, 0 = no limit); not a deflection
+ * @param max_deflection Relative mode: upper limit of the absolute deflection (0 = no limit)
+ * @param threads Maximum number of threads for the extraction stages (0 = size of the OCCT
+ *        thread pool, 1 = serial, also for the mesher)
+ * @param output Name of a shared memory segment to create or writable buffer receiving all
+ *        arrays in the mesh buffer layout (see mesh_buffer.h), or None
+ * @param optimize_order Reorder the triangles of each face for vertex cache reuse and its
+ *        vertices in order of first use (see vertex_cache.h)
+ * @param adjacency Also return the edge to face and face to edge relations (needs
+ *        compute_edges) and the face index of every vertex; needs compute_faces
+ * @param heal Heal and re-mesh faces whose triangulation is null with relaxed parameters
+ * @param flat_normals Store one normal per planar face instead of one per vertex
  * @return MeshData structure containing all tessellated geometry
+ * @throws TessellationCancelled if the tessellation has been cancelled
+ * @throws std::invalid_argument for adjacency without compute_faces
  */
 MeshData tessellate(py::object obj, double deflection, double angular_tolerance,
-                    bool compute_faces, bool compute_edges, bool parallel, int debug, bool timeit);
+                    bool compute_faces, bool compute_edges, bool parallel, int debug, bool timeit,
+                    bool local_indices = false, py::object progress = py::none(),
+                    const CancelToken *cancel_token = nullptr, double progress_interval = 0.1,
+                    bool relative = false, double min_size = 0.0, double max_deflection = 0.0,
+                    int threads = 0, py::object output = py::none(), bool optimize_order = false,
+                    bool adjacency = false, bool heal = false, bool flat_normals = false);
+
@@ -0,0 +1,194 @@
+#include "vertex_cache.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+
+constexpr int MAX_VALENCE_SCORE = 32;
+
+/*
+ * Score tables of Forsyth's algorithm: the 3 most recent vertices (the last triangle) get a
+ * fixed score, older ones decay with their cache position; a low number of remaining triangles
+ * raises the score, so that vertices are finished and leave the cache.
+ */
+struct ScoreTables
+{
+    std::array<float, VERTEX_CACHE_SIZE> cache;
+    std::array<float, MAX_VALENCE_SCORE> valence;
+
+    ScoreTables()
+    {
+        for (int i = 0; i < VERTEX_CACHE_SIZE; i++)
+        {
+            cache[i] = i < 3 ? 0.75f : std::pow(1.0f - float(i - 3) / float(VERTEX_CACHE_SIZE - 3), 1.5f);
+        }
+        valence[0] = 0.0f;
+        for (int i = 1; i < MAX_VALENCE_SCORE; i++)
+        {
+            valence[i] = 2.0f / std::sqrt(float(i));
+        }
+    }
+
+    float score(int cache_position, int remaining) const
+    {
+        // vertices without remaining triangles never attract a triangle
+        if (remaining == 0)
+            return -1.0f;
+        float s = cache_position < 0 ? 0.0f : cache[cache_position];
+        return s + valence[std::min(remaining, MAX_VALENCE_SCORE - 1)];
+    }
+};
+
+const ScoreTables &score_tables()
+{
+    static const ScoreTables tables;
+    return tables;
+}
+
+} // namespace
+
+void optimize_vertex_cache(int *triangles, int num_triangles, int num_vertices)
+{
+    if (num_triangles < 2 || num_vertices == 0)
+        return;
+
+    const ScoreTables &tables = score_tables();
+
+    // remaining[v] triangles of vertex v are adjacency[offsets[v], offsets[v] + remaining[v])
+    std::vector<int> remaining(num_vertices, 0);
+    for (int k = 0; k < 3 * num_triangles; k++)
+        remaining[triangles[k]]++;
+
+    std::vector<int> offsets(num_vertices + 1, 0);
+    for (int v = 0; v < num_vertices; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+
+    std::vector<int> adjacency(3 * num_triangles);
+    std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (int t = 0; t < num_triangles; t++)
+        for (int c = 0; c < 3; c++)
+            adjacency[fill[triangles[3 * t + c]]++] = t;
+
+    std::vector<int> cache_position(num_vertices, -1);
+    std::vector<float> vertex_score(num_vertices);
+    for (int v = 0; v < num_vertices; v++)
+        vertex_score[v] = tables.score(-1, remaining[v]);
+
+    std::vector<float> triangle_score(num_triangles);
+    std::vector<char> emitted(num_triangles, 0);
+    int best = 0;
+    for (int t = 0; t < num_triangles; t++)
+    {
+        triangle_score[t] = vertex_score[triangles[3 * t]] + vertex_score[triangles[3 * t + 1]] +
+                            vertex_score[triangles[3 * t + 2]];
+        if (triangle_score[t] > triangle_score[best])
+            best = t;
+    }
+
+    std::vector<int> output(3 * num_triangles);
+    std::array<int, VERTEX_CACHE_SIZE + 3> cache;
+    std::array<int, VERTEX_CACHE_SIZE + 3> next_cache;
+    int cache_count = 0;
+    int cursor = 0;
+
+    for (int n = 0; n < num_triangles; n++)
+    {
+        if (best < 0)
+        {
+            // no triangle touches the cache, continue with the next one in input order
+            while (emitted[cursor])
+                cursor++;
+            best = cursor;
+        }
+
+        const int t = best;
+        emitted[t] = 1;
+
+        int next_count = 0;
+        for (int c = 0; c < 3; c++)
+        {
+            const int v = triangles[3 * t + c];
+            output[3 * n + c] = v;
+
+            int *begin = adjacency.data() + offsets[v];
+            int *end = begin + remaining[v];
+            std::iter_swap(std::find(begin, end, t), end - 1);
+            remaining[v]--;
+
+            if (std::find(next_cache.begin(), next_cache.begin() + next_count, v) == next_cache.begin() + next_count)
+                next_cache[next_count++] = v;
+        }
+        for (int i = 0; i < cache_count; i++)
+        {
+            const int v = cache[i];
+            if (v != triangles[3 * t] && v != triangles[3 * t + 1] && v != triangles[3 * t + 2])
+                next_cache[next_count++] = v;
+        }
+
+        // update the scores of all vertices in the new cache and of the evicted ones
+        for (int i = 0; i < next_count; i++)
+        {
+            const int v = next_cache[i];
+            cache_position[v] = i < VERTEX_CACHE_SIZE ? i : -1;
+            const float score = tables.score(cache_position[v], remaining[v]);
+            const float delta = score - vertex_score[v];
+            vertex_score[v] = score;
+            for (int k = offsets[v]; k < offsets[v] + remaining[v]; k++)
+                triangle_score[adjacency[k]] += delta;
+        }
+
+        cache_count = std::min(next_count, VERTEX_CACHE_SIZE);
+        for (int i = 0; i < cache_count; i++)
+            cache[i] = next_cache[i];
+
+        best = -1;
+        float best_score = -1.0f;
+        for (int i = 0; i < cache_count; i++)
+        {
+            const int v = cache[i];
+            for (int k = offsets[v]; k < offsets[v] + remaining[v]; k++)
+            {
+                const int candidate = adjacency[k];
+                if (triangle_score[candidate] > best_score)
+                {
+                    best = candidate;
+                    best_score = triangle_score[candidate];
+                }
+            }
+        }
+    }
+
+    std::copy(output.begin(), output.end(), triangles);
+}
+
+void reorder_vertices(double *vertices, double *normals, int *triangles, int num_triangles, int num_vertices)
+{
+    std::vector<int> remap(num_vertices, -1);
+    int next = 0;
+    for (int k = 0; k < 3 * num_triangles; k++)
+    {
+        int &v = triangles[k];
+        if (remap[v] < 0)
+            remap[v] = next++;
+        v = remap[v];
+    }
+    for (int v = 0; v < num_vertices; v++)
+    {
+        if (remap[v] < 0)
+            remap[v] = next++;
+    }
+
+    std::vector<double> scratch(3 * size_t(num_vertices));
+    for (double *values : {vertices, normals})
+    {
+        if (values == nullptr)
+            continue;
+        for (int v = 0; v < num_vertices; v++)
+            std::copy(values + 3 * v, values + 3 * v + 3, scratch.begin() + 3 * remap[v]);
+        std::copy(scratch.begin(), scratch.end(), values);
+    }
+}
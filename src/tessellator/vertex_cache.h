@@ -0,0 +1,37 @@
+#pragma once
+
+/**
+ * @file vertex_cache.h
+ * @brief Triangle and vertex reordering of face meshes for GPU cache efficiency
+ *
+ * Triangles are reordered with Tom Forsyth's linear-speed vertex cache optimization, which
+ * greedily emits the triangle whose vertices score best in a simulated LRU cache, favoring
+ * recently used vertices and vertices with few remaining triangles. Vertices are then renumbered
+ * in order of first use, so that the vertex fetches of the reordered triangles are mostly
+ * sequential. All functions work on one face (face local indices) and are thread safe.
+ */
+
+/**
+ * @brief Size of the simulated post-transform vertex cache
+ */
+constexpr int VERTEX_CACHE_SIZE = 32;
+
+/**
+ * @brief Reorders triangles in place for vertex cache reuse (the winding of each triangle is kept)
+ *
+ * @param triangles 3 * num_triangles face local vertex indices
+ * @param num_triangles Number of triangles
+ * @param num_vertices Number of vertices referenced by the indices
+ */
+void optimize_vertex_cache(int *triangles, int num_triangles, int num_vertices);
+
+/**
+ * @brief Renumbers vertices in order of first use by the triangles, unreferenced vertices last
+ *
+ * @param vertices 3 * num_vertices coordinates, permuted in place
+ * @param normals 3 * num_vertices normal components, permuted in place (may be nullptr)
+ * @param triangles 3 * num_triangles face local vertex indices, rewritten in place
+ * @param num_triangles Number of triangles
+ * @param num_vertices Number of vertices
+ */
+void reorder_vertices(double *vertices, double *normals, int *triangles, int num_triangles, int num_vertices);
@@ -0,0 +1,76 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(int num_workers, int max_queue)
+    : num_workers_(std::max(num_workers, 1)), max_queue_(static_cast<size_t>(std::max(max_queue, 1)))
+{
+    workers_.reserve(num_workers_);
+    for (int i = 0; i < num_workers_; i++)
+    {
+        workers_.emplace_back(&WorkerPool::run, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    shutdown();
+}
+
+bool WorkerPool::submit(std::function<void()> job)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this]
+                       { return stopped_ || queue_.size() < max_queue_; });
+        if (stopped_)
+            return false;
+        queue_.push_back(std::move(job));
+    }
+    not_empty_.notify_one();
+    return true;
+}
+
+void WorkerPool::shutdown()
+{
+    std::lock_guard<std::mutex> join_lock(join_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    not_empty_.notify_all();
+    not_full_.notify_all();
+
+    for (std::thread &worker : workers_)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+    workers_.clear();
+}
+
+size_t WorkerPool::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+void WorkerPool::run()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [this]
+                            { return stopped_ || !queue_.empty(); });
+            // drain the queue before stopping
+            if (queue_.empty())
+                return;
+            job = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        not_full_.notify_one();
+        job();
+    }
+}
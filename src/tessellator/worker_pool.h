@@ -0,0 +1,75 @@
+#pragma once
+
+/**
+ * @file worker_pool.h
+ * @brief Fixed size pool of native worker threads with a bounded job queue
+ *
+ * Used by tessellate_async() to run tessellations without a Python thread per request.
+ * The pool itself does not know about Python; jobs are responsible for acquiring the GIL
+ * when they touch Python objects.
+ */
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool
+{
+public:
+    /**
+     * @brief Starts the worker threads
+     *
+     * @param num_workers Number of worker threads (at least 1)
+     * @param max_queue Maximum number of jobs waiting to be picked up (at least 1)
+     */
+    WorkerPool(int num_workers, int max_queue);
+
+    /**
+     * @brief Shuts the pool down, see shutdown()
+     */
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    /**
+     * @brief Queues a job
+     *
+     * Blocks while the queue is full.
+     *
+     * @param job Function to be executed by a worker thread
+     * @return false if the pool has been shut down and the job was not queued
+     */
+    bool submit(std::function<void()> job);
+
+    /**
+     * @brief Stops accepting jobs, runs all queued jobs and joins the worker threads
+     *
+     * Must not be called from a worker thread. Calling it more than once is a no-op.
+     */
+    void shutdown();
+
+    int num_workers() const { return num_workers_; }
+    int max_queue() const { return static_cast<int>(max_queue_); }
+
+    /// Number of jobs waiting to be picked up by a worker
+    size_t pending() const;
+
+private:
+    void run();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> queue_;
+    int num_workers_;
+    size_t max_queue_;
+    bool stopped_ = false;
+
+    mutable std::mutex mutex_;
+    std::mutex join_mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+};
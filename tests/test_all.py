@@ -1,9 +1,32 @@
+import asyncio
+import os
+import pickle
+import sys
 from pathlib import Path
 from time import time
 
+import numpy as np
 import pytest
 
-from ocp_addons.tessellator import tessellate
+from ocp_addons.tessellator import (
+    tessellate,
+    tessellate_async,
+    tessellate_sharded,
+    tessellate_to_ply,
+    tessellate_to_stl,
+    build_meshlets,
+    simplify,
+    CancelToken,
+    MeshBVH,
+    MeshData,
+    MeshState,
+    TessellationCancelled,
+    TessellatorPool,
+    configure_threads,
+    thread_count,
+    load_mesh_buffer,
+    mesh_buffer_size,
+)
 from ocp_addons import serializer
 
 try:
@@ -78,6 +101,9 @@ def tess(obj, deflection, angular_tolerance, parallel):
         "obj_vertices": m.obj_vertices,
         "triangles_per_face": m.triangles_per_face,
         "segments_per_edge": m.segments_per_edge,
+        "face_bounds": m.face_bounds,
+        "edge_bounds": m.edge_bounds,
+        "bounds": m.bounds,
     }
 
 
@@ -390,6 +416,18 @@ expected_obj_vertices = [
 expected_segments_per_edge = [1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1]
 
 
+@pytest.fixture(scope="module")
+def b123_data():
+    """BREP data of the simple 1 x 2 x 3 box"""
+    return (Path("examples") / "b123.brep").read_bytes()
+
+
+@pytest.fixture
+def b123(b123_data):
+    """A fresh, not yet meshed shape of the simple box"""
+    return serializer.deserialize_shape(b123_data)
+
+
 def test_serializer():
     """Test basic serializer functionality"""
     assert serializer._test() == "Ok"
@@ -422,6 +460,722 @@ def test_simple_box_deserialized():
     assert list(mesh["segments_per_edge"]) == expected_segments_per_edge
 
 
+def test_bounds(b123):
+    """Test per face, per edge and overall bounding boxes of a simple box"""
+    mesh = tess(b123, 0.002, 0.3, parallel=True)
+
+    assert len(mesh["face_bounds"]) == 6 * len(expected_face_types)
+    assert len(mesh["edge_bounds"]) == 6 * len(expected_edge_types)
+    assert almost_equal(mesh["bounds"], [-0.5, -1.0, -1.5, 0.5, 1.0, 1.5])
+    assert almost_equal(mesh["face_bounds"][:6], [-0.5, -1.0, -1.5, -0.5, 1.0, 1.5])
+    assert almost_equal(mesh["edge_bounds"][:6], [-0.5, -1.0, -1.5, -0.5, -1.0, 1.5])
+
+
+def test_local_indices(b123):
+    """Test face local uint16 triangle indices with vertex and index offsets"""
+    mesh = tessellate(b123, 0.002, 0.3, local_indices=True)
+
+    assert mesh.local_indices
+    assert mesh.triangles.dtype == np.uint16
+    assert list(mesh.vertex_offsets) == [0, 4, 8, 12, 16, 20, 24]
+    assert list(mesh.index_offsets) == [0, 6, 12, 18, 24, 30, 36]
+
+    rebased = [
+        int(mesh.triangles[j]) + int(mesh.vertex_offsets[i])
+        for i in range(6)
+        for j in range(mesh.index_offsets[i], mesh.index_offsets[i + 1])
+    ]
+    assert rebased == expected_triangles
+
+    bvh = MeshBVH(mesh)
+    faces, _ = bvh.intersect_faces(
+        np.array([[0.0, 0.0, 10.0]], dtype=np.float32),
+        np.array([[0.0, 0.0, -1.0]], dtype=np.float32),
+    )
+    assert list(faces) == [5]
+
+
+def test_bvh_picking(b123):
+    """Test ray picking of faces and edges of a simple box"""
+    mesh = tessellate(b123, 0.002, 0.3)
+    bvh = MeshBVH(mesh)
+
+    assert bvh.num_triangles == 12
+    assert bvh.num_segments == 12
+
+    origins = np.array([[0.0, 0.0, 10.0], [5.0, 5.0, 10.0]], dtype=np.float32)
+    directions = np.array([[0.0, 0.0, -1.0], [0.0, 0.0, -1.0]], dtype=np.float32)
+    faces, distances = bvh.intersect_faces(origins, directions)
+    assert list(faces) == [5, -1]
+    assert almost_equal(distances[:1], [8.5])
+
+    origins = np.array([[-2.0, -1.05, 0.0]], dtype=np.float32)
+    directions = np.array([[1.0, 0.0, 0.0]], dtype=np.float32)
+    edges, distances = bvh.nearest_edges(origins, directions, 0.1)
+    assert list(edges) == [0]
+    assert almost_equal(distances, [1.5], 1e-5)
+
+    edges, _ = bvh.nearest_edges(origins, directions, 0.01)
+    assert list(edges) == [-1]
+
+
+def test_tessellate_async(b123_data):
+    """Test tessellation on the native worker pool, with futures and asyncio"""
+    shapes = [serializer.deserialize_shape(b123_data) for _ in range(4)]
+
+    pool = TessellatorPool(num_workers=2, max_queue=2)
+    futures = [pool.submit(shape, 0.002) for shape in shapes]
+    results = [future.result(timeout=60) for future in futures]
+    pool.shutdown()
+
+    for shape, mesh in zip(shapes, results):
+        expected = tessellate(shape, 0.002)
+        assert list(mesh.triangles) == expected_triangles
+        for name in ("vertices", "normals", "triangles", "triangles_per_face", "segments", "edge_types"):
+            assert np.array_equal(getattr(mesh, name), getattr(expected, name)), name
+
+    async def run():
+        return await asyncio.wrap_future(tessellate_async(shapes[0], 0.002))
+
+    mesh = asyncio.run(run())
+    assert almost_equal(mesh.vertices, expected_vertices)
+
+
+def test_progress_and_cancel(b123_data):
+    """Test progress reporting and cancellation of a tessellation"""
+    progress = []
+    mesh = tessellate(
+        serializer.deserialize_shape(b123_data),
+        0.002,
+        progress=progress.append,
+        progress_interval=0.0,
+    )
+    assert list(mesh.triangles) == expected_triangles
+    assert progress[-1] == 1.0
+    assert all(a <= b for a, b in zip(progress, progress[1:]))
+
+    token = CancelToken()
+    token.cancel()
+    with pytest.raises(TessellationCancelled):
+        tessellate(serializer.deserialize_shape(b123_data), 0.002, cancel_token=token)
+
+    future = tessellate_async(
+        serializer.deserialize_shape(b123_data), 0.002, cancel_token=token
+    )
+    with pytest.raises(TessellationCancelled):
+        future.result(timeout=60)
+
+
+@pytest.mark.skipif(not (CQ or BD), reason="Requires CadQuery or build123d")
+def test_relative_deflection():
+    """Test relative deflection on a mixed scale shape"""
+
+    def shape():
+        if BD:
+            big = bd.Cylinder(50, 10)
+            small = bd.Pos(0, 0, 5) * bd.Cylinder(0.5, 10)
+            return (big + small).wrapped
+        wp = cq.Workplane().cylinder(10, 50).faces(">Z").workplane().cylinder(10, 0.5)
+        return wp.val().wrapped
+
+    absolute = tessellate(shape(), 0.5, 0.3)
+    adaptive = tessellate(shape(), 0.01, 0.3, relative=True)
+    limited = tessellate(shape(), 0.01, 0.3, relative=True, max_deflection=0.05)
+
+    assert len(adaptive.triangles_per_face) == len(absolute.triangles_per_face)
+    assert len(adaptive.triangles) > 0
+    # the upper limit can only refine the mesh
+    assert len(limited.triangles) >= len(adaptive.triangles)
+
+    # min_size is a length: no edge segment is shorter (unless its whole edge is)
+    min_size = 0.5
+    sized = tessellate(shape(), 0.01, 0.3, relative=True, min_size=min_size)
+    points = sized.segments.reshape(-1, 2, 3)
+    lengths = np.linalg.norm(points[:, 1] - points[:, 0], axis=1)
+    offsets = np.concatenate(([0], np.cumsum(sized.segments_per_edge)))
+    for i0, i1 in zip(offsets[:-1], offsets[1:]):
+        if lengths[i0:i1].sum() >= min_size:
+            assert np.all(lengths[i0:i1] >= min_size * (1 - 1e-3))
+
+
+@pytest.mark.skipif(not (CQ or BD), reason="Requires CadQuery or build123d")
+def test_free_edges():
+    """Test native discretization of edges without faces"""
+    if BD:
+        obj = bd.Wire.make_circle(5).wrapped
+    else:
+        obj = cq.Wire.makeCircle(5, cq.Vector(0, 0, 0), cq.Vector(0, 0, 1)).wrapped
+
+    mesh = tessellate(obj, 0.01, 0.3)
+
+    assert len(mesh.face_types) == 0
+    assert len(mesh.segments_per_edge) == 1
+    assert mesh.segments_per_edge[0] > 8
+    assert mesh.edge_types[0] == 1  # GeomAbs_Circle
+    points = mesh.segments.reshape(-1, 3)
+    assert np.allclose(np.linalg.norm(points, axis=1), 5.0, atol=1e-3)
+
+    # a finer deflection gives more segments
+    fine = tessellate(obj, 0.0001, 0.3)
+    assert fine.segments_per_edge[0] > mesh.segments_per_edge[0]
+
+
+@pytest.mark.skipif(not (CQ or BD), reason="Requires CadQuery or build123d")
+def test_optimize_order():
+    """Test vertex cache reordering keeps faces intact and improves cache reuse"""
+
+    def shape():
+        if BD:
+            return bd.Sphere(10).wrapped
+        return cq.Workplane().sphere(10).val().wrapped
+
+    def acmr(triangles, cache_size=32):
+        cache, misses = [], 0
+        for v in triangles:
+            if v not in cache:
+                misses += 1
+                cache.insert(0, v)
+                del cache[cache_size:]
+        return misses / (len(triangles) / 3)
+
+    plain = tessellate(shape(), 0.01, 0.1)
+    optimized = tessellate(shape(), 0.01, 0.1, optimize_order=True)
+
+    assert np.array_equal(optimized.triangles_per_face, plain.triangles_per_face)
+    assert np.array_equal(optimized.vertex_offsets, plain.vertex_offsets)
+    # same triangles, only reordered and renumbered
+    a = np.sort(np.sort(plain.vertices.reshape(-1, 3)[plain.triangles.reshape(-1, 3)], axis=1), axis=0)
+    b = np.sort(np.sort(optimized.vertices.reshape(-1, 3)[optimized.triangles.reshape(-1, 3)], axis=1), axis=0)
+    assert np.allclose(a, b)
+    assert acmr(list(optimized.triangles)) <= acmr(list(plain.triangles))
+
+
+def test_occt_threads():
+    """Test that the mesher runs on the OCCT pool without configure_threads(), also with TBB"""
+    from OCP.OSD import OSD_Parallel
+
+    assert OSD_Parallel.ToUseOcctThreads_s()
+
+
+def test_threads(b123):
+    """Test explicit thread counts give identical meshes"""
+    pool_size = configure_threads(4)
+    assert pool_size == thread_count() == 4
+
+    serial = tessellate(b123, 0.002, 0.3, threads=1)
+    assert serial.mesh_threads == 1
+    assert serial.extraction_threads == 1
+
+    capped = tessellate(b123, 0.002, 0.3, threads=2)
+    assert capped.mesh_threads == 4
+    assert 1 <= capped.extraction_threads <= 2
+
+    default = tessellate(b123, 0.002, 0.3)
+    assert 1 <= default.extraction_threads <= 4
+
+    for mesh in (capped, default):
+        assert np.array_equal(mesh.vertices, serial.vertices)
+        assert np.array_equal(mesh.triangles, serial.triangles)
+        assert np.array_equal(mesh.segments, serial.segments)
+
+    configure_threads(-1)
+
+
+def test_mesh_buffer(b123):
+    """Test writing all arrays into one caller provided buffer"""
+    reference = tessellate(b123, 0.002, 0.3, local_indices=True)
+    buffer = bytearray(mesh_buffer_size(reference))
+
+    mesh = tessellate(b123, 0.002, 0.3, local_indices=True, output=buffer)
+    assert mesh.output_size == len(buffer)
+
+    views = load_mesh_buffer(buffer)
+    assert views["local_indices"]
+    assert views["triangles"].dtype == np.uint16
+    for name in ("vertices", "normals", "triangles", "index_offsets", "segments", "bounds"):
+        assert np.array_equal(views[name], getattr(mesh, name))
+
+    # zero copy: the views share the memory of the buffer
+    assert np.shares_memory(views["vertices"], np.frombuffer(buffer, dtype=np.uint8))
+
+    with pytest.raises(ValueError):
+        tessellate(b123, 0.002, 0.3, output=bytearray(64))
+
+
+@pytest.mark.skipif(sys.platform == "win32", reason="POSIX shared memory only")
+def test_mesh_buffer_shared_memory(b123):
+    """Test writing all arrays into a named shared memory segment"""
+    from multiprocessing import shared_memory
+
+    name = f"ocp_addons_test_{os.getpid()}"
+    mesh = tessellate(b123, 0.002, 0.3, output=name)
+    try:
+        views = load_mesh_buffer(name)
+        assert not views["vertices"].flags.writeable
+        assert np.array_equal(views["triangles"], mesh.triangles)
+        assert np.array_equal(views["face_bounds"], mesh.face_bounds)
+    finally:
+        shared_memory.SharedMemory(name=name).unlink()
+
+
+def test_pack_unpack(b123):
+    """Test the single buffer wire format round trip"""
+    mesh = tessellate(b123, 0.002, 0.3)
+    packed = mesh.pack()
+
+    assert packed.dtype == np.uint8
+    assert packed.ctypes.data % 64 == 0
+    assert len(packed) == mesh_buffer_size(mesh)
+    assert bytes(packed[:8]) == b"OCPMESH\0"
+
+    # e.g. received as one websocket frame
+    frame = packed.tobytes()
+    unpacked = MeshData.unpack(frame)
+
+    assert not unpacked.local_indices
+    for name in ("vertices", "normals", "triangles", "vertex_offsets", "segments", "edge_types", "bounds"):
+        assert np.array_equal(getattr(unpacked, name), getattr(mesh, name))
+        assert getattr(unpacked, name).dtype == getattr(mesh, name).dtype
+    assert np.shares_memory(unpacked.vertices, np.frombuffer(frame, dtype=np.uint8))
+
+    with pytest.raises(ValueError):
+        MeshData.unpack(b"no mesh buffer" * 4)
+
+
+def test_mesh_delta(b123_data):
+    """Test incremental deltas between tessellations"""
+    obj = serializer.deserialize_shape(b123_data)
+
+    state = MeshState()
+    mesh = tessellate(obj, 0.002, 0.3)
+
+    first = state.update(obj, mesh)
+    assert list(first.added_faces) == list(range(6))
+    assert list(first.faces) == list(range(6))
+    assert len(first.removed_faces) == 0
+    assert np.array_equal(first.vertices, mesh.vertices)
+    assert list(first.vertex_offsets) == list(mesh.vertex_offsets)
+    assert len(first.edges) == 12
+    assert state.num_faces == 6
+    assert state.num_edges == 12
+
+    # unchanged shape: nothing to transfer
+    second = state.update(obj, tessellate(obj, 0.002, 0.3))
+    assert list(second.face_remap) == list(range(6))
+    assert len(second.faces) == 0
+    assert len(second.edges) == 0
+    assert len(second.vertices) == 0
+
+    # new TShapes: everything is replaced
+    other = serializer.deserialize_shape(b123_data)
+    third = state.update(other, tessellate(other, 0.002, 0.3))
+    assert list(third.face_remap) == [-1] * 6
+    assert list(third.removed_faces) == list(range(6))
+    assert list(third.removed_edges) == list(range(12))
+
+
+def test_shape_hash(b123_data):
+    """Test the native geometric shape hash"""
+    obj = serializer.deserialize_shape(b123_data)
+    copy = serializer.deserialize_shape(b123_data)
+
+    # same geometry, different TShapes
+    assert serializer.shape_hash(obj) == serializer.shape_hash(copy)
+
+    whole, faces = serializer.shape_hash(obj, per_face=True)
+    assert whole == serializer.shape_hash(obj)
+    assert len(faces) == 6
+    assert len(set(faces.tolist())) == 6
+
+    other = serializer.deserialize_shape((Path("examples") / "b.brep").read_bytes())
+    assert serializer.shape_hash(other) != whole
+
+
+def test_pickle_out_of_band(b123):
+    """Test pickle protocol 5 with out-of-band buffers for shapes and MeshData"""
+    from OCP.TopoDS import TopoDS_Shape
+
+    previous = TopoDS_Shape.__dict__.get("__reduce_ex__")
+    serializer.enable_pickle()
+    serializer.enable_pickle()  # idempotent
+
+    mesh = tessellate(b123, 0.002, 0.3, local_indices=True)
+
+    buffers = []
+    data = pickle.dumps((b123, mesh), protocol=5, buffer_callback=buffers.append)
+    # the serialized shape and the 22 arrays travel out-of-band (23 buffers)
+    assert len(buffers) == 23
+    assert len(data) < 2048
+
+    obj2, mesh2 = pickle.loads(data, buffers=buffers)
+    assert isinstance(obj2, type(b123))
+    assert obj2.ShapeType() == b123.ShapeType()
+    assert serializer.shape_hash(obj2) == serializer.shape_hash(b123)
+    assert mesh2.local_indices
+    for name in ("vertices", "normals", "triangles", "index_offsets", "segments", "bounds"):
+        assert np.array_equal(getattr(mesh2, name), getattr(mesh, name))
+        assert getattr(mesh2, name).dtype == getattr(mesh, name).dtype
+
+    # older protocols pickle in-band
+    mesh3 = pickle.loads(pickle.dumps(mesh, protocol=4))
+    assert np.array_equal(mesh3.triangles, mesh.triangles)
+
+    # pickling of shapes is process wide, disabling restores the previous one
+    serializer.enable_pickle(False)
+    assert TopoDS_Shape.__dict__.get("__reduce_ex__") is previous
+
+
+def test_meshlets(b123):
+    """Test meshlet partitioning of faces"""
+    mesh = tessellate(b123, 0.002, 0.3)
+    num_faces = len(mesh.face_types)
+
+    meshlets = build_meshlets(mesh)
+    # a face splits into as many meshlets as the limits require
+    assert meshlets.num_meshlets >= num_faces
+    assert np.array_equal(np.unique(meshlets.faces), np.arange(num_faces))
+    assert np.all(np.diff(meshlets.faces) >= 0)
+    assert meshlets.triangles.dtype == np.uint16
+
+    # the meshlets cover every triangle of the mesh exactly once, within its face
+    triangles = [
+        meshlets.vertex_indices[meshlets.vertex_offsets[m] + meshlets.triangles[i0:i1]].reshape(-1, 3)
+        for m, (i0, i1) in enumerate(zip(meshlets.index_offsets[:-1], meshlets.index_offsets[1:]))
+    ]
+    covered = sorted(tuple(sorted(t)) for t in np.concatenate(triangles).tolist())
+    assert covered == sorted(tuple(sorted(t)) for t in mesh.triangles.reshape(-1, 3).tolist())
+    per_face = np.bincount(meshlets.faces, weights=[len(t) for t in triangles], minlength=num_faces)
+    assert np.array_equal(per_face, mesh.triangles_per_face)
+
+    # planar faces: the cone axis is the face normal, every sphere contains its vertices
+    cones = meshlets.cones.reshape(-1, 4)
+    spheres = meshlets.spheres.reshape(-1, 4)
+    vertices = mesh.vertices.reshape(-1, 3)
+    for m in range(meshlets.num_meshlets):
+        assert np.isclose(np.linalg.norm(cones[m, :3]), 1.0)
+        assert cones[m, 3] < 1e-3
+        v = vertices[meshlets.vertex_indices[meshlets.vertex_offsets[m] : meshlets.vertex_offsets[m + 1]]]
+        assert np.all(np.linalg.norm(v - spheres[m, :3], axis=1) <= spheres[m, 3] + 1e-4)
+
+    # three vertices allow only one triangle per meshlet
+    small = build_meshlets(mesh, max_vertices=3)
+    assert small.num_meshlets == len(mesh.triangles) // 3
+
+    with pytest.raises(ValueError):
+        build_meshlets(mesh, max_vertices=2)
+
+
+def test_adjacency(b123):
+    """Test edge/face adjacency and per vertex face indices"""
+    plain = tessellate(b123, 0.002, 0.3)
+    assert len(plain.edge_faces) == 0 and len(plain.vertex_faces) == 0
+
+    mesh = tessellate(b123, 0.002, 0.3, adjacency=True)
+    num_faces = len(mesh.face_types)
+    num_edges = len(mesh.edge_types)
+
+    # box: every edge bounds two faces, every face has four edges
+    assert len(mesh.edge_face_offsets) == num_edges + 1
+    assert np.all(np.diff(mesh.edge_face_offsets) == 2)
+    assert len(mesh.face_edge_offsets) == num_faces + 1
+    assert np.all(np.diff(mesh.face_edge_offsets) == 4)
+
+    # face_edges is the transpose of edge_faces
+    pairs = {(f, e) for e in range(num_edges) for f in mesh.edge_faces[mesh.edge_face_offsets[e] : mesh.edge_face_offsets[e + 1]]}
+    transposed = {(f, e) for f in range(num_faces) for e in mesh.face_edges[mesh.face_edge_offsets[f] : mesh.face_edge_offsets[f + 1]]}
+    assert pairs == transposed
+
+    assert mesh.vertex_faces.dtype == np.int32
+    assert np.array_equal(mesh.vertex_faces, np.repeat(np.arange(num_faces), np.diff(mesh.vertex_offsets)))
+
+    # the arrays travel with the wire format
+    unpacked = MeshData.unpack(mesh.pack())
+    assert np.array_equal(unpacked.face_edges, mesh.face_edges)
+    assert np.array_equal(unpacked.vertex_faces, mesh.vertex_faces)
+
+    # the face indices would refer to faces that are not returned
+    with pytest.raises(ValueError):
+        tessellate(b123, 0.002, 0.3, compute_faces=False, adjacency=True)
+
+
+def test_adjacency_without_edges():
+    """Test the adjacency of the triangle edges of a face without topological edges"""
+    from OCP.BRep import BRep_Builder
+    from OCP.BRepBuilderAPI import BRepBuilderAPI_MakeFace
+    from OCP.gp import gp_Pln, gp_Pnt
+    from OCP.Poly import Poly_Triangle, Poly_Triangulation
+
+    # an unbounded plane has no wire, its only mesh is the attached triangulation (a unit square)
+    face = BRepBuilderAPI_MakeFace(gp_Pln()).Face()
+    triangulation = Poly_Triangulation(4, 2, False)
+    for i, (x, y) in enumerate([(0, 0), (1, 0), (1, 1), (0, 1)]):
+        triangulation.SetNode(i + 1, gp_Pnt(x, y, 0))
+    triangulation.SetTriangle(1, Poly_Triangle(1, 2, 3))
+    triangulation.SetTriangle(2, Poly_Triangle(1, 3, 4))
+    BRep_Builder().UpdateFace(face, triangulation)
+
+    mesh = tessellate(face, 0.1, 0.3, adjacency=True)
+    assert mesh.triangles_per_face.tolist() == [2]
+
+    # every triangle became an edge that bounds only its own face
+    assert len(mesh.edge_types) == 2
+    assert mesh.edge_face_offsets.tolist() == [0, 1, 2]
+    assert mesh.edge_faces.tolist() == [0, 0]
+    assert mesh.face_edge_offsets.tolist() == [0, 2]
+    assert mesh.face_edges.tolist() == [0, 1]
+
+
+@pytest.mark.skipif(not (CQ or BD), reason="Requires CadQuery or build123d")
+def test_simplify():
+    """Test quadric simplification keeps face boundaries and index mode"""
+
+    def shape():
+        if BD:
+            return bd.Cylinder(10, 20).wrapped
+        return cq.Workplane().cylinder(20, 10).val().wrapped
+
+    mesh = tessellate(shape(), 0.001, 0.05, local_indices=True)
+    coarse = simplify(mesh, ratio=0.25)
+
+    assert coarse.local_indices
+    assert coarse.triangles.dtype == mesh.triangles.dtype
+    assert len(coarse.triangles) < len(mesh.triangles)
+    assert np.all(coarse.triangles_per_face <= mesh.triangles_per_face)
+    assert np.array_equal(coarse.segments, mesh.segments)
+
+    # boundary vertices of every face survive, kept vertices are original ones
+    for i in range(len(mesh.face_types)):
+        before = mesh.vertices.reshape(-1, 3)[mesh.vertex_offsets[i] : mesh.vertex_offsets[i + 1]]
+        after = coarse.vertices.reshape(-1, 3)[coarse.vertex_offsets[i] : coarse.vertex_offsets[i + 1]]
+        kept = {tuple(v) for v in after}
+        assert kept <= {tuple(v) for v in before}
+    points = {tuple(p) for p in mesh.segments.reshape(-1, 3)}
+    assert points <= {tuple(v) for v in coarse.vertices.reshape(-1, 3)}
+
+    # ratio 1 keeps everything, a tight error bound limits the collapses
+    same = simplify(mesh, ratio=1.0)
+    assert np.array_equal(same.triangles, mesh.triangles)
+    bounded = simplify(mesh, ratio=0.0, max_error=1e-6)
+    assert len(bounded.triangles) > len(coarse.triangles)
+
+    # max_error bounds the distance to the original triangle planes on large and small faces:
+    # on the lateral face (radius 10) the chords of the simplified triangles stay within
+    # max_error (plus the deflection of the original mesh) of the cylinder
+    max_error = 0.05
+    limited = simplify(mesh, ratio=0.0, max_error=max_error)
+    for i in np.flatnonzero(mesh.face_types == 1):  # GeomAbs_Cylinder
+        vertices = limited.vertices.reshape(-1, 3)[limited.vertex_offsets[i] : limited.vertex_offsets[i + 1]]
+        corners = vertices[limited.triangles[limited.index_offsets[i] : limited.index_offsets[i + 1]].reshape(-1, 3)]
+        points = np.concatenate([corners.mean(axis=1), (corners + np.roll(corners, 1, axis=1)).reshape(-1, 3) / 2])
+        depth = 10.0 - np.linalg.norm(points[:, :2], axis=1)
+        assert len(limited.triangles) < len(mesh.triangles)
+        assert depth.max() <= max_error + 0.001 + 1e-5
+
+    with pytest.raises(ValueError):
+        simplify(mesh, ratio=1.5)
+
+
+def test_tessellate_sharded(b123_data):
+    """Test multi-process sharded tessellation against tessellate()"""
+    expected = tessellate(serializer.deserialize_shape(b123_data), 0.002, 0.3)
+
+    obj = serializer.deserialize_shape(b123_data)
+    for shard_by, faces_per_shard in (("solid", 0), ("faces", 2)):
+        mesh = tessellate_sharded(
+            obj, 0.002, 0.3, shard_by=shard_by, faces_per_shard=faces_per_shard, processes=2
+        )
+        assert not mesh.local_indices
+        for name in (
+            "triangles_per_face",
+            "vertex_offsets",
+            "index_offsets",
+            "face_types",
+            "triangles",
+            "segments_per_edge",
+            "edge_types",
+        ):
+            assert np.array_equal(getattr(mesh, name), getattr(expected, name)), name
+        for name in ("vertices", "normals", "segments", "obj_vertices", "bounds"):
+            assert np.allclose(getattr(mesh, name), getattr(expected, name)), name
+
+    mesh = tessellate_sharded(obj, 0.002, 0.3, local_indices=True, shard_by="faces", faces_per_shard=4)
+    assert mesh.local_indices
+    assert mesh.triangles.dtype == np.uint16
+
+    with pytest.raises(ValueError):
+        tessellate_sharded(obj, 0.002, shard_by="edges")
+
+
+def test_tessellate_sharded_crash(b123_data, monkeypatch):
+    """Test that a crashing worker only fails its own shard"""
+    expected = tessellate(serializer.deserialize_shape(b123_data), 0.002, 0.3)
+
+    # one face per shard, the worker of shard 2 (face 2) exits
+    monkeypatch.setenv("OCP_ADDONS_SHARD_CRASH", "2")
+    obj = serializer.deserialize_shape(b123_data)
+    with pytest.warns(RuntimeWarning, match="1 of 6 shards failed") as record:
+        mesh = tessellate_sharded(obj, 0.002, 0.3, shard_by="faces", faces_per_shard=1, processes=2)
+
+    message = str(record[0].message)
+    assert "shard 2 " in message and "worker process died" in message
+    assert not any(f"shard {s} " in message for s in (0, 1, 3, 4, 5))
+
+    assert mesh.triangles_per_face[2] == 0
+    others = np.arange(6) != 2
+    assert np.array_equal(mesh.triangles_per_face[others], expected.triangles_per_face[others])
+
+
+def stacked_cylinders():
+    """Compound of two cylinders sharing the disc at z = 10 and its circular edge"""
+    from OCP.BOPAlgo import BOPAlgo_Builder
+    from OCP.BRepPrimAPI import BRepPrimAPI_MakeCylinder
+    from OCP.gp import gp_Ax2, gp_Dir, gp_Pnt
+
+    builder = BOPAlgo_Builder()
+    for z in (0.0, 10.0):
+        builder.AddArgument(BRepPrimAPI_MakeCylinder(gp_Ax2(gp_Pnt(0, 0, z), gp_Dir(0, 0, 1)), 5.0, 10.0).Shape())
+    builder.Perform()
+    return builder.Shape()
+
+
+def test_tessellate_sharded_shared_edges():
+    """Test sharded tessellation of solids sharing a face and its edge across shards"""
+    expected = tessellate(stacked_cylinders(), 0.01, 0.3)
+
+    obj = stacked_cylinders()
+    for shard_by in ("solid", "faces"):
+        mesh = tessellate_sharded(obj, 0.01, 0.3, shard_by=shard_by, faces_per_shard=1, processes=2)
+
+        # the shared face and edge are merged once, in the order of tessellate()
+        for name in ("face_types", "edge_types", "segments_per_edge"):
+            assert np.array_equal(getattr(mesh, name), getattr(expected, name)), name
+        assert np.allclose(mesh.segments, expected.segments)
+        assert np.all(mesh.triangles_per_face > 0)
+
+        # both sides of the seam are meshed in different shards, their vertices on the shared
+        # circle are still points of the circle
+        vertices = mesh.vertices.reshape(-1, 3)
+        seam = vertices[np.abs(vertices[:, 2] - 10.0) < 1e-5]
+        assert len(seam) > 0
+        assert np.allclose(np.linalg.norm(seam[:, :2], axis=1), 5.0, atol=1e-4)
+
+
+def test_tessellate_to_file(b123, tmp_path):
+    """Test streaming STL and PLY export against tessellate()"""
+    mesh = tessellate(b123, 0.002, 0.3)
+    num_triangles = len(mesh.triangles) // 3
+
+    stl = tmp_path / "b123.stl"
+    assert tessellate_to_stl(b123, stl, 0.002) == num_triangles
+    data = stl.read_bytes()
+    assert len(data) == 84 + 50 * num_triangles
+    assert int.from_bytes(data[80:84], "little") == num_triangles
+    facets = np.frombuffer(data[84:], dtype=np.dtype([("n", "<f4", 3), ("v", "<f4", (3, 3)), ("a", "<u2")]))
+    assert np.allclose(facets["v"].reshape(-1, 3), mesh.vertices.reshape(-1, 3)[mesh.triangles])
+
+    ascii_stl = tmp_path / "b123_ascii.stl"
+    tessellate_to_stl(b123, str(ascii_stl), 0.002, binary=False)
+    text = ascii_stl.read_text()
+    assert text.startswith("solid") and text.rstrip().endswith("endsolid shape")
+    assert text.count("facet normal") == num_triangles
+
+    for binary in (True, False):
+        ply = tmp_path / f"b123_{binary}.ply"
+        assert tessellate_to_ply(b123, ply, 0.002, binary=binary) == num_triangles
+        header, _, body = ply.read_bytes().partition(b"end_header\n")
+        assert f"element vertex {len(mesh.vertices) // 3}".encode() in header
+        assert f"element face {num_triangles}".encode() in header
+        if binary:
+            assert len(body) == 24 * (len(mesh.vertices) // 3) + 13 * num_triangles
+        else:
+            assert body.count(b"\n") == len(mesh.vertices) // 3 + num_triangles
+
+    with pytest.raises(RuntimeError):
+        tessellate_to_stl(b123, tmp_path / "missing" / "b123.stl", 0.002)
+
+
+def test_heal(b123_data):
+    """Test that healing leaves faces that mesh fine untouched"""
+    # fresh shapes, so that both calls mesh from scratch
+    expected = tessellate(serializer.deserialize_shape(b123_data), 0.002, 0.3)
+    mesh = tessellate(serializer.deserialize_shape(b123_data), 0.002, 0.3, heal=True)
+
+    assert np.all(mesh.triangles_per_face > 0)
+    for name in ("triangles_per_face", "vertex_offsets", "triangles", "segments_per_edge", "face_types"):
+        assert np.array_equal(getattr(mesh, name), getattr(expected, name)), name
+    assert np.allclose(mesh.vertices, expected.vertices)
+
+
+def test_heal_recovers_face():
+    """Test that healing triangulates a face the mesher cannot triangulate"""
+    from OCP.BRepBuilderAPI import BRepBuilderAPI_MakeEdge, BRepBuilderAPI_MakeFace, BRepBuilderAPI_MakeWire
+    from OCP.GC import GC_MakeArcOfCircle
+    from OCP.Geom import Geom_CylindricalSurface
+    from OCP.gp import gp_Ax2, gp_Ax3, gp_Circ, gp_Dir, gp_Pnt
+
+    def broken_face():
+        # a quarter of a cylinder built from 3D curves only: without pcurves on the
+        # cylinder the mesher fails, ShapeFix adds them
+        a, b, c, d = gp_Pnt(10, 0, 0), gp_Pnt(0, 10, 0), gp_Pnt(0, 10, 10), gp_Pnt(10, 0, 10)
+        bottom = gp_Circ(gp_Ax2(gp_Pnt(0, 0, 0), gp_Dir(0, 0, 1)), 10)
+        top = gp_Circ(gp_Ax2(gp_Pnt(0, 0, 10), gp_Dir(0, 0, 1)), 10)
+        wire = BRepBuilderAPI_MakeWire()
+        wire.Add(BRepBuilderAPI_MakeEdge(GC_MakeArcOfCircle(bottom, a, b, True).Value()).Edge())
+        wire.Add(BRepBuilderAPI_MakeEdge(b, c).Edge())
+        wire.Add(BRepBuilderAPI_MakeEdge(GC_MakeArcOfCircle(top, d, c, True).Value()).Edge())
+        wire.Add(BRepBuilderAPI_MakeEdge(d, a).Edge())
+        return BRepBuilderAPI_MakeFace(Geom_CylindricalSurface(gp_Ax3(), 10), wire.Wire(), True).Face()
+
+    plain = tessellate(broken_face(), 0.01, 0.3)
+    assert plain.triangles_per_face.tolist() == [0]
+
+    healed = tessellate(broken_face(), 0.01, 0.3, heal=True)
+    assert healed.triangles_per_face[0] > 0
+    # the patch lies on the cylinder of radius 10
+    vertices = healed.vertices.reshape(-1, 3)
+    assert np.allclose(np.linalg.norm(vertices[:, :2], axis=1), 10, atol=0.05)
+
+
+@pytest.mark.skipif(not (CQ or BD), reason="Requires CadQuery or build123d")
+def test_flat_normals():
+    """Test one normal per planar face and per vertex normals for curved faces only"""
+
+    def shape():
+        if BD:
+            return bd.Cylinder(10, 20).wrapped
+        return cq.Workplane().cylinder(20, 10).val().wrapped
+
+    full = tessellate(shape(), 0.01, 0.3)
+    mesh = tessellate(shape(), 0.01, 0.3, flat_normals=True)
+
+    planar = full.face_types == 0
+    counts = np.diff(full.vertex_offsets)
+    assert planar.sum() == 2
+    assert len(full.flat_faces) == 0 and len(full.face_normals) == 0
+    assert np.array_equal(mesh.flat_faces, planar.astype(np.int32))
+    assert np.array_equal(np.diff(mesh.normal_offsets), np.where(planar, 0, counts))
+    assert len(mesh.normals) == 3 * mesh.normal_offsets[-1] < len(full.normals)
+
+    # expanding the face normals restores the per vertex normals
+    face_normals = mesh.face_normals.reshape(-1, 3)
+    normals = full.normals.reshape(-1, 3)
+    for i in range(len(planar)):
+        expected = normals[full.vertex_offsets[i] : full.vertex_offsets[i + 1]]
+        if planar[i]:
+            assert np.allclose(expected, face_normals[i])
+        else:
+            assert not face_normals[i].any()
+            compact = mesh.normals.reshape(-1, 3)[mesh.normal_offsets[i] : mesh.normal_offsets[i + 1]]
+            assert np.array_equal(compact, expected)
+
+    copy = pickle.loads(pickle.dumps(mesh))
+    assert np.array_equal(copy.normal_offsets, mesh.normal_offsets)
+    assert np.array_equal(MeshData.unpack(mesh.pack()).face_normals, mesh.face_normals)
+
+    with pytest.raises(ValueError):
+        simplify(mesh)
+
+
 def test_large_rc_object():
     """Test tessellation of large RC object from BREP file"""
     file = Path("examples") / "rc.brep"
@@ -0,0 +1,244 @@
+"""
+End-to-end performance regression suite
+
+Runs tessellate(), serialize_shape() and deserialize_shape() on a corpus of small, medium and
+large models at several thread counts and records wall time, the per phase times printed by
+tessellate(timeit=True), triangles/sec, parallel efficiency and peak memory. The results are
+compared against a JSON baseline and written as a JSON report.
+
+The suite is slow and machine dependent, so it only runs with OCP_ADDONS_PERF=1. Further
+settings (environment variables):
+
+- OCP_ADDONS_PERF_BASELINE: baseline file (default tests/perf_baseline.json). Without a
+  baseline the results are only reported, not compared.
+- OCP_ADDONS_PERF_UPDATE=1: write the baseline from the current run (the only way it is written)
+- OCP_ADDONS_PERF_THRESHOLD: allowed slowdown of wall times as a fraction (default 0.25)
+- OCP_ADDONS_PERF_MEMORY_THRESHOLD: allowed growth of peak memory as a fraction (default 0.25)
+- OCP_ADDONS_PERF_THREADS: comma separated thread counts (default 1,2,4,8 up to the CPU count)
+- OCP_ADDONS_PERF_REPEAT: runs per measurement, the fastest counts (default 3)
+- OCP_ADDONS_PERF_REPORT: report file (default perf_report.json)
+
+Timings shorter than OCP_ADDONS_PERF_MIN_TIME seconds (default 0.05) are recorded but not
+compared, their noise exceeds any sensible threshold.
+"""
+
+import json
+import os
+import platform
+import re
+import sys
+from pathlib import Path
+from time import perf_counter
+
+import pytest
+
+from ocp_addons.tessellator import configure_threads, tessellate, thread_count
+from ocp_addons import serializer
+
+pytestmark = pytest.mark.skipif(
+    os.environ.get("OCP_ADDONS_PERF") != "1", reason="Set OCP_ADDONS_PERF=1 to run the performance suite"
+)
+
+BASELINE = Path(os.environ.get("OCP_ADDONS_PERF_BASELINE", Path(__file__).parent / "perf_baseline.json"))
+REPORT = Path(os.environ.get("OCP_ADDONS_PERF_REPORT", "perf_report.json"))
+UPDATE = os.environ.get("OCP_ADDONS_PERF_UPDATE") == "1"
+THRESHOLD = float(os.environ.get("OCP_ADDONS_PERF_THRESHOLD", "0.25"))
+MEMORY_THRESHOLD = float(os.environ.get("OCP_ADDONS_PERF_MEMORY_THRESHOLD", "0.25"))
+MIN_TIME = float(os.environ.get("OCP_ADDONS_PERF_MIN_TIME", "0.05"))
+REPEAT = int(os.environ.get("OCP_ADDONS_PERF_REPEAT", "3"))
+
+
+def thread_counts():
+    if "OCP_ADDONS_PERF_THREADS" in os.environ:
+        return [int(n) for n in os.environ["OCP_ADDONS_PERF_THREADS"].split(",")]
+    cpus = os.cpu_count() or 1
+    return [n for n in (1, 2, 4, 8) if n <= cpus]
+
+
+# name, file, deflection as a fraction of the bounding box diagonal
+CORPUS = [
+    ("small", Path("examples") / "b123.brep", 0.001),
+    ("medium", Path("examples") / "b2.brep", 0.001),
+    ("large", Path("examples") / "rc.brep", 0.0005),
+]
+
+# "   0.123 sec:   | | message", one bar per nesting level
+TIMER_LINE = re.compile(r"^\s*(\d+\.\d+) sec:([\s|]*)(.*?)\s*$")
+
+
+def absolute_deflection(shape, fraction):
+    from OCP.Bnd import Bnd_Box
+    from OCP.BRepBndLib import BRepBndLib
+
+    box = Bnd_Box()
+    BRepBndLib.Add_s(shape, box)
+    return fraction * box.CornerMin().Distance(box.CornerMax())
+
+
+def reset_peak_memory():
+    """Resets the peak resident set size of the process (Linux only), returns success"""
+    try:
+        with open("/proc/self/clear_refs", "w") as f:
+            f.write("5")
+        return True
+    except OSError:
+        return False
+
+
+def peak_memory_mb():
+    """Peak resident set size in MB, since the last reset on Linux, of the process otherwise"""
+    try:
+        with open("/proc/self/status") as f:
+            for line in f:
+                if line.startswith("VmHWM:"):
+                    return int(line.split()[1]) / 1024
+    except OSError:
+        pass
+    import resource
+
+    peak = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    # bytes on macOS, kB on Linux
+    return peak / 2**20 if sys.platform == "darwin" else peak / 1024
+
+
+def parse_phases(output):
+    """Top level phases (and Overall) of the timeit output of tessellate()"""
+    phases = {}
+    for line in output.splitlines():
+        match = TIMER_LINE.match(line)
+        if match and match.group(2).count("|") <= 1:
+            phases[match.group(3)] = float(match.group(1))
+    return phases
+
+
+def measure(data, deflection, capsys):
+    """One run: deserialize, tessellate and serialize a fresh shape"""
+    start = perf_counter()
+    shape = serializer.deserialize_shape(data)
+    deserialize = perf_counter() - start
+
+    capsys.readouterr()
+    start = perf_counter()
+    mesh = tessellate(shape, deflection, 0.3, timeit=True)
+    tessellation = perf_counter() - start
+    phases = parse_phases(capsys.readouterr().out)
+
+    start = perf_counter()
+    serializer.serialize_shape(shape)
+    serialize = perf_counter() - start
+
+    return {
+        "tessellate": tessellation,
+        "serialize": serialize,
+        "deserialize": deserialize,
+        "phases": phases,
+        "triangles": len(mesh.triangles) // 3,
+        "mesh_threads": mesh.mesh_threads,
+        "extraction_threads": mesh.extraction_threads,
+    }
+
+
+def best_of(runs):
+    """Fastest time per operation; phases and counts of the fastest tessellation"""
+    fastest = min(runs, key=lambda run: run["tessellate"])
+    result = dict(fastest)
+    for key in ("serialize", "deserialize"):
+        result[key] = min(run[key] for run in runs)
+    result["triangles_per_sec"] = result["triangles"] / result["tessellate"] if result["tessellate"] > 0 else 0.0
+    return result
+
+
+def load_baseline():
+    if BASELINE.exists():
+        return json.loads(BASELINE.read_text())
+    return None
+
+
+@pytest.fixture(scope="module")
+def report():
+    results = {}
+    yield results
+
+    document = {
+        "machine": {
+            "platform": platform.platform(),
+            "processor": platform.processor(),
+            "cpu_count": os.cpu_count(),
+            "python": platform.python_version(),
+        },
+        "threshold": THRESHOLD,
+        "memory_threshold": MEMORY_THRESHOLD,
+        "results": results,
+    }
+    REPORT.write_text(json.dumps(document, indent=2, sort_keys=True))
+    if UPDATE:
+        BASELINE.write_text(json.dumps(document, indent=2, sort_keys=True))
+
+
+def regressions(name, current, baseline):
+    """Descriptions of all metrics of current exceeding the thresholds of baseline"""
+    found = []
+    for metric in ("tessellate", "serialize", "deserialize"):
+        old = baseline.get(metric)
+        if old is None or max(old, current[metric]) < MIN_TIME:
+            continue
+        if current[metric] > old * (1.0 + THRESHOLD):
+            found.append(f"{name} {metric}: {current[metric]:.3f}s > {old:.3f}s + {THRESHOLD:.0%}")
+
+    old = baseline.get("peak_memory_mb")
+    if old and current.get("peak_memory_mb") and current["peak_memory_mb"] > old * (1.0 + MEMORY_THRESHOLD):
+        found.append(
+            f"{name} peak memory: {current['peak_memory_mb']:.0f}MB > {old:.0f}MB + {MEMORY_THRESHOLD:.0%}"
+        )
+    return found
+
+
+@pytest.mark.parametrize("name,file,fraction", CORPUS, ids=[entry[0] for entry in CORPUS])
+def test_performance(name, file, fraction, report, capsys):
+    """Measure a corpus model at all thread counts and compare against the baseline"""
+    if not file.exists():
+        pytest.skip(f"{file} not found")
+
+    data = file.read_bytes()
+    deflection = absolute_deflection(serializer.deserialize_shape(data), fraction)
+    baseline = None if UPDATE else load_baseline()
+
+    pool_size = thread_count()
+    results = {}
+    try:
+        for threads in thread_counts():
+            configure_threads(threads)
+            resettable = reset_peak_memory()
+            runs = [measure(data, deflection, capsys) for _ in range(REPEAT)]
+            result = best_of(runs)
+            # without reset the peak covers the whole process and cannot be compared
+            result["peak_memory_mb"] = peak_memory_mb() if resettable else None
+            results[threads] = result
+    finally:
+        configure_threads(pool_size)
+
+    # parallel efficiency relative to the smallest thread count
+    reference_threads = min(results)
+    reference = results[reference_threads]["tessellate"]
+    for threads, result in results.items():
+        speedup = reference / result["tessellate"] if result["tessellate"] > 0 else 0.0
+        result["speedup"] = speedup
+        result["efficiency"] = speedup * reference_threads / threads
+
+    found = []
+    for threads, result in results.items():
+        key = f"{name}/threads={threads}"
+        report[key] = result
+        if baseline is not None and key in baseline["results"]:
+            found.extend(regressions(key, result, baseline["results"][key]))
+
+    with capsys.disabled():
+        for threads, result in results.items():
+            print(
+                f"\n{name:6s} threads={threads:2d} tessellate {result['tessellate']:7.3f}s "
+                f"({result['triangles_per_sec'] / 1e6:6.2f} Mtri/s, efficiency {result['efficiency']:4.0%}) "
+                f"serialize {result['serialize']:6.3f}s deserialize {result['deserialize']:6.3f}s",
+                end="",
+            )
+
+    assert not found, "Performance regressions:\n" + "\n".join(found)